@@ -6,6 +6,7 @@
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
+#include <atomic>
 #include <vector>
 #include <fc/thread/future.hpp>
 #include <fc/io/iostream.hpp>
@@ -71,20 +72,42 @@ namespace asio {
     /***
      * A structure for holding the boost io service and associated
      * threads
+     *
+     * In the default mode, all threads run a single io_service. In sharded mode,
+     * each thread runs an io_service of its own (a shard) and is pinned to a CPU
+     * core where supported. The CPUs can be configured with
+     * fc::set_thread_placement( fc::thread_group::asio_workers, ... ). An object such as a socket belongs to the shard it was
+     * created with, so all of its completion handlers run on the same thread and
+     * don't contend with other shards.
      */
     class default_io_service_scope
     {
        public:
           default_io_service_scope();
+          default_io_service_scope( uint16_t num_threads, bool sharded );
           ~default_io_service_scope();
           static void     set_num_threads(uint16_t num_threads);
           static uint16_t get_num_threads();
-          boost::asio::io_service*          io;
+          /** Selects sharded mode for the default io service. Must be called before it is used. */
+          static void     set_sharded(bool sharded);
+          static bool     get_sharded();
+
+          /** @return the number of io_services, 1 unless in sharded mode */
+          size_t                   shard_count()const { return shards.size(); }
+          /** @return the shards in turn */
+          boost::asio::io_service& next_shard();
+          /** @return the shard for the given key, e.g. a hash of a remote endpoint */
+          boost::asio::io_service& shard_for( uint64_t key );
+
+          boost::asio::io_service*          io; ///< the first shard
        private:
-          std::vector<boost::thread*>       asio_threads;
-          boost::asio::io_service::work*    the_work;
+          std::vector<boost::asio::io_service*>       shards;
+          std::vector<boost::asio::io_service::work*> works;
+          std::vector<boost::thread*>                 asio_threads;
+          std::atomic<uint64_t>                       next;
        protected:
           static uint16_t num_io_threads; // marked protected to help with testing
+          static bool     sharded_mode;
     };
 
     /**
@@ -92,9 +115,26 @@ namespace asio {
      * 
      * This IO service is automatically running in its own thread to service asynchronous
      * requests without blocking any other threads.
+     *
+     * Every call returns the same io_service, in sharded mode the first shard. Use
+     * next_default_io_service_shard() or default_io_service( key ) to spread objects
+     * over the shards.
      */
     boost::asio::io_service& default_io_service();
 
+    /**
+     * @return the shards of the default io service in turn, see default_io_service_scope::next_shard().
+     *         Timers, resolvers and strands that work with an object must use the same
+     *         io_service as the object.
+     */
+    boost::asio::io_service& next_default_io_service_shard();
+
+    /**
+     * @return the default io_service for objects with the given key. In sharded mode,
+     *         objects with the same key share a shard.
+     */
+    boost::asio::io_service& default_io_service( uint64_t key );
+
     /** 
      *  @brief wraps boost::asio::async_read
      *  @pre s.non_blocking() == true
@@ -12,3 +12,8 @@
 // how many elements will be reserve()d when deserializing vectors
 #define FC_MAX_PREALLOC_SIZE (256UL)
 #endif
+
+#ifndef FC_PACK_SCRATCH_MAX_SIZE
+// capacity up to which the per-thread buffer of fc::raw::pack() is kept between calls
+#define FC_PACK_SCRATCH_MAX_SIZE (1024UL*1024UL)
+#endif
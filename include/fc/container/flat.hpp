@@ -98,6 +98,14 @@ namespace fc {
           }
        }
 
+       namespace detail {
+          // flat containers are packed like vectors of their elements
+          template<typename T, typename... A>
+          struct skipper<flat_set<T, A...>> : skipper<std::vector<T>> {};
+          template<typename K, typename V, typename... A>
+          struct skipper<flat_map<K, V, A...>> : skipper<std::vector<std::pair<K,V>>> {};
+       }
+
    } // namespace raw
 
 
@@ -83,6 +83,9 @@ namespace raw {
       ds >> ep;
    }
 
+   template<>
+   struct is_trivially_packable<ripemd160> : std::true_type {};
+
 }
 
   class variant;
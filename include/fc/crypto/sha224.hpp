@@ -80,6 +80,9 @@ namespace raw {
       ds >> ep;
    }
 
+   template<>
+   struct is_trivially_packable<sha224> : std::true_type {};
+
 }
 
   class variant;
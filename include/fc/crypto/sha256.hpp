@@ -83,6 +83,9 @@ namespace raw {
       ds >> ep;
    }
 
+   template<>
+   struct is_trivially_packable<sha256> : std::true_type {};
+
 }
 
   typedef sha256 uint256;
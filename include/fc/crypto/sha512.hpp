@@ -79,6 +79,9 @@ namespace raw {
       ds >> ep;
    }
 
+   template<>
+   struct is_trivially_packable<sha512> : std::true_type {};
+
 }
 
   typedef fc::sha512 uint512;
@@ -0,0 +1,66 @@
+#pragma once
+#include <fc/filesystem.hpp>
+#include <fc/thread/future.hpp>
+
+#include <memory>
+#include <string>
+
+namespace fc {
+
+  /**
+   *  A file whose reads, writes and syncs do not block the calling fc::thread.
+   *
+   *  Operations are submitted to io_uring where the kernel supports it and
+   *  permits it, and otherwise run as blocking system calls on a pool of
+   *  threads reserved for file I/O. Either way the calling fiber only blocks
+   *  when it waits on the returned future, other fibers of its thread keep
+   *  running.
+   *
+   *  Buffers passed to pread() and pwrite() must stay valid until the returned
+   *  future is ready. Closing the file or destroying the object while operations
+   *  are pending is allowed, the file is closed when they are finished.
+   */
+  class async_file {
+    public:
+      enum mode { read = 1, write = 2, create = 4, truncate = 8 };
+
+      async_file();
+      async_file( const fc::path& file, int m = read );
+      ~async_file();
+
+      /** Opens the file synchronously, throws if that fails */
+      void open( const fc::path& file, int m = read );
+      bool is_open()const;
+      void close();
+      /** @return the current size of the file */
+      uint64_t size()const;
+
+      /** Reads up to len bytes at the given offset. The result is less than len
+       *  only if the end of the file was reached. */
+      future<size_t> pread( char* buf, size_t len, uint64_t offset );
+      /** Writes len bytes at the given offset, the result is always len */
+      future<size_t> pwrite( const char* buf, size_t len, uint64_t offset );
+      /** Flushes written data and metadata of the file to the disk */
+      future<void>   fsync();
+
+      /** Sets the number of threads that run file I/O which cannot go through
+       *  io_uring. Must be called before the first operation. The default is 4. */
+      static void     set_num_io_threads( uint16_t num_threads );
+      static uint16_t get_num_io_threads();
+      /** Allows or forbids the use of io_uring for operations started afterwards.
+       *  It is allowed by default. */
+      static void     enable_io_uring( bool enable );
+      /** @return true if operations are submitted to io_uring */
+      static bool     uses_io_uring();
+
+    private:
+      class impl;
+      friend future<std::string> async_read_file( const fc::path& filename );
+      std::shared_ptr<impl> my;
+  };
+
+  /** Reads the whole file into a string, without blocking the calling fc::thread.
+   *  @see read_file_contents() */
+  future<std::string> async_read_file( const fc::path& filename );
+
+} // namespace fc
@@ -1,6 +1,7 @@
 #pragma once
 #include <string.h>
 #include <stdint.h>
+#include <vector>
 
 namespace fc {
 
@@ -88,5 +89,64 @@ class datastream<size_t> {
      size_t _size;
 };
 
+/**
+ *  Appends to a std::vector<char>, which grows geometrically. This allows packing in a single pass,
+ *  without calculating the size first. A vector that is reused for several objects stops reallocating
+ *  once it has grown to the size of the largest of them.
+ *
+ *  While the datastream writes, the vector may be larger than what was written. It is cut to the end
+ *  of the written data when the datastream is destroyed.
+ */
+template<>
+class datastream<std::vector<char>> {
+   public:
+     /** @param reserve_hint the expected number of bytes to be written */
+     explicit datastream( std::vector<char>& buffer, size_t reserve_hint = 0 )
+     :_buffer(buffer),_start(buffer.size()),_pos(_start)
+     {
+        if( reserve_hint > 0 )
+           _buffer.resize( _start + reserve_hint );
+     }
+     ~datastream() { _buffer.resize( _pos ); }
+     datastream( const datastream& ) = delete;
+     datastream& operator=( const datastream& ) = delete;
+
+     inline bool write( const char* d, size_t s ) {
+        memcpy( prepare( s ), d, s );
+        _pos += s;
+        return true;
+     }
+     inline bool put( char c ) {
+        if( _pos == _buffer.size() )
+           grow( 1 );
+        _buffer[_pos++] = c;
+        return true;
+     }
+     /** Makes room for s bytes and returns where they go, to be followed by skip( s ) after writing them */
+     inline char*    prepare( size_t s ) {
+        if( _buffer.size() - _pos < s )
+           grow( s );
+        return _buffer.data() + _pos;
+     }
+     inline void     skip( size_t s ) { _pos += s;            }
+     inline bool     valid()const     { return true;          }
+     inline size_t   tellp()const     { return _pos - _start; }
+     inline size_t   remaining()const { return 0;             }
+  private:
+     // doubles the written size, std::vector takes care of growing its capacity geometrically as well
+     void grow( size_t s ) {
+        size_t step = _pos - _start;
+        if( step < 64 )
+           step = 64;
+        if( step < s )
+           step = s;
+        _buffer.resize( _pos + step );
+     }
+
+     std::vector<char>& _buffer;
+     const size_t       _start;
+     size_t             _pos;
+};
+
 } // namespace fc
 
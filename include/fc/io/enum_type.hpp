@@ -77,6 +77,9 @@ namespace fc
        fc::raw::unpack( s, t, _max_depth - 1 );
        tp = t;
     }
+
+    template<typename IntType, typename EnumType>
+    struct fixed_packed_size<fc::enum_type<IntType,EnumType>> : fixed_packed_size<IntType> {};
   }
 
 }
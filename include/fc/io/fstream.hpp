@@ -6,6 +6,7 @@
 
 namespace fc {
   class path;
+  /** Writes block the calling fc::thread, see async_file for an alternative */
   class ofstream : virtual public ostream {
     public:
       ofstream();
@@ -24,6 +25,7 @@ namespace fc {
       std::shared_ptr<impl> my;
   };
 
+  /** Reads block the calling fc::thread, see async_file for an alternative */
   class ifstream : virtual public istream {
     public:
       enum mode { in, binary };
@@ -1,5 +1,6 @@
 #pragma once
 #include <boost/endian/buffers.hpp>
+#include <boost/predef/other/endian.h>
 
 #include <fc/io/raw_variant.hpp>
 #include <fc/reflect/reflect.hpp>
@@ -11,6 +12,8 @@
 #include <fc/exception/exception.hpp>
 #include <fc/io/raw_fwd.hpp>
 #include <algorithm>
+#include <cstring>
+#include <limits>
 #include <map>
 #include <deque>
 
@@ -489,19 +492,25 @@ namespace fc {
         }
       };
 
+      template<bool FixedSize>
+      struct if_fixed_size;
+
       template<typename T, typename Dummy=void>
       struct if_enum;
       template<typename T>
       struct if_enum<T, std::enable_if_t<!std::is_enum<T>::value>> {
+        // objects with a fixed packed size are bounds checked once instead of field by field
+        using if_fixed = if_fixed_size< fixed_packed_size<T>::is_fixed && std::is_trivially_copyable<T>::value >;
+
         template<typename Stream>
         static inline void pack( Stream& s, const T& v, uint32_t _max_depth ) {
           FC_ASSERT( _max_depth > 0 );
-          fc::reflector<T>::visit( pack_object_visitor<Stream,T>( v, s, _max_depth - 1 ) );
+          if_fixed::pack( s, v, _max_depth - 1 );
         }
         template<typename Stream>
         static inline void unpack( Stream& s, T& v, uint32_t _max_depth ) {
           FC_ASSERT( _max_depth > 0 );
-          fc::reflector<T>::visit( unpack_object_visitor<Stream,T>( v, s, _max_depth - 1 ) );
+          if_fixed::unpack( s, v, _max_depth - 1 );
         }
       };
       template<typename T>
@@ -674,17 +683,361 @@ namespace fc {
        }
     }
 
+    // Integers are packed little endian, so their packed form equals memory on little endian hosts only
+    template<typename T>
+    struct is_trivially_packable<T, std::enable_if_t<std::is_same<T,int8_t>::value || std::is_same<T,uint8_t>::value
+                                                     || std::is_same<T,int16_t>::value || std::is_same<T,uint16_t>::value
+                                                     || std::is_same<T,int32_t>::value || std::is_same<T,uint32_t>::value
+                                                     || std::is_same<T,int64_t>::value || std::is_same<T,uint64_t>::value>>
+       : std::integral_constant<bool, BOOST_ENDIAN_LITTLE_BYTE != 0> {};
+
+    template<size_t N>
+    struct is_trivially_packable<std::array<char,N>> : std::true_type {};
+    template<size_t N>
+    struct is_trivially_packable<std::array<unsigned char,N>> : std::true_type {};
+
+    template<boost::endian::order O, class T, std::size_t N, boost::endian::align A>
+    struct is_trivially_packable<boost::endian::endian_buffer<O,T,N,A>> : std::true_type {};
+
+    namespace detail {
+
+      template<typename... Fields>
+      struct packed_members {
+         static constexpr bool   trivial = true;
+         static constexpr size_t size    = 0;
+      };
+      template<typename Field, typename... Fields>
+      struct packed_members<Field, Fields...> {
+         static constexpr bool   trivial = is_trivially_packable<typename Field::type>::value
+                                           && packed_members<Fields...>::trivial;
+         static constexpr size_t size    = sizeof(typename Field::type) + packed_members<Fields...>::size;
+      };
+
+    } // namespace detail
+
+    /**
+     *  A reflected struct without base classes is trivially packable if all of its members are and they
+     *  cover the struct without padding. Whether the members are reflected in declaration order cannot be
+     *  checked at compile time, detail::packed_layout verifies it once at runtime.
+     */
+    template<typename T>
+    struct is_trivially_packable<T, std::enable_if_t<std::is_class<T>::value && fc::reflector<T>::is_defined::value>>
+       : std::integral_constant<bool,
+            std::is_trivially_copyable<T>::value && std::is_standard_layout<T>::value
+            && typelist::length<typename fc::reflector<T>::base_classes>() == 0
+            && typelist::apply<typename fc::reflector<T>::members, detail::packed_members>::trivial
+            && typelist::apply<typename fc::reflector<T>::members, detail::packed_members>::size == sizeof(T)> {};
+
+    namespace detail {
+
+      /** Checks once per type that packing a reflected struct really produces its bytes in memory, i.e. that
+       *  the members are reflected in declaration order and that no custom pack() overload is in the way */
+      template<typename T, typename Dummy = void>
+      struct packed_layout {
+         static bool matches_memory() { return true; }
+         static bool matches_size() { return true; }
+      };
+      template<typename T>
+      struct packed_layout<T, std::enable_if_t<std::is_class<T>::value && fc::reflector<T>::is_defined::value>> {
+         static bool matches_memory() { return layout().matches_memory; }
+         /** @return true if T packs to sizeof(T) bytes, though maybe not in memory order */
+         static bool matches_size() { return layout().matches_size; }
+      private:
+         struct result {
+            bool matches_size;
+            bool matches_memory;
+         };
+         static const result& layout() {
+            static const result checked = check();
+            return checked;
+         }
+         static result check() {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type probe;
+            char* bytes = reinterpret_cast<char*>( &probe );
+            for( size_t i = 0; i < sizeof(T); ++i )
+               bytes[i] = char( ( i * 167 ) ^ ( i >> 8 ) );
+            char packed[sizeof(T)];
+            datastream<char*> ds( packed, sizeof(packed) );
+            try {
+               fc::raw::pack( ds, reinterpret_cast<const T&>( probe ) );
+            } catch( const fc::exception& ) {
+               return { false, false };
+            }
+            const bool same_size = ds.tellp() == sizeof(T);
+            return { same_size, same_size && memcmp( packed, bytes, sizeof(T) ) == 0 };
+         }
+      };
+
+    } // namespace detail
+
+    template<typename T>
+    struct fixed_packed_size<T, std::enable_if_t<std::is_integral<T>::value>> : detail::packed_size_info<true,sizeof(T)> {};
+    template<typename T>
+    struct fixed_packed_size<T, std::enable_if_t<std::is_enum<T>::value>> : detail::packed_size_info<true,sizeof(int64_t)> {};
+    template<>
+    struct fixed_packed_size<uint128_t> : detail::packed_size_info<true,16> {};
+    template<>
+    struct fixed_packed_size<fc::time_point_sec> : detail::packed_size_info<true,sizeof(uint32_t)> {};
+    template<>
+    struct fixed_packed_size<fc::time_point> : detail::packed_size_info<true,sizeof(int64_t)> {};
+    template<>
+    struct fixed_packed_size<fc::microseconds> : detail::packed_size_info<true,sizeof(int64_t)> {};
+
+    // byte arrays, endian buffers, digests
+    template<typename T>
+    struct fixed_packed_size<T, std::enable_if_t<std::is_class<T>::value && !fc::reflector<T>::is_defined::value
+                                                 && is_trivially_packable<T>::value>>
+       : detail::packed_size_info<true,sizeof(T)> {};
+
+    namespace detail {
+
+      template<typename... Fields>
+      struct fixed_members {
+         static constexpr bool   is_fixed = true;
+         static constexpr size_t size     = 0;
+      };
+      template<typename Field, typename... Fields>
+      struct fixed_members<Field, Fields...> {
+         static constexpr bool   is_fixed = fixed_packed_size<typename Field::type>::is_fixed
+                                            && fixed_members<Fields...>::is_fixed;
+         static constexpr size_t size     = fixed_packed_size<typename Field::type>::value + fixed_members<Fields...>::size;
+      };
+
+      /** True if no member is reflected. fixed_packed_size is trusted for types that are not reflected, while a
+       *  reflected member may have a custom pack() whose size depends on the value. */
+      template<typename... Fields>
+      struct builtin_members : std::true_type {};
+      template<typename Field, typename... Fields>
+      struct builtin_members<Field, Fields...>
+         : std::integral_constant<bool, !( std::is_class<typename Field::type>::value
+                                           && fc::reflector<typename Field::type>::is_defined::value )
+                                        && builtin_members<Fields...>::value> {};
+
+    } // namespace detail
+
+    /** A reflected struct has a fixed packed size if all of its members have one */
+    template<typename T>
+    struct fixed_packed_size<T, std::enable_if_t<std::is_class<T>::value && fc::reflector<T>::is_defined::value>>
+       : detail::packed_size_info< typelist::apply<typename fc::reflector<T>::members, detail::fixed_members>::is_fixed,
+                                   typelist::apply<typename fc::reflector<T>::members, detail::fixed_members>::is_fixed
+                                      ? typelist::apply<typename fc::reflector<T>::members, detail::fixed_members>::size
+                                      : 0 > {};
+
+    namespace detail {
+
+      /** Reads and writes without bounds checks, for objects whose extent has been checked as a whole */
+      template<typename T>
+      class unchecked_datastream {
+        public:
+          explicit unchecked_datastream( T pos ) : _pos(pos) {}
+          inline bool read( char* d, size_t s )        { memcpy( d, _pos, s ); _pos += s; return true; }
+          inline bool write( const char* d, size_t s ) { memcpy( _pos, d, s ); _pos += s; return true; }
+          inline bool put( char c )                    { *_pos++ = c; return true; }
+          inline bool get( unsigned char& c )          { c = *_pos++; return true; }
+          inline bool get( char& c )                   { c = *_pos++; return true; }
+          inline void skip( size_t s )                 { _pos += s; }
+          T           pos()const                       { return _pos; }
+        private:
+          T _pos;
+      };
+
+      /** Counts packed bytes like datastream<size_t>, but is never given the fixed size shortcut */
+      class size_probe {
+        public:
+          inline bool   write( const char*, size_t s ) { _size += s; return true; }
+          inline bool   put( char )                    { ++_size; return true; }
+          inline size_t tellp()const                   { return _size; }
+        private:
+          size_t _size = 0;
+      };
+
+      template<>
+      struct if_fixed_size<false> {
+        template<typename Stream, typename T>
+        static inline void pack( Stream& s, const T& v, uint32_t _max_depth ) {
+          fc::reflector<T>::visit( pack_object_visitor<Stream,T>( v, s, _max_depth ) );
+        }
+        template<typename Stream, typename T>
+        static inline void unpack( Stream& s, T& v, uint32_t _max_depth ) {
+          fc::reflector<T>::visit( unpack_object_visitor<Stream,T>( v, s, _max_depth ) );
+        }
+      };
+
+      /** Checks once per type that packing really produces fixed_packed_size<T> bytes, which it does
+       *  not if a member has a custom pack() that disagrees with the reflection of its type. The check
+       *  packs a single value, so it is only conclusive if builtin() is true. */
+      template<typename T>
+      struct fixed_layout {
+         /** @return whether the members of T can be packed without bounds checks, once the extent is checked */
+         static constexpr bool builtin() {
+            return typelist::apply<typename fc::reflector<T>::members, builtin_members>::value;
+         }
+         static bool verified() {
+            static const bool matches = members_size() == fixed_packed_size<T>::value;
+            return matches;
+         }
+         /** @return the packed size of the members of a T */
+         static size_t members_size() {
+            static const size_t size = probe( []( size_probe& ps, const T& v ) {
+               if_fixed_size<false>::pack( ps, v, FC_PACK_MAX_DEPTH );
+            });
+            return size;
+         }
+         /** @return the size of a T packed by fc::raw::pack(), which is not members_size() if T has a custom pack() */
+         static size_t packed_size() {
+            static const size_t size = probe( []( size_probe& ps, const T& v ) {
+               fc::raw::pack( ps, v, FC_PACK_MAX_DEPTH );
+            });
+            return size;
+         }
+      private:
+         /** @return the size of a zeroed T packed by pack, or the maximum size_t if that fails */
+         template<typename Packer>
+         static size_t probe( Packer pack ) {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type probe;
+            memset( &probe, 0, sizeof(probe) );
+            size_probe ps;
+            try {
+               pack( ps, reinterpret_cast<const T&>( probe ) );
+            } catch( const fc::exception& ) {
+               return std::numeric_limits<size_t>::max();
+            }
+            return ps.tellp();
+         }
+      };
+
+      template<>
+      struct if_fixed_size<true> : if_fixed_size<false> {
+        using if_fixed_size<false>::pack;
+        using if_fixed_size<false>::unpack;
+
+        template<typename T>
+        static inline void pack( datastream<char*>& s, const T& v, uint32_t _max_depth ) {
+          const size_t size = fixed_packed_size<T>::value;
+          if( !fixed_layout<T>::verified() )
+             return if_fixed_size<false>::pack( s, v, _max_depth );
+          if( s.remaining() < size )
+             fc::detail::throw_datastream_range_error( "write", s.tellp() + s.remaining(), int64_t(size - s.remaining()) );
+          if( !fixed_layout<T>::builtin() )
+             return pack_checked( s, v, _max_depth );
+          unchecked_datastream<char*> us( s.pos() );
+          if_fixed_size<false>::pack( us, v, _max_depth );
+          s.skip( size );
+        }
+        template<typename T>
+        static inline void pack( datastream<std::vector<char>>& s, const T& v, uint32_t _max_depth ) {
+          const size_t size = fixed_packed_size<T>::value;
+          if( !fixed_layout<T>::verified() )
+             return if_fixed_size<false>::pack( s, v, _max_depth );
+          if( !fixed_layout<T>::builtin() )
+             return pack_checked( s, v, _max_depth );
+          unchecked_datastream<char*> us( s.prepare( size ) );
+          if_fixed_size<false>::pack( us, v, _max_depth );
+          s.skip( size );
+        }
+        template<typename T>
+        static inline void pack( datastream<size_t>& s, const T& v, uint32_t _max_depth ) {
+          if( !fixed_layout<T>::verified() )
+             return if_fixed_size<false>::pack( s, v, _max_depth );
+          if( !fixed_layout<T>::builtin() )
+             return pack_checked( s, v, _max_depth );
+          s.skip( fixed_packed_size<T>::value );
+        }
+        template<typename T>
+        static inline void unpack( datastream<const char*>& s, T& v, uint32_t _max_depth ) {
+          const size_t size = fixed_packed_size<T>::value;
+          if( !fixed_layout<T>::verified() )
+             return if_fixed_size<false>::unpack( s, v, _max_depth );
+          if( s.remaining() < size )
+             fc::detail::throw_datastream_range_error( "read", s.tellp() + s.remaining(), int64_t(size - s.remaining()) );
+          if( !fixed_layout<T>::builtin() )
+          {
+             const size_t start = s.tellp();
+             if_fixed_size<false>::unpack( s, v, _max_depth );
+             return check_extent<T>( s.tellp() - start );
+          }
+          unchecked_datastream<const char*> us( s.pos() );
+          if_fixed_size<false>::unpack( us, v, _max_depth );
+          s.skip( size );
+        }
+
+      private:
+        /** Packs a T that a custom pack() of a member may make larger or smaller, through the checked stream */
+        template<typename Stream, typename T>
+        static inline void pack_checked( Stream& s, const T& v, uint32_t _max_depth ) {
+          const size_t start = s.tellp();
+          if_fixed_size<false>::pack( s, v, _max_depth );
+          check_extent<T>( s.tellp() - start );
+        }
+        template<typename T>
+        static inline void check_extent( size_t extent ) {
+          FC_ASSERT( extent == fixed_packed_size<T>::value,
+                     "Packed ${n} bytes of a type with a fixed packed size of ${f} bytes",
+                     ("n",extent)("f",fixed_packed_size<T>::value) );
+        }
+      };
+
+      template<bool TriviallyPackable>
+      struct if_trivially_packable {
+        template<typename Stream, typename T>
+        static inline void pack( Stream& s, const std::vector<T>& value, uint32_t _max_depth ) {
+           auto itr = value.begin();
+           auto end = value.end();
+           while( itr != end ) {
+              fc::raw::pack( s, *itr, _max_depth );
+              ++itr;
+           }
+        }
+        template<typename Stream, typename T>
+        static inline void unpack( Stream& s, std::vector<T>& value, uint64_t size, uint32_t _max_depth ) {
+           value.resize( std::min( size, static_cast<uint64_t>(FC_MAX_PREALLOC_SIZE) ) );
+           for( uint64_t i = 0; i < size; i++ )
+           {
+              if( i >= value.size() )
+                 value.resize( std::min( static_cast<uint64_t>(2*value.size()), size ) );
+              fc::raw::unpack( s, value[i], _max_depth );
+           }
+        }
+      };
+
+      /** Packs and unpacks the whole vector with one write, or one read per allocation step */
+      template<>
+      struct if_trivially_packable<true> {
+        template<typename Stream, typename T>
+        static inline void pack( Stream& s, const std::vector<T>& value, uint32_t _max_depth ) {
+           if( !packed_layout<T>::matches_memory() )
+              return if_trivially_packable<false>::pack( s, value, _max_depth );
+           // the depth check the element-wise path would do per element, for a reflected element
+           FC_ASSERT( value.empty() || _max_depth > 1 );
+           if( value.size() )
+              s.write( reinterpret_cast<const char*>( value.data() ), value.size() * sizeof(T) );
+        }
+        template<typename Stream, typename T>
+        static inline void unpack( Stream& s, std::vector<T>& value, uint64_t size, uint32_t _max_depth ) {
+           if( !packed_layout<T>::matches_memory() )
+              return if_trivially_packable<false>::unpack( s, value, size, _max_depth );
+           FC_ASSERT( size == 0 || _max_depth > 1 );
+           // grow like the element-wise path, so that a bogus size cannot allocate more than the stream holds
+           value.resize( std::min( size, static_cast<uint64_t>(FC_MAX_PREALLOC_SIZE) ) );
+           size_t done = 0;
+           while( done < value.size() )
+           {
+              s.read( reinterpret_cast<char*>( value.data() + done ), ( value.size() - done ) * sizeof(T) );
+              done = value.size();
+              if( done < size )
+                 value.resize( std::min( static_cast<uint64_t>(2*done), size ) );
+           }
+        }
+      };
+
+    } // namespace detail
+
     template<typename Stream, typename T>
     inline void pack( Stream& s, const std::vector<T>& value, uint32_t _max_depth ) {
        FC_ASSERT( _max_depth > 0 );
        --_max_depth;
        fc::raw::pack( s, unsigned_int(value.size()), _max_depth );
-       auto itr = value.begin();
-       auto end = value.end();
-       while( itr != end ) {
-          fc::raw::pack( s, *itr, _max_depth );
-          ++itr;
-       }
+       detail::if_trivially_packable< is_trivially_packable<T>::value >::pack( s, value, _max_depth );
     }
 
     template<typename Stream, typename T>
@@ -692,13 +1045,7 @@ namespace fc {
        FC_ASSERT( _max_depth > 0 );
        --_max_depth;
        unsigned_int size; fc::raw::unpack( s, size, _max_depth );
-       value.resize( std::min( size.value, static_cast<uint64_t>(FC_MAX_PREALLOC_SIZE) ) );
-       for( uint64_t i = 0; i < size; i++ )
-       {
-          if( i >= value.size() )
-             value.resize( std::min( static_cast<uint64_t>(2*value.size()), size.value ) );
-          unpack( s, value[i], _max_depth );
-       }
+       detail::if_trivially_packable< is_trivially_packable<T>::value >::unpack( s, value, size.value, _max_depth );
     }
 
     template<typename Stream, typename T>
@@ -761,34 +1108,85 @@ namespace fc {
        return ps.tellp();
     }
 
+    namespace detail {
+
+      /** A buffer per thread, which pack() reuses so that it does not grow from scratch every time */
+      class pack_scratch {
+        public:
+          pack_scratch() : _state( get_state() ) {
+             if( !_state.in_use ) {
+                _state.in_use = true;
+                _owner = true;
+                _state.buffer.clear();
+             }
+          }
+          ~pack_scratch() {
+             if( !_owner )
+                return;
+             if( _state.buffer.capacity() > FC_PACK_SCRATCH_MAX_SIZE )
+                std::vector<char>().swap( _state.buffer );
+             _state.in_use = false;
+          }
+          /** @return the buffer of this thread, or a new one if it is in use by an enclosing pack() */
+          std::vector<char>& buffer() { return _owner ? _state.buffer : _nested; }
+          /** @return a copy of the buffer, or the buffer itself if it is too large to be kept anyway */
+          std::vector<char> result() {
+             std::vector<char>& b = buffer();
+             if( !_owner || b.capacity() > FC_PACK_SCRATCH_MAX_SIZE )
+                return std::move( b );
+             return std::vector<char>( b.begin(), b.end() );
+          }
+
+        private:
+          struct state {
+             std::vector<char> buffer;
+             bool              in_use = false;
+          };
+          static state& get_state() {
+             static thread_local state scratch;
+             return scratch;
+          }
+
+          state&            _state;
+          bool              _owner = false;
+          std::vector<char> _nested;
+      };
+
+    } // namespace detail
+
+    /**
+     *  Packs v to the end of buffer in a single pass. Clear the buffer and reuse it for subsequent
+     *  calls to avoid reallocating it.
+     */
+    template<typename T>
+    inline void pack_into( std::vector<char>& buffer, const T& v, uint32_t _max_depth ) {
+       FC_ASSERT( _max_depth > 0 );
+       datastream<std::vector<char>> ds( buffer );
+       fc::raw::pack( ds, v, _max_depth - 1 );
+    }
+
     template<typename T>
     inline std::vector<char> pack( const T& v, uint32_t _max_depth ) {
        FC_ASSERT( _max_depth > 0 );
        --_max_depth;
-       datastream<size_t> ps;
-       fc::raw::pack( ps, v, _max_depth );
-       std::vector<char> vec(ps.tellp());
-
-       if( vec.size() ) {
-          datastream<char*>  ds( vec.data(), size_t(vec.size()) );
+       detail::pack_scratch scratch;
+       {
+          datastream<std::vector<char>> ds( scratch.buffer() );
           fc::raw::pack( ds, v, _max_depth );
        }
-       return vec;
+       return scratch.result();
     }
 
     template<typename T, typename... Next>
     inline std::vector<char> pack(  const T& v, Next... next, uint32_t _max_depth ) {
        FC_ASSERT( _max_depth > 0 );
        --_max_depth;
-       datastream<size_t> ps;
-       fc::raw::pack( ps, v, next..., _max_depth );
-       std::vector<char> vec(ps.tellp());
-
-       if( vec.size() ) {
-          datastream<char*>  ds( vec.data(), size_t(vec.size()) );
+       detail::pack_scratch scratch;
+       {
+          datastream<std::vector<char>> ds( scratch.buffer() );
           fc::raw::pack( ds, v, next..., _max_depth );
        }
-       return vec;
+       return scratch.result();
     }
 
 
@@ -893,5 +1291,200 @@ namespace fc {
        sv.visit( unpack_static_variant<Stream>( s, _max_depth ) );
     }
 
+    namespace detail {
+
+      /** @return a pointer to the next len bytes of the stream, which is advanced past them */
+      inline const char* take_bytes( datastream<const char*>& s, uint64_t len )
+      {
+         const size_t remaining = s.remaining();
+         if( len > remaining )
+            fc::detail::throw_datastream_range_error( "read", s.tellp() + remaining, int64_t(len - remaining) );
+         const char* result = s.pos();
+         s.skip( len );
+         return result;
+      }
+
+      inline void skip_bytes( datastream<const char*>& s, uint64_t len ) { take_bytes( s, len ); }
+      /** Streams that cannot seek are read in chunks into a buffer on the stack */
+      template<typename Stream>
+      inline void skip_bytes( Stream& s, uint64_t len )
+      {
+         char buffer[256];
+         while( len > 0 )
+         {
+            const size_t chunk = std::min( len, static_cast<uint64_t>(sizeof(buffer)) );
+            s.read( buffer, chunk );
+            len -= chunk;
+         }
+      }
+
+      /**
+       *  Tells how packed Ts can be skipped. fixed_packed_size<T> is trusted for types that are not reflected.
+       *  A reflected T, or one of its members, may have a custom pack() that disagrees with the reflection, so
+       *  its fixed size is only used after fixed_layout has checked it, which needs a trivially copyable T.
+       */
+      template<typename T, bool Checked = std::is_class<T>::value && fc::reflector<T>::is_defined::value
+                                          && fixed_packed_size<T>::is_fixed && std::is_trivially_copyable<T>::value>
+      struct skip_layout {
+         /** @return whether every packed T takes fixed_packed_size<T> bytes */
+         static bool fixed() {
+            return fixed_packed_size<T>::is_fixed && !( std::is_class<T>::value && fc::reflector<T>::is_defined::value );
+         }
+         /** @return whether a reflected T is packed as its members */
+         static bool by_members() { return true; }
+      };
+      template<typename T>
+      struct skip_layout<T, true> {
+         static bool fixed()      { return fixed_layout<T>::packed_size() == fixed_packed_size<T>::value; }
+         static bool by_members() { return fixed_layout<T>::packed_size() == fixed_layout<T>::members_size(); }
+      };
+
+      /** Skips count packed Ts, all at once if they have a fixed packed size */
+      template<typename T, typename Stream>
+      inline void skip_elements( Stream& s, uint64_t count, uint32_t _max_depth )
+      {
+         if( skip_layout<T>::fixed() )
+         {
+            FC_ASSERT( fixed_packed_size<T>::value == 0
+                       || count <= std::numeric_limits<uint64_t>::max() / fixed_packed_size<T>::value,
+                       "Invalid packed container size" );
+            skip_bytes( s, count * fixed_packed_size<T>::value );
+            return;
+         }
+         for( uint64_t i = 0; i < count; ++i )
+            fc::raw::skip<T>( s, _max_depth );
+      }
+
+      /** Types without a known packed structure are unpacked into a temporary */
+      template<typename T, typename Dummy>
+      struct skipper {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            T tmp;
+            fc::raw::unpack( s, tmp, _max_depth );
+         }
+      };
+
+      template<typename T>
+      struct skipper<T, std::enable_if_t<fixed_packed_size<T>::is_fixed
+                                         && !( std::is_class<T>::value && fc::reflector<T>::is_defined::value )>> {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            skip_bytes( s, fixed_packed_size<T>::value );
+         }
+      };
+
+      template<typename T>
+      struct skipper<T, std::enable_if_t<std::is_class<T>::value && fc::reflector<T>::is_defined::value>> {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            if( skip_layout<T>::fixed() )
+               return skip_bytes( s, fixed_packed_size<T>::value );
+            if( !skip_layout<T>::by_members() )
+            {
+               T tmp;
+               fc::raw::unpack( s, tmp, _max_depth );
+               return;
+            }
+            typelist::runtime::for_each( typename fc::reflector<T>::members(), [&s,_max_depth]( auto member ) {
+               fc::raw::skip<typename decltype(member)::type::type>( s, _max_depth );
+            });
+         }
+      };
+
+      template<>
+      struct skipper<unsigned_int> {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            unsigned_int tmp;
+            fc::raw::unpack( s, tmp, _max_depth );
+         }
+      };
+
+      template<>
+      struct skipper<std::string> {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            unsigned_int size; fc::raw::unpack( s, size, _max_depth );
+            skip_bytes( s, size.value );
+         }
+      };
+
+      template<typename T>
+      struct skipper<fc::optional<T>> {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            bool b; fc::raw::unpack( s, b, _max_depth );
+            if( b ) fc::raw::skip<T>( s, _max_depth );
+         }
+      };
+
+      template<typename T>
+      struct skipper<std::shared_ptr<T>> {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            fc::raw::skip<std::remove_const_t<T>>( s, _max_depth );
+         }
+      };
+
+      template<typename K, typename V>
+      struct skipper<std::pair<K,V>> {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            fc::raw::skip<K>( s, _max_depth );
+            fc::raw::skip<V>( s, _max_depth );
+         }
+      };
+
+      /** Containers are packed as their size followed by their elements */
+      template<typename T>
+      struct skip_container {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            unsigned_int size; fc::raw::unpack( s, size, _max_depth );
+            skip_elements<T>( s, size.value, _max_depth );
+         }
+      };
+
+      template<typename T>
+      struct skipper<std::vector<T>> : skip_container<T> {};
+      template<typename T>
+      struct skipper<std::deque<T>> : skip_container<T> {};
+      template<typename T>
+      struct skipper<std::set<T>> : skip_container<T> {};
+      template<typename T>
+      struct skipper<std::unordered_set<T>> : skip_container<T> {};
+      template<typename K, typename V>
+      struct skipper<std::map<K,V>> : skip_container<std::pair<K,V>> {};
+      template<typename K, typename V>
+      struct skipper<std::unordered_map<K,V>> : skip_container<std::pair<K,V>> {};
+
+      template<typename... T>
+      struct skipper<static_variant<T...>> {
+         template<typename Stream>
+         static void skip( Stream& s, uint32_t _max_depth ) {
+            static void (*const skip_which[])( Stream&, uint32_t ) = { &fc::raw::skip<T,Stream>... };
+            unsigned_int w; fc::raw::unpack( s, w, _max_depth );
+            FC_ASSERT( w.value < sizeof...(T), "Invalid static_variant tag ${w}", ("w",w.value) );
+            skip_which[w.value]( s, _max_depth );
+         }
+      };
+
+    } // namespace detail
+
+    /**
+     *  Advances the stream past a packed T without unpacking it. Only length prefixes, optional flags and
+     *  static_variant tags are read, everything else is skipped by its size, so that nothing is allocated.
+     *  The skipped data is not validated beyond that. Types of which skip() does not know how they are
+     *  packed are unpacked into a temporary; specialize detail::skipper for them if that matters. Reflected
+     *  types are assumed to be packed as their members, unless a probe of a fixed size type shows otherwise.
+     */
+    template<typename T, typename Stream>
+    inline void skip( Stream& s, uint32_t _max_depth )
+    {
+       FC_ASSERT( _max_depth > 0 );
+       detail::skipper<T>::skip( s, _max_depth - 1 );
+    }
+
 } } // namespace fc::raw
 
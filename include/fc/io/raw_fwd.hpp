@@ -1,5 +1,11 @@
 #pragma once
 #include <boost/endian/buffers.hpp>
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 106100
+#include <boost/utility/string_view.hpp>
+#else
+#include <boost/utility/string_ref.hpp>
+#endif
 
 #include <fc/config.hpp>
 #include <fc/container/flat_fwd.hpp>
@@ -15,6 +21,7 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <set>
+#include <type_traits>
 
 #define MAX_ARRAY_ALLOC_SIZE (1024*1024*10)
 
@@ -25,6 +32,7 @@ namespace fc {
    class variant_object;
    class path;
    template<typename... Types> class static_variant;
+   template<typename T> class datastream;
 
    class sha224;
    class sha256;
@@ -37,9 +45,73 @@ namespace fc {
    namespace ecc { class public_key; class private_key; }
 
    namespace raw {
+    /**
+     *  True for types whose packed representation is identical to their representation in memory,
+     *  so that a contiguous array of them can be packed or unpacked with a single write or read.
+     *  Specialize it for a type whose pack() writes exactly its sizeof() raw bytes.
+     *  @see raw.hpp for the specializations of integers, byte arrays, endian buffers and reflected PODs
+     */
+    template<typename T, typename Dummy = void>
+    struct is_trivially_packable : std::false_type {};
+
+    namespace detail {
+      template<bool Fixed, size_t Size>
+      struct packed_size_info {
+         static constexpr bool   is_fixed = Fixed;
+         static constexpr size_t value    = Size;
+      };
+      template<bool Fixed, size_t Size> constexpr bool   packed_size_info<Fixed,Size>::is_fixed;
+      template<bool Fixed, size_t Size> constexpr size_t packed_size_info<Fixed,Size>::value;
+    }
+
+    /**
+     *  The packed size of types whose packed size does not depend on their value, e.g. for sizing static
+     *  buffers. is_fixed is false for all other types, and value is 0 then.
+     *  Specialize it by deriving from detail::packed_size_info<true,size>.
+     *  @see raw.hpp for the specializations of integers, enums, time points, trivially packable types and
+     *       reflected structs
+     */
+    template<typename T, typename Dummy = void>
+    struct fixed_packed_size : detail::packed_size_info<false,0> {};
+
     template<typename T>
     inline size_t pack_size(  const T& v );
 
+    namespace detail {
+      /** Skips a packed T, see skip(). Specialize it for types whose pack() is not generic. */
+      template<typename T, typename Dummy = void>
+      struct skipper;
+    }
+    template<typename T, typename Stream>
+    inline void skip( Stream& s, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+
+    // zero-copy views, see raw_view.hpp
+#if BOOST_VERSION >= 106100
+    typedef boost::string_view string_view_t;
+#else
+    typedef boost::string_ref  string_view_t;
+#endif
+    class blob_view;
+    template<typename T> class packed_span;
+    template<typename T> class packed_ref;
+    template<typename T> class packed_vector_index;
+
+    template<typename Stream> inline void pack( Stream& s, const string_view_t& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream> inline void unpack( Stream& s, string_view_t& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH ) = delete;
+    inline void unpack( datastream<const char*>& s, string_view_t& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream> inline void pack( Stream& s, const blob_view& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream> inline void unpack( Stream& s, blob_view& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH ) = delete;
+    inline void unpack( datastream<const char*>& s, blob_view& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream, typename T> inline void pack( Stream& s, const packed_span<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream, typename T> inline void unpack( Stream& s, packed_span<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH ) = delete;
+    template<typename T> inline void unpack( datastream<const char*>& s, packed_span<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream, typename T> inline void pack( Stream& s, const packed_ref<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream, typename T> inline void unpack( Stream& s, packed_ref<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH ) = delete;
+    template<typename T> inline void unpack( datastream<const char*>& s, packed_ref<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream, typename T> inline void pack( Stream& s, const packed_vector_index<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename Stream, typename T> inline void unpack( Stream& s, packed_vector_index<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH ) = delete;
+    template<typename T> inline void unpack( datastream<const char*>& s, packed_vector_index<T>& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+
     template<typename Stream, typename IntType, typename EnumType>
     inline void pack( Stream& s, const fc::enum_type<IntType,EnumType>& tp, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
     template<typename Stream, typename IntType, typename EnumType>
@@ -157,6 +229,7 @@ namespace fc {
     template<typename Stream> inline void unpack( Stream& s, bool& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
 
     template<typename T> inline std::vector<char> pack( const T& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+    template<typename T> inline void pack_into( std::vector<char>& buffer, const T& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
     template<typename T> inline T unpack( const std::vector<char>& s, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
     template<typename T> inline T unpack( const char* d, uint32_t s, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
     template<typename T> inline void unpack( const char* d, uint32_t s, T& v, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
@@ -0,0 +1,279 @@
+#pragma once
+#include <fc/io/raw.hpp>
+
+namespace fc { namespace raw {
+
+   /*
+    *  Views that are unpacked from a datastream<const char*> as pointers into its buffer, instead of
+    *  copying the data out of it. The buffer must outlive the views unpacked from it.
+    *
+    *  Each view packs exactly like the type it stands for: string_view_t like std::string, blob_view like
+    *  std::vector<char>, packed_span<T> and packed_vector_index<T> like std::vector<T> and packed_ref<T>
+    *  like T. So a struct can be packed with owning members and unpacked into a struct that has views in
+    *  their place, and a view can be packed again without decoding it.
+    */
+
+   /** A view of a packed std::vector<char> */
+   class blob_view
+   {
+      public:
+         blob_view() {}
+         blob_view( const char* data, size_t size ) : _data(data), _size(size) {}
+
+         const char* data()const  { return _data; }
+         size_t      size()const  { return _size; }
+         bool        empty()const { return _size == 0; }
+         const char* begin()const { return _data; }
+         const char* end()const   { return _data + _size; }
+
+         std::vector<char> to_vector()const { return std::vector<char>( begin(), end() ); }
+
+      private:
+         const char* _data = nullptr;
+         size_t      _size = 0;
+   };
+
+   /**
+    *  A view of a packed std::vector<T> of a trivially packable T. Every element has the packed size
+    *  sizeof(T), so elements can be accessed at random. They are decoded on access.
+    */
+   template<typename T>
+   class packed_span
+   {
+      static_assert( is_trivially_packable<T>::value, "packed_span requires a trivially packable element type" );
+      public:
+         class const_iterator
+         {
+            public:
+               typedef std::random_access_iterator_tag iterator_category;
+               typedef T                               value_type;
+               typedef std::ptrdiff_t                  difference_type;
+               typedef const T*                        pointer;
+               typedef T                               reference;
+
+               const_iterator( const packed_span& span, size_t index ) : _span(&span), _index(index) {}
+
+               T               operator*()const { return (*_span)[_index]; }
+               const_iterator& operator++()     { ++_index; return *this; }
+               const_iterator  operator++(int)  { const_iterator tmp = *this; ++_index; return tmp; }
+               const_iterator& operator+=( difference_type n ) { _index += n; return *this; }
+               difference_type operator-( const const_iterator& o )const { return difference_type(_index - o._index); }
+               bool operator==( const const_iterator& o )const { return _index == o._index; }
+               bool operator!=( const const_iterator& o )const { return _index != o._index; }
+
+            private:
+               const packed_span* _span;
+               size_t             _index;
+         };
+
+         packed_span() {}
+         packed_span( const char* data, size_t count ) : _data(data), _size(count) {}
+
+         size_t      size()const        { return _size; }
+         bool        empty()const       { return _size == 0; }
+         /** @return the packed elements, without the length prefix */
+         const char* data()const        { return _data; }
+         size_t      packed_size()const { return _size * sizeof(T); }
+
+         T operator[]( size_t i )const
+         {
+            const char* packed = _data + i * sizeof(T);
+            T result;
+            if( detail::packed_layout<T>::matches_memory() )
+               memcpy( reinterpret_cast<char*>( &result ), packed, sizeof(T) );
+            else
+            {
+               datastream<const char*> ds( packed, sizeof(T) );
+               fc::raw::unpack( ds, result );
+            }
+            return result;
+         }
+         T at( size_t i )const
+         {
+            FC_ASSERT( i < _size, "Index ${i} is out of range, the span has ${n} elements", ("i",i)("n",_size) );
+            return (*this)[i];
+         }
+
+         const_iterator begin()const { return const_iterator( *this, 0 ); }
+         const_iterator end()const   { return const_iterator( *this, _size ); }
+
+         std::vector<T> to_vector()const { return std::vector<T>( begin(), end() ); }
+
+      private:
+         const char* _data = nullptr;
+         size_t      _size = 0;
+   };
+
+   /**
+    *  The packed form of a T, which is unpacked on first access and then kept. Can be constructed from
+    *  any buffer that holds a packed T. When it is unpacked from a stream, the T is skipped over to find
+    *  its extent, see skip().
+    */
+   template<typename T>
+   class packed_ref
+   {
+      public:
+         packed_ref() {}
+         packed_ref( const char* data, size_t size ) : _data(data), _size(size) {}
+         explicit packed_ref( const blob_view& blob ) : _data(blob.data()), _size(blob.size()) {}
+
+         const T& get()const
+         {
+            if( !_value.valid() )
+               _value = fc::raw::unpack<T>( _data, _size );
+            return *_value;
+         }
+         const T& operator*()const  { return get(); }
+         const T* operator->()const { return &get(); }
+
+         bool        is_unpacked()const { return _value.valid(); }
+         const char* data()const        { return _data; }
+         size_t      size()const        { return _size; }
+
+      private:
+         const char*           _data = nullptr;
+         size_t                _size = 0;
+         mutable optional<T>   _value;
+   };
+
+   /**
+    *  A view of a packed std::vector<T> of any T, which knows where each element starts so that they can be
+    *  accessed at random. Building it skips over the elements once, see skip(). Elements of a fixed packed
+    *  size are located by multiplication and need no offsets.
+    */
+   template<typename T>
+   class packed_vector_index
+   {
+      public:
+         packed_vector_index() {}
+         /** Indexes the packed std::vector<T> at the position of s, and advances s past it */
+         explicit packed_vector_index( datastream<const char*>& s, uint32_t _max_depth = FC_PACK_MAX_DEPTH )
+         {
+            FC_ASSERT( _max_depth > 0 );
+            --_max_depth;
+            unsigned_int size; fc::raw::unpack( s, size, _max_depth );
+            _data = s.pos();
+            _fixed = detail::skip_layout<T>::fixed();
+            if( _fixed )
+            {
+               FC_ASSERT( fixed_packed_size<T>::value == 0 || size.value <= s.remaining() / fixed_packed_size<T>::value,
+                          "Packed vector does not fit into the remaining data" );
+               detail::take_bytes( s, size.value * fixed_packed_size<T>::value );
+            }
+            else
+            {
+               // every element takes at least one byte, so this cannot reserve more than the data holds
+               _offsets.reserve( std::min( size.value, static_cast<uint64_t>(s.remaining()) ) + 1 );
+               _offsets.push_back( 0 );
+               for( uint64_t i = 0; i < size.value; ++i )
+               {
+                  fc::raw::skip<T>( s, _max_depth );
+                  _offsets.push_back( s.pos() - _data );
+               }
+            }
+            _size = size.value;
+         }
+
+         size_t      size()const        { return _size; }
+         bool        empty()const       { return _size == 0; }
+         /** @return the packed elements, without the length prefix */
+         const char* data()const        { return _data; }
+         size_t      packed_size()const { return offset( _size ); }
+         /** @return the position of element i in data(), or the end of the data for i == size() */
+         size_t offset( size_t i )const
+         {
+            return _fixed ? i * fixed_packed_size<T>::value : _offsets[i];
+         }
+
+         packed_ref<T> operator[]( size_t i )const
+         {
+            return packed_ref<T>( _data + offset( i ), offset( i + 1 ) - offset( i ) );
+         }
+         packed_ref<T> at( size_t i )const
+         {
+            FC_ASSERT( i < _size, "Index ${i} is out of range, the vector has ${n} elements", ("i",i)("n",_size) );
+            return (*this)[i];
+         }
+
+      private:
+         const char*         _data = nullptr;
+         size_t              _size = 0;
+         std::vector<size_t> _offsets;
+         bool                _fixed = true; // an empty index needs no offsets
+   };
+
+   template<typename Stream>
+   inline void pack( Stream& s, const string_view_t& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      fc::raw::pack( s, unsigned_int(v.size()), _max_depth - 1 );
+      if( v.size() ) s.write( v.data(), v.size() );
+   }
+   inline void unpack( datastream<const char*>& s, string_view_t& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      unsigned_int size; fc::raw::unpack( s, size, _max_depth - 1 );
+      v = string_view_t( detail::take_bytes( s, size.value ), size.value );
+   }
+
+   template<typename Stream>
+   inline void pack( Stream& s, const blob_view& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      fc::raw::pack( s, unsigned_int(v.size()), _max_depth - 1 );
+      if( v.size() ) s.write( v.data(), v.size() );
+   }
+   inline void unpack( datastream<const char*>& s, blob_view& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      unsigned_int size; fc::raw::unpack( s, size, _max_depth - 1 );
+      v = blob_view( detail::take_bytes( s, size.value ), size.value );
+   }
+
+   template<typename Stream, typename T>
+   inline void pack( Stream& s, const packed_span<T>& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      fc::raw::pack( s, unsigned_int(v.size()), _max_depth - 1 );
+      if( v.size() ) s.write( v.data(), v.packed_size() );
+   }
+   template<typename T>
+   inline void unpack( datastream<const char*>& s, packed_span<T>& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      FC_ASSERT( detail::packed_layout<T>::matches_size(), "Elements do not pack to their size in memory" );
+      unsigned_int size; fc::raw::unpack( s, size, _max_depth - 1 );
+      FC_ASSERT( size.value <= s.remaining() / sizeof(T), "Packed vector does not fit into the remaining data" );
+      v = packed_span<T>( detail::take_bytes( s, size.value * sizeof(T) ), size.value );
+   }
+
+   template<typename Stream, typename T>
+   inline void pack( Stream& s, const packed_ref<T>& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      if( v.size() ) s.write( v.data(), v.size() );
+   }
+   template<typename T>
+   inline void unpack( datastream<const char*>& s, packed_ref<T>& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      const char* start = s.pos();
+      fc::raw::skip<T>( s, _max_depth - 1 );
+      v = packed_ref<T>( start, s.pos() - start );
+   }
+
+   template<typename Stream, typename T>
+   inline void pack( Stream& s, const packed_vector_index<T>& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      fc::raw::pack( s, unsigned_int(v.size()), _max_depth - 1 );
+      if( v.size() ) s.write( v.data(), v.packed_size() );
+   }
+   template<typename T>
+   inline void unpack( datastream<const char*>& s, packed_vector_index<T>& v, uint32_t _max_depth )
+   {
+      FC_ASSERT( _max_depth > 0 );
+      v = packed_vector_index<T>( s, _max_depth - 1 );
+   }
+
+} } // namespace fc::raw
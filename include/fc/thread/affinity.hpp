@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace fc {
+
+   /** Where the threads of a group may run */
+   struct thread_placement {
+      thread_placement() : numa_node(-1), pin_each(false) {}
+
+      /** @return true if the placement restricts anything */
+      bool empty()const { return cpus.empty() && numa_node < 0; }
+
+      /** @return the placement for the index'th thread of a group: a single CPU if
+       *  pin_each is set, the whole set otherwise */
+      thread_placement for_member( size_t index )const;
+
+      std::vector<unsigned> cpus;      ///< allowed CPUs, all CPUs of numa_node if empty
+      int                   numa_node; ///< the NUMA node to run on, or -1
+      bool                  pin_each;  ///< spread the threads of a group over the CPUs, one CPU each
+   };
+
+   /** Groups of threads that fc starts on its own */
+   enum class thread_group {
+      asio_workers, ///< threads running fc::asio::default_io_service()
+      pool_workers  ///< workers of the do_parallel() pool
+   };
+
+   /** Sets the placement of a group. Takes effect for threads started afterwards,
+    *  so this should be called before the group is first used. */
+   void set_thread_placement( thread_group group, const thread_placement& placement );
+   thread_placement get_thread_placement( thread_group group );
+
+   /** Sets the placement of fc::threads that will be created with the given name */
+   void set_thread_placement( const std::string& thread_name, const thread_placement& placement );
+   thread_placement get_thread_placement( const std::string& thread_name );
+
+   /** Restricts the calling thread to the given placement.
+    *  @return false if the platform does not support it, or the placement is invalid */
+   bool apply_thread_placement( const thread_placement& placement );
+
+   /** @return the number of NUMA nodes, 1 on platforms without NUMA information */
+   unsigned numa_node_count();
+   /** @return the CPUs that belong to the given NUMA node */
+   std::vector<unsigned> numa_node_cpus( unsigned node );
+   /** @return the NUMA node the calling thread is running on right now */
+   unsigned current_numa_node();
+
+   namespace detail {
+      /** Applies the placement configured for the given name to the calling thread */
+      void apply_named_thread_placement( const std::string& thread_name );
+   }
+
+} // fc
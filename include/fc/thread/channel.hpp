@@ -0,0 +1,339 @@
+#pragma once
+#include <fc/thread/future.hpp>
+#include <fc/thread/spin_yield_lock.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <type_traits>
+
+namespace fc {
+
+   namespace detail {
+      /** A queue of fibers waiting for a channel to change its state */
+      class channel_waiters {
+      public:
+         channel_waiters();
+         ~channel_waiters();
+
+         /** Adds a waiter. The caller must re-check its condition before waiting on the result. */
+         promise<void>::ptr enqueue();
+         /** Removes a waiter that is no longer waiting. If it has been notified
+          *  already, the notification is passed on to the next waiter. */
+         void cancel( const promise<void>::ptr& waiter );
+
+         void notify_one();
+         void notify_all();
+         bool empty()const { return _count.load() == 0; }
+
+      private:
+         spin_yield_lock                _lock;
+         std::deque<promise<void>::ptr> _waiters;
+         std::atomic<size_t>            _count;
+      };
+
+      /** Blocks until ready() returns true, waiting in the given queue in between */
+      template<typename Ready>
+      void wait_for_channel( channel_waiters& waiters, Ready&& ready )
+      {
+         promise<void>::ptr waiter = waiters.enqueue();
+         if( ready() )
+         {
+            waiters.cancel( waiter );
+            return;
+         }
+         std::exception_ptr e; // cancel() may yield, so it must not be called from a catch block
+         try
+         {
+            waiter->wait();
+         }
+         catch( ... )
+         {
+            e = std::current_exception();
+         }
+         if( e )
+         {
+            waiters.cancel( waiter );
+            std::rethrow_exception( e );
+         }
+      }
+   }
+
+   /**
+    *  @brief a bounded queue for passing values between fibers and threads
+    *
+    *  Any number of producers and consumers may use a channel concurrently. Values
+    *  are stored in a lock-free ring buffer. When it is full, producers block until
+    *  a consumer has made room, and when it is empty consumers block until a value
+    *  arrives. Blocking works like waiting on a future: a fiber lets other tasks of
+    *  its thread run, and a thread without other tasks sleeps.
+    *
+    *  A blocked fiber can be canceled, in which case the blocking call throws
+    *  canceled_exception and the channel is left unchanged.
+    *
+    *  After close() no more values are accepted, and consumers receive the values
+    *  that are still buffered before they are told that the channel is closed.
+    */
+   template<typename T>
+   class channel {
+   public:
+      /** @param capacity the maximum number of buffered values, rounded up to a power of two (at least 2) */
+      explicit channel( size_t capacity )
+         : _mask( round_up( capacity ) - 1 ), _slots( new slot[_mask + 1] ), _head(0), _tail(0), _closed(false)
+      {
+         for( size_t i = 0; i <= _mask; ++i )
+            _slots[i].sequence.store( i, std::memory_order_relaxed );
+      }
+
+      ~channel()
+      {
+         T value;
+         while( try_dequeue( value ) );
+      }
+
+      channel( const channel& ) = delete;
+      channel& operator=( const channel& ) = delete;
+
+      /** @return false if the channel is full or closed */
+      bool try_push( T value )
+      {
+         if( closed() || !try_enqueue( value ) )
+            return false;
+         value_pushed();
+         return true;
+      }
+
+      /** @return false if the channel is empty */
+      bool try_pop( T& value )
+      {
+         if( !try_dequeue( value ) )
+            return false;
+         value_popped();
+         return true;
+      }
+
+      /**
+       *  Adds a value, blocking while the channel is full.
+       *  @return false if the channel has been closed, the value is dropped then
+       */
+      bool push( T value )
+      {
+         while( !closed() )
+         {
+            if( try_enqueue( value ) )
+            {
+               value_pushed();
+               return true;
+            }
+            detail::wait_for_channel( _producers, [this] { return closed() || !full(); } );
+         }
+         return false;
+      }
+
+      /**
+       *  Removes the oldest value, blocking while the channel is empty.
+       *  @return false if the channel has been closed and is empty
+       */
+      bool pop( T& value )
+      {
+         for(;;)
+         {
+            if( try_dequeue( value ) )
+            {
+               value_popped();
+               return true;
+            }
+            if( closed() && empty() )
+               return false;
+            detail::wait_for_channel( _consumers, [this] { return closed() || !empty(); } );
+         }
+      }
+
+      /**
+       *  Adds <code>count</code> values starting at <code>first</code>, blocking whenever
+       *  the channel is full. Checking for blocked consumers is done once per batch.
+       *  @return the number of values added, which is less than <code>count</code> only
+       *          if the channel has been closed
+       */
+      template<typename InputIterator>
+      size_t push_n( InputIterator first, size_t count )
+      {
+         size_t pushed = 0;
+         while( pushed < count && !closed() )
+         {
+            const size_t before = pushed;
+            while( pushed < count )
+            {
+               T value( *first );
+               if( !try_enqueue( value ) )
+                  break;
+               ++first;
+               ++pushed;
+            }
+            if( pushed > before )
+               values_pushed( pushed - before );
+            if( pushed < count )
+               detail::wait_for_channel( _producers, [this] { return closed() || !full(); } );
+         }
+         return pushed;
+      }
+
+      /**
+       *  Removes up to <code>max_count</code> values and writes them to <code>out</code>.
+       *  Blocks until at least one value is available, but not for more. Checking for
+       *  blocked producers is done once per batch.
+       *  @return the number of values removed, 0 only if the channel is closed and empty
+       */
+      template<typename OutputIterator>
+      size_t pop_n( OutputIterator out, size_t max_count )
+      {
+         if( max_count == 0 )
+            return 0;
+         for(;;)
+         {
+            size_t popped = 0;
+            T value;
+            while( popped < max_count && try_dequeue( value ) )
+            {
+               *out = std::move( value );
+               ++out;
+               ++popped;
+            }
+            if( popped > 0 )
+            {
+               values_popped( popped );
+               return popped;
+            }
+            if( closed() && empty() )
+               return 0;
+            detail::wait_for_channel( _consumers, [this] { return closed() || !empty(); } );
+         }
+      }
+
+      /** Stops accepting values and wakes up all blocked producers and consumers */
+      void close()
+      {
+         _closed.store( true );
+         _producers.notify_all();
+         _consumers.notify_all();
+      }
+
+      bool   closed()const   { return _closed.load(); }
+      size_t capacity()const { return _mask + 1; }
+      /** @return the number of buffered values, which may be outdated already */
+      size_t size()const
+      {
+         const uint64_t head = _head.load();
+         const uint64_t tail = _tail.load();
+         return tail > head ? size_t( tail - head ) : 0;
+      }
+      bool   empty()const    { return size() == 0; }
+      bool   full()const     { return size() >= capacity(); }
+
+   private:
+      struct slot {
+         std::atomic<uint64_t>                                        sequence;
+         typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+      };
+
+      static size_t round_up( size_t capacity )
+      {
+         // the ring cannot tell a full slot from an empty one with a single slot
+         size_t result = 2;
+         while( result < capacity )
+            result <<= 1;
+         return result;
+      }
+
+      /** Bounded MPMC queue after Dmitry Vyukov: each slot's sequence number tells
+       *  whether it is ready for the producer or the consumer at a given position. */
+      bool try_enqueue( T& value )
+      {
+         uint64_t pos = _tail.load( std::memory_order_relaxed );
+         for(;;)
+         {
+            slot& s = _slots[ pos & _mask ];
+            const int64_t diff = int64_t( s.sequence.load( std::memory_order_acquire ) ) - int64_t( pos );
+            if( diff == 0 )
+            {
+               if( _tail.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+               {
+                  new (&s.storage) T( std::move( value ) );
+                  s.sequence.store( pos + 1, std::memory_order_release );
+                  return true;
+               }
+            }
+            else if( diff < 0 )
+               return false;
+            else
+               pos = _tail.load( std::memory_order_relaxed );
+         }
+      }
+
+      bool try_dequeue( T& value )
+      {
+         uint64_t pos = _head.load( std::memory_order_relaxed );
+         for(;;)
+         {
+            slot& s = _slots[ pos & _mask ];
+            const int64_t diff = int64_t( s.sequence.load( std::memory_order_acquire ) ) - int64_t( pos + 1 );
+            if( diff == 0 )
+            {
+               if( _head.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+               {
+                  T* stored = reinterpret_cast<T*>( &s.storage );
+                  value = std::move( *stored );
+                  stored->~T();
+                  s.sequence.store( pos + _mask + 1, std::memory_order_release );
+                  return true;
+               }
+            }
+            else if( diff < 0 )
+               return false;
+            else
+               pos = _head.load( std::memory_order_relaxed );
+         }
+      }
+
+      // the fences pair up with the one in channel_waiters::enqueue(), so that either the
+      // waiter sees the change, or we see the waiter
+      void value_pushed()
+      {
+         std::atomic_thread_fence( std::memory_order_seq_cst );
+         if( !_consumers.empty() )
+            _consumers.notify_one();
+      }
+      void values_pushed( size_t count )
+      {
+         std::atomic_thread_fence( std::memory_order_seq_cst );
+         for( size_t i = 0; i < count && !_consumers.empty(); ++i )
+            _consumers.notify_one();
+      }
+      void value_popped()
+      {
+         std::atomic_thread_fence( std::memory_order_seq_cst );
+         if( !_producers.empty() )
+            _producers.notify_one();
+      }
+      void values_popped( size_t count )
+      {
+         std::atomic_thread_fence( std::memory_order_seq_cst );
+         for( size_t i = 0; i < count && !_producers.empty(); ++i )
+            _producers.notify_one();
+      }
+
+      const size_t                     _mask;
+      std::unique_ptr<slot[]>          _slots;
+      // keep consumers and producers on separate cache lines
+      char                             _pad1[64];
+      std::atomic<uint64_t>            _head;
+      char                             _pad2[64];
+      std::atomic<uint64_t>            _tail;
+      char                             _pad3[64];
+      std::atomic<bool>                _closed;
+      detail::channel_waiters          _producers;
+      detail::channel_waiters          _consumers;
+   };
+
+} // fc
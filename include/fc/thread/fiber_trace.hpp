@@ -0,0 +1,33 @@
+#pragma once
+
+namespace fc {
+   class path;
+   class variant;
+
+   /**
+    *  Enables or disables recording of fiber execution events.
+    *
+    *  While enabled, every thread records when tasks are posted, when they start,
+    *  block, yield, resume and complete, and when a blocked task is woken up.
+    *  Events go into a lock-free ring buffer of FC_FIBER_TRACE_BUFFER_SIZE events
+    *  per thread, so only the most recent events are kept.
+    *
+    *  When disabled, each of these points costs a single relaxed atomic load.
+    */
+   void enable_fiber_tracing( bool enable );
+
+   /** Discards all events recorded so far */
+   void clear_fiber_trace();
+
+   /**
+    *  @return the recorded events in Chrome's trace event format, as understood
+    *          by chrome://tracing and Perfetto. Task executions are duration
+    *          events named after the task description, posting a task starts a
+    *          flow that ends where the task starts running.
+    */
+   variant get_fiber_trace();
+
+   /** Writes the result of get_fiber_trace() to the given file as JSON */
+   void write_fiber_trace( const path& file );
+
+} // fc
@@ -1,11 +1,14 @@
 #pragma once
 #include <fc/time.hpp>
 #include <fc/exception/exception.hpp>
+#include <fc/thread/small_object_pool.hpp>
 #include <fc/thread/spin_yield_lock.hpp>
 #include <fc/optional.hpp>
 
 #include <atomic>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
 //#define FC_TASK_NAMES_ARE_MANDATORY 1
 #ifdef FC_TASK_NAMES_ARE_MANDATORY
@@ -25,12 +28,17 @@ namespace fc {
   struct void_t{};
   class priority;
   class thread;
+  class promise_base;
 
   namespace detail {
      class completion_handler {
        public:
+          completion_handler():_next(nullptr){}
           virtual ~completion_handler(){};
           virtual void on_complete( const void* v, const fc::exception_ptr& e ) = 0;
+       private:
+          friend class fc::promise_base;
+          completion_handler* _next;
      };
      
      template<typename Functor, typename T>
@@ -80,6 +88,8 @@ namespace fc {
       void _notify();
       void _set_value(const void* v);
 
+      /** Registers c, or calls it right away if this promise is ready already.
+       *  Takes ownership of c and deletes it after it has been called. */
       void _on_complete( detail::completion_handler* c );
 
     private:
@@ -102,6 +112,8 @@ namespace fc {
     private:
 #endif
       const char*                   _desc;
+      const void*                   _value;
+      // registered handlers, most recent first; a marker once the handlers have been called
       std::atomic<detail::completion_handler*> _compl;
   };
 
@@ -113,15 +125,15 @@ namespace fc {
 
       static ptr create( const char* desc FC_TASK_NAME_DEFAULT_ARG )
       {
-         return ptr( new promise<T>( desc ) );
+         return std::allocate_shared< promise<T> >( detail::pool_allocator< promise<T> >(), desc );
       }
       static ptr create( const T& val )
       {
-         return ptr( new promise<T>( val ) );
+         return std::allocate_shared< promise<T> >( detail::pool_allocator< promise<T> >(), val );
       }
       static ptr create( T&& val )
       {
-         return ptr( new promise<T>( std::move(val) ) );
+         return std::allocate_shared< promise<T> >( detail::pool_allocator< promise<T> >(), std::move(val) );
       }
 
       const T& wait(const microseconds& timeout = microseconds::maximum() ){
@@ -145,9 +157,10 @@ namespace fc {
 
       template<typename CompletionHandler>
       void on_complete( CompletionHandler&& c ) {
-        _on_complete( new detail::completion_handler_impl<CompletionHandler,T>(std::forward<CompletionHandler>(c)) );
+        _on_complete( new detail::completion_handler_impl<std::decay_t<CompletionHandler>,T>(std::forward<CompletionHandler>(c)) );
       }
     protected:
+      template<typename> friend class detail::pool_allocator;
       promise( const char* desc ):promise_base(desc){}
       promise( const T& val ){ set_value(val); }
       promise( T&& val ){ set_value(std::move(val) ); }
@@ -164,11 +177,11 @@ namespace fc {
     
       static ptr create( const char* desc FC_TASK_NAME_DEFAULT_ARG )
       {
-         return ptr( new promise<void>( desc ) );
+         return std::allocate_shared< promise<void> >( detail::pool_allocator< promise<void> >(), desc );
       }
       static ptr create( bool fulfilled, const char* desc FC_TASK_NAME_DEFAULT_ARG )
       {
-         return ptr( new promise<void>( fulfilled, desc ) );
+         return std::allocate_shared< promise<void> >( detail::pool_allocator< promise<void> >(), fulfilled, desc );
       }
 
       void wait(const microseconds& timeout = microseconds::maximum() ){
@@ -183,15 +196,53 @@ namespace fc {
 
       template<typename CompletionHandler>
       void on_complete( CompletionHandler&& c ) {
-        _on_complete( new detail::completion_handler_impl<CompletionHandler,void>(std::forward<CompletionHandler>(c)) );
+        _on_complete( new detail::completion_handler_impl<std::decay_t<CompletionHandler>,void>(std::forward<CompletionHandler>(c)) );
       }
     protected:
+      template<typename> friend class detail::pool_allocator;
       promise( const char* desc ):promise_base(desc){}
       promise( bool fulfilled, const char* desc ){
           if( fulfilled ) set_value();
       }
   };
   
+  namespace detail {
+     template<typename Result>
+     struct promise_setter {
+        template<typename Functor, typename... Args>
+        static void call( promise<Result>& p, Functor& f, Args&&... args ) {
+           p.set_value( f( std::forward<Args>(args)... ) );
+        }
+     };
+     template<>
+     struct promise_setter<void> {
+        template<typename Functor, typename... Args>
+        static void call( promise<void>& p, Functor& f, Args&&... args ) {
+           f( std::forward<Args>(args)... );
+           p.set_value();
+        }
+     };
+
+     /** Calls f with the given arguments and stores its result or exception in p */
+     template<typename Result, typename Functor, typename... Args>
+     void fulfill_promise( promise<Result>& p, Functor& f, Args&&... args ) {
+        try
+        {
+           promise_setter<Result>::call( p, f, std::forward<Args>(args)... );
+        }
+        catch( const exception& e )
+        {
+           p.set_exception( e.dynamic_copy_exception() );
+        }
+        catch( ... )
+        {
+           p.set_exception( std::make_shared<unhandled_exception>(
+                               FC_LOG_MESSAGE( warn, "unhandled exception in continuation ${desc}",
+                                               ("desc", p.get_desc() ? p.get_desc() : "") ) ) );
+        }
+     }
+  }
+
   /**
    *  @brief a placeholder for the result of an asynchronous operation.
    *
@@ -269,11 +320,46 @@ namespace fc {
        * The given completion handler will be called from some
        * arbitrary thread and should not 'block'. Generally
        * it should post an event or start a new async operation.
+       * If the future is ready already, the handler is called
+       * right away. Several handlers can be registered.
        */
       template<typename CompletionHandler>
-      void on_complete( CompletionHandler&& c ) {
+      void on_complete( CompletionHandler&& c )const {
         m_prom->on_complete( std::forward<CompletionHandler>(c) );
       }
+
+      /**
+       * @pre valid()
+       *
+       * Calls <code>f</code> with the value of this future once it is ready, without
+       * blocking a fiber until then. <code>f</code> runs inline in the thread that
+       * completes this future (or in the calling thread, if it is ready already), so
+       * like a completion handler it must not block.
+       *
+       * @return a future for the result of <code>f</code>. If this future fails,
+       *         <code>f</code> is not called and the result fails with the same exception.
+       */
+      template<typename Functor>
+      auto then( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG )const
+         -> future<decltype(f(std::declval<const T&>()))> {
+        typedef decltype(f(std::declval<const T&>())) Result;
+        typename promise<Result>::ptr result = promise<Result>::create( desc );
+        on_complete( [result,f=std::forward<Functor>(f)]( const T& v, const exception_ptr& e ) mutable {
+           if( e )
+              result->set_exception( e );
+           else
+              detail::fulfill_promise( *result, f, v );
+        } );
+        return future<Result>( result );
+      }
+
+      /**
+       * Like then(f, desc), but <code>f</code> is posted as a task to thread
+       * <code>t</code>, where it may block. Defined in thread.hpp.
+       */
+      template<typename Functor>
+      auto then( thread& t, Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG )const
+         -> future<decltype(f(std::declval<const T&>()))>;
     private:
       friend class thread;
       typename promise<T>::ptr m_prom;
@@ -331,14 +417,145 @@ namespace fc {
 
       void cancel(const char* reason FC_CANCELATION_REASON_DEFAULT_ARG) const { if( m_prom ) m_prom->cancel(reason); }
 
+      /// @pre valid()
+      /// @see future<T>::on_complete
       template<typename CompletionHandler>
-      void on_complete( CompletionHandler&& c ) {
+      void on_complete( CompletionHandler&& c )const {
         m_prom->on_complete( std::forward<CompletionHandler>(c) );
       }
 
+      /// @pre valid()
+      /// @see future<T>::then
+      template<typename Functor>
+      auto then( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG )const -> future<decltype(f())> {
+        typedef decltype(f()) Result;
+        typename promise<Result>::ptr result = promise<Result>::create( desc );
+        on_complete( [result,f=std::forward<Functor>(f)]( const exception_ptr& e ) mutable {
+           if( e )
+              result->set_exception( e );
+           else
+              detail::fulfill_promise( *result, f );
+        } );
+        return future<Result>( result );
+      }
+
+      /// @see future<T>::then
+      template<typename Functor>
+      auto then( thread& t, Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG )const -> future<decltype(f())>;
+
     private:
       friend class thread;
       typename promise<void>::ptr m_prom;
   };
+
+  namespace detail {
+     template<typename T>
+     struct when_all_state {
+        when_all_state( size_t count, const char* desc )
+           : values(count), remaining(count), failed(false), result( promise<std::vector<T>>::create( desc ) ) {}
+
+        std::vector<optional<T>>              values;
+        std::atomic<size_t>                   remaining;
+        std::atomic<bool>                     failed;
+        typename promise<std::vector<T>>::ptr result;
+     };
+
+     struct when_all_void_state {
+        when_all_void_state( size_t count, const char* desc )
+           : remaining(count), failed(false), result( promise<void>::create( desc ) ) {}
+
+        std::atomic<size_t>   remaining;
+        std::atomic<bool>     failed;
+        promise<void>::ptr    result;
+     };
+
+     struct when_any_state {
+        when_any_state( const char* desc ) : done(false), result( promise<size_t>::create( desc ) ) {}
+
+        std::atomic<bool>     done;
+        promise<size_t>::ptr  result;
+     };
+
+     template<typename T, typename Functor>
+     void on_complete_without_value( const future<T>& f, Functor&& handler ) {
+        f.on_complete( [handler]( const T&, const exception_ptr& e ) mutable { handler( e ); } );
+     }
+     template<typename Functor>
+     void on_complete_without_value( const future<void>& f, Functor&& handler ) {
+        f.on_complete( std::forward<Functor>(handler) );
+     }
+  }
+
+  /**
+   *  @return a future for the values of all the given futures, in the same order.
+   *          If one of them fails, the result fails with its exception as soon as
+   *          that happens, without waiting for the others.
+   *
+   *  Unlike waiting for each of the futures in turn, this does not block a fiber.
+   */
+  template<typename T>
+  future<std::vector<T>> when_all( const std::vector<future<T>>& futures, const char* desc FC_TASK_NAME_DEFAULT_ARG ) {
+     auto state = std::make_shared<detail::when_all_state<T>>( futures.size(), desc );
+     typename promise<std::vector<T>>::ptr result = state->result;
+     if( futures.empty() )
+        result->set_value( std::vector<T>() );
+     for( size_t i = 0; i < futures.size(); ++i )
+        futures[i].on_complete( [state,i]( const T& v, const exception_ptr& e ) {
+           if( e )
+           {
+              if( !state->failed.exchange( true ) )
+                 state->result->set_exception( e );
+              return;
+           }
+           state->values[i] = v;
+           if( state->remaining.fetch_sub( 1 ) == 1 && !state->failed.load() )
+           {
+              std::vector<T> values;
+              values.reserve( state->values.size() );
+              for( auto& value : state->values )
+                 values.push_back( std::move( *value ) );
+              state->result->set_value( std::move( values ) );
+           }
+        } );
+     return future<std::vector<T>>( result );
+  }
+
+  /** @see when_all */
+  inline future<void> when_all( const std::vector<future<void>>& futures, const char* desc FC_TASK_NAME_DEFAULT_ARG ) {
+     auto state = std::make_shared<detail::when_all_void_state>( futures.size(), desc );
+     promise<void>::ptr result = state->result;
+     if( futures.empty() )
+        result->set_value();
+     for( const auto& f : futures )
+        f.on_complete( [state]( const exception_ptr& e ) {
+           if( e )
+           {
+              if( !state->failed.exchange( true ) )
+                 state->result->set_exception( e );
+           }
+           else if( state->remaining.fetch_sub( 1 ) == 1 && !state->failed.load() )
+              state->result->set_value();
+        } );
+     return future<void>( result );
+  }
+
+  /**
+   *  @return a future for the index of the first of the given futures that becomes
+   *          ready. That future may have failed, its result can be retrieved from
+   *          it without blocking.
+   *  @pre !futures.empty()
+   */
+  template<typename T>
+  future<size_t> when_any( const std::vector<future<T>>& futures, const char* desc FC_TASK_NAME_DEFAULT_ARG ) {
+     FC_ASSERT( !futures.empty(), "when_any needs at least one future" );
+     auto state = std::make_shared<detail::when_any_state>( desc );
+     promise<size_t>::ptr result = state->result;
+     for( size_t i = 0; i < futures.size(); ++i )
+        detail::on_complete_without_value( futures[i], [state,i]( const exception_ptr& ) {
+           if( !state->done.exchange( true ) )
+              state->result->set_value( i );
+        } );
+     return future<size_t>( result );
+  }
 } 
 
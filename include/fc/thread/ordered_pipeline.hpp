@@ -0,0 +1,186 @@
+#pragma once
+#include <fc/thread/parallel.hpp>
+#include <fc/thread/semaphore.hpp>
+#include <fc/optional.hpp>
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+
+namespace fc {
+
+   /**
+    *  @brief a two-stage pipeline: a parallel map stage, then an ordered commit stage
+    *
+    *  Each item that is pushed is mapped by <code>map(item)</code> in the worker
+    *  pool, in parallel with other items. Then <code>commit(item, result)</code>
+    *  is called, strictly in the order the items were pushed, and never for two
+    *  items at the same time. Commits are performed by whichever pool worker
+    *  finishes the map of the oldest pending item, so nobody waits for its turn
+    *  the way serial_valve::do_serial() does.
+    *
+    *  At most <code>window</code> items are in flight; push() waits while the
+    *  window is full. Items and results are kept in a ring of window slots that
+    *  is allocated once, the map tasks themselves come from the task pool.
+    *
+    *  If map or commit throws, the items after the failed one are not committed
+    *  anymore. The exception is rethrown by flush(), which also resets the
+    *  pipeline, and by push() until then.
+    *
+    *  push() and flush() must not be called concurrently.
+    */
+   template<typename In, typename Out>
+   class ordered_pipeline {
+   public:
+      typedef std::function<Out(const In&)>   map_function;
+      typedef std::function<void(In&, Out&)>  commit_function;
+
+      /** @param window maximum number of items in flight, four per pool worker if 0 */
+      ordered_pipeline( map_function map, commit_function commit, size_t window = 0,
+                        const char* desc FC_TASK_NAME_DEFAULT_ARG )
+      : _map( std::move(map) ), _commit( std::move(commit) ),
+        _window( window > 0 ? window : 4 * size_t( std::max( detail::get_worker_pool().size(), uint16_t(1) ) ) ),
+        _slots( new slot[_window] ), _permits( _window ), _desc( desc ) {}
+
+      /** Waits until all items have been committed */
+      ~ordered_pipeline()
+      {
+         try
+         {
+            flush();
+         }
+         catch( ... ) {}
+      }
+
+      ordered_pipeline( const ordered_pipeline& ) = delete;
+      ordered_pipeline& operator=( const ordered_pipeline& ) = delete;
+
+      /** Adds an item, waiting for a free slot if the window is full */
+      void push( In item )
+      {
+         rethrow_failure();
+         _permits.acquire();
+         slot& s = _slots[ _next_push % _window ];
+         // the slot is free, but the task that last used it may still be on its way out
+         if( s.task.valid() )
+            s.task.wait();
+         s.in = std::move( item );
+         const uint64_t seq = _next_push++;
+         s.task = fc::do_parallel( [this,seq] () { process( seq ); }, _desc );
+      }
+
+      /** Waits until all items pushed so far have been committed, and rethrows the
+       *  first failure, if any. The pipeline can be used again afterwards. */
+      void flush()
+      {
+         for( size_t i = 0; i < _window; ++i )
+            _permits.acquire();
+         _permits.release( _window );
+         for( size_t i = 0; i < _window; ++i )
+            if( _slots[i].task.valid() )
+               _slots[i].task.wait();
+         if( _failed.load() )
+         {
+            std::exception_ptr e = _error;
+            _error = nullptr;
+            _failed.store( false );
+            std::rethrow_exception( e );
+         }
+      }
+
+      /** @return the maximum number of items in flight */
+      size_t window()const { return _window; }
+
+   private:
+      struct slot {
+         fc::optional<In>    in;
+         fc::optional<Out>   out;
+         std::exception_ptr  error;
+         std::atomic<bool>   mapped{ false };
+         fc::future<void>    task;
+      };
+
+      void rethrow_failure()const
+      {
+         if( _failed.load() )
+            std::rethrow_exception( _error );
+      }
+
+      void process( uint64_t seq )
+      {
+         slot& s = _slots[ seq % _window ];
+         try
+         {
+            if( !_failed.load() )
+               s.out = _map( *s.in );
+         }
+         catch( ... )
+         {
+            s.error = std::current_exception();
+         }
+         s.mapped.store( true );
+         commit_ready();
+      }
+
+      /** Commits consecutive mapped items, unless another worker does so already */
+      void commit_ready()
+      {
+         while( !_committing.exchange( true ) )
+         {
+            uint64_t pos = _next_commit;
+            unsigned freed = 0;
+            for( ; _slots[ pos % _window ].mapped.load(); ++pos, ++freed )
+            {
+               slot& s = _slots[ pos % _window ];
+               if( !_failed.load() )
+               {
+                  if( s.error )
+                     fail( s.error );
+                  else
+                  {
+                     try
+                     {
+                        _commit( *s.in, *s.out );
+                     }
+                     catch( ... )
+                     {
+                        fail( std::current_exception() );
+                     }
+                  }
+               }
+               s.in.reset();
+               s.out.reset();
+               s.error = nullptr;
+               s.mapped.store( false );
+            }
+            _next_commit = pos;
+            _committing.store( false );
+            if( freed > 0 )
+               _permits.release( freed );
+            // an item may have been mapped after the loop ended but before the flag was cleared
+            if( !_slots[ pos % _window ].mapped.load() )
+               return;
+         }
+      }
+
+      void fail( const std::exception_ptr& e )
+      {
+         _error = e;
+         _failed.store( true );
+      }
+
+      const map_function       _map;
+      const commit_function    _commit;
+      const size_t             _window;
+      std::unique_ptr<slot[]>  _slots;
+      fc::semaphore            _permits;
+      const char*              _desc;
+      uint64_t                 _next_push = 0;   ///< written by the producer only
+      uint64_t                 _next_commit = 0; ///< written by the committing worker only
+      std::atomic<bool>        _committing{ false };
+      std::atomic<bool>        _failed{ false };
+      std::exception_ptr       _error;
+   };
+
+} // fc
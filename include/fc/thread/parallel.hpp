@@ -27,9 +27,16 @@
 #include <fc/thread/task.hpp>
 #include <fc/thread/thread.hpp>
 #include <fc/asio.hpp>
+#include <fc/optional.hpp>
 
 #include <boost/atomic/atomic.hpp>
 
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
 namespace fc {
 
    namespace detail {
@@ -38,8 +45,15 @@ namespace fc {
       class worker_pool {
       public:
          worker_pool();
+         /** Creates a separate pool with the given number of workers, whose
+          *  threads are named after name */
+         explicit worker_pool( uint16_t num_threads, const std::string& name = "pool worker" );
          ~worker_pool();
+         /** @return the number of worker threads */
+         uint16_t size()const;
          void post( task_base* task );
+         /** Posts several tasks at once, see fc::post_batch() */
+         void post_batch( const std::vector<task_base*>& tasks );
       private:
           pool_impl*    my;
       };
@@ -104,4 +118,193 @@ namespace fc {
       detail::get_worker_pool().post( tsk.get() );
       return r;
    }
+
+   /**
+    *  Calls each functor of the range [begin,end) in the worker pool, as separate
+    *  tasks. Idle workers are claimed once for the whole batch, and the tasks that
+    *  no idle worker takes are queued in one go. Posted from a pool worker, the
+    *  tasks go to the worker's own queue in one step, and idle workers are woken up
+    *  to steal them.
+    *
+    *  @return the futures of the tasks, in the order of the functors
+    */
+   template<typename Iterator>
+   auto post_batch( Iterator begin, Iterator end, const char* desc FC_TASK_NAME_DEFAULT_ARG )
+      -> std::vector<fc::future<decltype((*begin)())>> {
+      std::vector<task_base*> tasks;
+      auto results = detail::create_task_batch( begin, end, desc, tasks );
+      detail::get_worker_pool().post_batch( tasks );
+      return results;
+   }
+
+   namespace detail {
+      /** @return the number of batches a range of the given size should be split into.
+       *  Creates a few batches per pool worker so that stealing can balance uneven
+       *  work, but never makes batches smaller than min_batch_size.
+       */
+      inline size_t get_batch_count( size_t elements, size_t min_batch_size )
+      {
+         if( elements == 0 )
+            return 0;
+         if( min_batch_size == 0 )
+            min_batch_size = 1;
+         const size_t max_batches = 4 * size_t( std::max( get_worker_pool().size(), uint16_t(1) ) );
+         return std::min( ( elements + min_batch_size - 1 ) / min_batch_size, max_batches );
+      }
+
+      /** Invokes f(0) ... f(batches-1), all but the first of them in the worker
+       *  pool. The first batch is processed by the calling thread.
+       *  Waits until all batches have completed, then rethrows the first
+       *  exception that occurred, if any.
+       */
+      template<typename Functor>
+      void run_batches( size_t batches, Functor& f, const char* desc )
+      {
+         if( batches == 0 )
+            return;
+         std::vector<fc::future<void>> results;
+         results.reserve( batches - 1 );
+         std::exception_ptr first_error;
+         try
+         {
+            for( size_t b = 1; b < batches; b++ )
+               results.push_back( do_parallel( [&f,b] () { f(b); }, desc ) );
+            f(0);
+         }
+         catch( ... )
+         {
+            first_error = std::current_exception();
+         }
+         for( auto& result : results )
+         {
+            try
+            {
+               result.wait();
+            }
+            catch( ... )
+            {
+               if( !first_error )
+                  first_error = std::current_exception();
+            }
+         }
+         if( first_error )
+            std::rethrow_exception( first_error );
+      }
+
+      /** @return the start of the given batch when [begin,end) is split into batches parts */
+      template<typename Iterator>
+      Iterator batch_begin( Iterator begin, Iterator end, size_t batches, size_t batch )
+      {
+         return begin + ( ( end - begin ) * batch / batches );
+      }
+   }
+
+   /**
+    *  Calls <code>f(*i)</code> for each element of the range [begin,end). The
+    *  range is split into batches that are processed in parallel by the
+    *  worker pool and by the calling thread. Only one task is created per
+    *  batch, not per element.
+    *
+    *  Returns after all elements have been processed. If any invocation of
+    *  <code>f</code> throws, the first exception is rethrown after all batches
+    *  have completed. The remaining elements of a failed batch are skipped.
+    *
+    *  @param begin random-access iterator pointing to the first element
+    *  @param end random-access iterator pointing behind the last element
+    *  @param f the operation to perform on each element
+    *  @param min_batch_size the minimum number of elements per batch
+    */
+   template<typename Iterator, typename Functor>
+   void parallel_for( Iterator begin, Iterator end, Functor&& f, size_t min_batch_size = 1,
+                      const char* desc FC_TASK_NAME_DEFAULT_ARG )
+   {
+      const size_t batches = detail::get_batch_count( end - begin, min_batch_size );
+      auto batch_fn = [begin,end,batches,&f] ( size_t b ) {
+         const Iterator last = detail::batch_begin( begin, end, batches, b + 1 );
+         for( Iterator i = detail::batch_begin( begin, end, batches, b ); i != last; ++i )
+            f( *i );
+      };
+      detail::run_batches( batches, batch_fn, desc );
+   }
+
+   /**
+    *  Computes <code>reduce( ... reduce( reduce( init, transform(*begin) ), transform(*(begin+1)) ) ... )</code>
+    *  in parallel. <code>reduce</code> must be associative, because partial
+    *  results are computed per batch and combined afterwards, in order.
+    *
+    *  @param begin random-access iterator pointing to the first element
+    *  @param end random-access iterator pointing behind the last element
+    *  @param init the initial value, returned for an empty range
+    *  @param reduce combines two values of type T
+    *  @param transform converts an element into a value of type T
+    *  @param min_batch_size the minimum number of elements per batch
+    *  @return the reduced value
+    */
+   template<typename Iterator, typename T, typename Reduce, typename Transform>
+   T parallel_transform_reduce( Iterator begin, Iterator end, T init, Reduce&& reduce, Transform&& transform,
+                                size_t min_batch_size = 1, const char* desc FC_TASK_NAME_DEFAULT_ARG )
+   {
+      const size_t batches = detail::get_batch_count( end - begin, min_batch_size );
+      std::vector<fc::optional<T>> partial( batches );
+      auto batch_fn = [begin,end,batches,&partial,&reduce,&transform] ( size_t b ) {
+         const Iterator last = detail::batch_begin( begin, end, batches, b + 1 );
+         Iterator i = detail::batch_begin( begin, end, batches, b );
+         T result = transform( *i );
+         for( ++i; i != last; ++i )
+            result = reduce( std::move(result), transform( *i ) );
+         partial[b] = std::move(result);
+      };
+      detail::run_batches( batches, batch_fn, desc );
+      for( auto& p : partial )
+         init = reduce( std::move(init), std::move(*p) );
+      return init;
+   }
+
+   /**
+    *  Sorts the range [begin,end) using a parallel merge sort. The range is
+    *  split into batches that are sorted in parallel, then neighbouring runs
+    *  are merged pairwise in parallel until a single run remains.
+    *  The sort is not stable.
+    *
+    *  @param begin random-access iterator pointing to the first element
+    *  @param end random-access iterator pointing behind the last element
+    *  @param comp the comparison function, as for std::sort
+    *  @param min_batch_size the minimum number of elements per batch
+    */
+   template<typename Iterator, typename Compare = std::less<>>
+   void parallel_sort( Iterator begin, Iterator end, Compare comp = Compare(), size_t min_batch_size = 1024,
+                       const char* desc FC_TASK_NAME_DEFAULT_ARG )
+   {
+      const size_t batches = detail::get_batch_count( end - begin, min_batch_size );
+      if( batches < 2 )
+      {
+         std::sort( begin, end, comp );
+         return;
+      }
+
+      std::vector<Iterator> bounds;
+      bounds.reserve( batches + 1 );
+      for( size_t b = 0; b <= batches; b++ )
+         bounds.push_back( detail::batch_begin( begin, end, batches, b ) );
+
+      auto sort_fn = [&bounds,&comp] ( size_t b ) { std::sort( bounds[b], bounds[b+1], comp ); };
+      detail::run_batches( batches, sort_fn, desc );
+
+      while( bounds.size() > 2 )
+      {
+         const size_t runs = bounds.size() - 1;
+         auto merge_fn = [&bounds,&comp] ( size_t pair ) {
+            std::inplace_merge( bounds[2*pair], bounds[2*pair+1], bounds[2*pair+2], comp );
+         };
+         detail::run_batches( runs / 2, merge_fn, desc );
+
+         std::vector<Iterator> merged;
+         merged.reserve( runs / 2 + 2 );
+         for( size_t i = 0; i < bounds.size(); i += 2 )
+            merged.push_back( bounds[i] );
+         if( runs % 2 == 1 )
+            merged.push_back( bounds.back() );
+         bounds.swap( merged );
+      }
+   }
 }
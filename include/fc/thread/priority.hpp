@@ -1,22 +1,34 @@
 #ifndef _FC_PRIORITY_HPP_
 #define  _FC_PRIORITY_HPP_
 
+#include <fc/time.hpp>
+
 namespace fc {
   /**
    *  An integer value used to sort asynchronous tasks.  The higher the
    *  prioirty the sooner it will be run.
+   *
+   *  Tasks of equal value can carry a deadline. They are run earliest deadline
+   *  first, before tasks without a deadline. Tasks that compare equal are run in
+   *  the order they were posted.
    */
   class priority {
     public:
-    explicit priority( int v = 0):value(v){}
-    priority( const priority& p ):value(p.value){}
+    explicit priority( int v = 0):value(v),deadline(time_point::maximum()){}
+    priority( int v, const time_point& d ):value(v),deadline(d){}
+    priority( const priority& p ):value(p.value),deadline(p.deadline){}
+    priority& operator = ( const priority& p ) { value = p.value; deadline = p.deadline; return *this; }
     bool operator < ( const priority& p )const {
-       return value < p.value;
+       return value < p.value || ( value == p.value && p.deadline < deadline );
     }
+    bool has_deadline()const { return deadline != time_point::maximum(); }
     static priority max() { return priority(10000); }
     static priority min() { return priority(-10000); }
     static priority _internal__priority_for_short_sleeps() { return priority(-100000); }
+    /** @return the default priority, with the given deadline */
+    static priority with_deadline( const time_point& d ) { return priority( 0, d ); }
     int value;
+    time_point deadline; ///< time_point::maximum() if there is none
   };
 }
 #endif //  _FC_PRIORITY_HPP_
@@ -0,0 +1,52 @@
+#pragma once
+#include <fc/thread/spin_yield_lock.hpp>
+
+#include <atomic>
+#include <deque>
+
+namespace fc {
+  struct context;
+
+  /**
+   *  @brief a counting semaphore for fibers
+   *
+   *  Useful for limiting the number of fibers that perform an expensive
+   *  operation at the same time. Like fc::mutex, waiting fibers are queued
+   *  and the waiting thread keeps running its other tasks. Permits are
+   *  handed to waiting fibers in the order they started to wait. A waiting fiber
+   *  that is canceled only notices once it has got a permit, which it then
+   *  returns before throwing.
+   */
+  class semaphore {
+    public:
+      explicit semaphore( unsigned initial_count );
+      ~semaphore();
+
+      /** Takes a permit, waiting until one is available */
+      void acquire();
+      /** @return true if a permit was available and has been taken */
+      bool try_acquire();
+      /** Adds count permits, waking up as many waiting fibers */
+      void release( unsigned count = 1 );
+
+      /** @return the number of available permits, which may be outdated already */
+      unsigned available()const { return m_count.load(); }
+
+    private:
+      fc::spin_yield_lock       m_lock;
+      std::atomic<unsigned>     m_count;
+      std::deque<fc::context*>  m_waiting;
+  };
+
+  /** Holds a permit of a semaphore for the duration of a scope */
+  class semaphore_guard {
+    public:
+      explicit semaphore_guard( semaphore& s ):_sem(s) { _sem.acquire(); }
+      ~semaphore_guard()                               { _sem.release(); }
+    private:
+      semaphore_guard( const semaphore_guard& );
+      semaphore_guard& operator=( const semaphore_guard& );
+      semaphore& _sem;
+  };
+
+} // namespace fc
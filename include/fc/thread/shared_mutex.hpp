@@ -0,0 +1,58 @@
+#pragma once
+#include <fc/thread/spin_yield_lock.hpp>
+
+#include <deque>
+
+namespace fc {
+  struct context;
+
+  /**
+   *  @brief a reader/writer lock for fibers
+   *
+   *  Any number of fibers may hold the lock in shared mode at the same time, or
+   *  a single fiber may hold it exclusively. Like fc::mutex, waiting fibers are
+   *  queued and the waiting thread keeps running its other tasks.
+   *
+   *  Writers are preferred: as soon as a writer is waiting, new readers queue up
+   *  behind it, so that a steady stream of readers cannot starve writers. When a
+   *  writer releases the lock, the next waiting writer gets it; only if there is
+   *  none, all waiting readers get it together.
+   *
+   *  The lock is not recursive, and cannot be upgraded from shared to exclusive.
+   *  As with fc::mutex, a waiting fiber that is canceled only notices once it has
+   *  got the lock, which it then releases again before throwing.
+   */
+  class shared_mutex {
+    public:
+      shared_mutex();
+      ~shared_mutex();
+
+      bool try_lock();
+      void lock();
+      void unlock();
+
+      bool try_lock_shared();
+      void lock_shared();
+      void unlock_shared();
+
+    private:
+      fc::spin_yield_lock       m_lock;
+      unsigned                  m_readers;        // number of fibers holding the lock in shared mode
+      bool                      m_writer;         // true while a fiber holds the lock exclusively
+      std::deque<fc::context*>  m_waiting_writers;
+      std::deque<fc::context*>  m_waiting_readers;
+  };
+
+  /** Holds a shared lock on T for the duration of a scope */
+  template<typename T>
+  class shared_lock {
+    public:
+      explicit shared_lock( T& l ):_lock(l) { _lock.lock_shared(); }
+      ~shared_lock()                        { _lock.unlock_shared(); }
+    private:
+      shared_lock( const shared_lock& );
+      shared_lock& operator=( const shared_lock& );
+      T& _lock;
+  };
+
+} // namespace fc
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace fc {
+
+   /** Counters of the pool that tasks and promises are allocated from */
+   struct small_object_pool_stats {
+      uint64_t allocations;        ///< blocks handed out by the pool
+      uint64_t deallocations;      ///< blocks given back to the pool
+      uint64_t system_allocations; ///< blocks the pool had to obtain from operator new
+      uint64_t oversized;          ///< requests too large for the pool, passed on to operator new
+   };
+
+   /** @return the counters of all threads, summed up */
+   small_object_pool_stats get_small_object_pool_stats();
+
+   namespace detail {
+      /**
+       *  Allocates from a set of size classes in steps of 64 bytes. Each thread
+       *  caches freed blocks per size class, and exchanges them with a shared
+       *  free list in batches, so that blocks freed by another thread than the one
+       *  that allocated them (as is common for tasks) find their way back.
+       *  Memory obtained by the pool is never returned to the system.
+       */
+      void* small_object_allocate( size_t size );
+      /** @param size must be the size that was passed to small_object_allocate() */
+      void  small_object_deallocate( void* p, size_t size );
+
+      /**
+       *  Allocator for use with std::allocate_shared, so that an object and its
+       *  shared_ptr control block live in one pooled block. Classes with
+       *  non-public constructors can befriend it.
+       */
+      template<typename T>
+      class pool_allocator {
+      public:
+         typedef T value_type;
+
+         pool_allocator() {}
+         template<typename U>
+         pool_allocator( const pool_allocator<U>& ) {}
+
+         T* allocate( size_t n )
+         {
+            return static_cast<T*>( small_object_allocate( n * sizeof(T) ) );
+         }
+         void deallocate( T* p, size_t n )
+         {
+            small_object_deallocate( p, n * sizeof(T) );
+         }
+
+         template<typename U, typename... Args>
+         void construct( U* p, Args&&... args )
+         {
+            ::new( (void*)p ) U( std::forward<Args>(args)... );
+         }
+         template<typename U>
+         void destroy( U* p )
+         {
+            p->~U();
+         }
+
+         template<typename U>
+         bool operator==( const pool_allocator<U>& )const { return true; }
+         template<typename U>
+         bool operator!=( const pool_allocator<U>& )const { return false; }
+      };
+   }
+
+} // fc
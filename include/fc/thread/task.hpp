@@ -2,13 +2,16 @@
 #include <fc/thread/future.hpp>
 #include <fc/thread/priority.hpp>
 #include <fc/fwd.hpp>
+#include <iterator>
 #include <type_traits>
+#include <vector>
 
 #include <boost/atomic.hpp>
 
 namespace fc {
   struct context;
   class spin_lock;
+  class thread;
 
    namespace detail
    {
@@ -27,7 +30,38 @@ namespace fc {
       };
       void* get_task_specific_data(unsigned slot);
       void set_task_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
+
+#ifndef FC_FAST_TASK_SLOTS
+#define FC_FAST_TASK_SLOTS 8
+#endif
+      /** Values of the fast task-specific slots of a task, see fast_task_specific_ptr */
+      struct fast_task_slots
+      {
+         fast_task_slots() : values(), cleanups() {}
+         void* values[FC_FAST_TASK_SLOTS];
+         void (*cleanups[FC_FAST_TASK_SLOTS])(void*);
+      };
+      fast_task_slots** init_fast_task_slots();
       class idle_guard;
+
+      /** Links an object (a scheduled task or a sleeping context) into the timer queue
+       *  of a thread. The fields are managed by the timer queue.
+       */
+      struct timer_link
+      {
+         timer_link() :
+            next(nullptr),
+            pprev(nullptr),
+            owner(nullptr),
+            expires(0),
+            heap_index(0)
+         {}
+         timer_link*  next;       // next link in the same timing wheel slot
+         timer_link** pprev;      // points to the pointer to this link while in a timing wheel
+         void*        owner;      // the object containing this link
+         uint64_t     expires;    // expiration time in microseconds since epoch
+         size_t       heap_index; // 1-based position while in a binary heap, 0 otherwise
+      };
    }
 
   class task_base : virtual public promise_base {
@@ -56,16 +90,23 @@ namespace fc {
       void release();
 
     protected:
-      /// Task priority looks like unsupported feature.
       uint64_t    _posted_num;
       priority    _prio;
       time_point  _when;
+      size_t      _stack_size; // requested stack size, normalized to a size class when queued
+      uint64_t    _enqueue_time; // when the task was posted or became due, for measuring queue latency, see thread::get_stats()
+      uint64_t    _trace_id;     // identifies the task in fiber traces, see fc::get_fiber_trace()
+      detail::timer_link _timer_link;
       void        _set_active_context(context*);
       context*    _active_context;
       task_base*  _next;
+      thread*     _posted_to;      // the thread that runs this task, see thread::notify_task_has_been_canceled
+      task_base*  _next_canceled;  // link in the list of canceled tasks of that thread
+      boost::atomic<bool> _cancel_notified;
 
       // support for task-specific data
       std::vector<detail::specific_data_info> *_task_specific_data;
+      detail::fast_task_slots*                 _fast_task_slots; // allocated on first use
 
       friend void* detail::get_task_specific_data(unsigned slot);
       friend void detail::set_task_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
@@ -122,10 +163,12 @@ namespace fc {
       template<typename Functor>
       static ptr create( Functor&& f, const char* desc )
       {
-         return ptr( new task<R,FunctorSize>( std::move(f), desc ) );
+         return std::allocate_shared< task<R,FunctorSize> >( detail::pool_allocator< task<R,FunctorSize> >(),
+                                                              std::move(f), desc );
       }
       virtual void cancel(const char* reason FC_CANCELATION_REASON_DEFAULT_ARG) override { task_base::cancel(reason); }
     private:
+      template<typename> friend class detail::pool_allocator;
       template<typename Functor>
       task( Functor&& f, const char* desc ):promise_base(desc), task_base(&_functor), promise<R>(desc) {
         typedef typename std::remove_const_t< std::remove_reference_t<Functor> > FunctorType;
@@ -150,10 +193,12 @@ namespace fc {
       template<typename Functor>
       static ptr create( Functor&& f, const char* desc )
       {
-         return ptr( new task<void,FunctorSize>( std::move(f), desc ) );
+         return std::allocate_shared< task<void,FunctorSize> >( detail::pool_allocator< task<void,FunctorSize> >(),
+                                                              std::move(f), desc );
       }
       virtual void cancel(const char* reason FC_CANCELATION_REASON_DEFAULT_ARG) override { task_base::cancel(reason); }
     private:
+      template<typename> friend class detail::pool_allocator;
       template<typename Functor>
       task( Functor&& f, const char* desc ):promise_base(desc), task_base(&_functor), promise<void>(desc) {
         typedef typename std::remove_const_t< std::remove_reference_t<Functor> > FunctorType;
@@ -168,4 +213,42 @@ namespace fc {
       alignas(double) char _functor[FunctorSize];
   };
 
+  namespace detail {
+    /**
+     *  Creates a retained task for each functor in [begin,end), for handing them to
+     *  a thread or the worker pool at once.
+     *  @param tasks receives the tasks, in the order of the functors
+     *  @return the futures of the tasks, in the same order
+     */
+    template<typename Iterator>
+    auto create_task_batch( Iterator begin, Iterator end, const char* desc, std::vector<task_base*>& tasks )
+       -> std::vector<fc::future<decltype((*begin)())>>
+    {
+       typedef decltype((*begin)()) Result;
+       typedef typename std::iterator_traits<Iterator>::value_type FunctorType;
+       std::vector<fc::future<Result>> results;
+       results.reserve( std::distance( begin, end ) );
+       const size_t first = tasks.size();
+       tasks.reserve( first + results.capacity() );
+       try
+       {
+          for( ; begin != end; ++begin )
+          {
+             typename task<Result,sizeof(FunctorType)>::ptr tsk =
+                task<Result,sizeof(FunctorType)>::create( FunctorType( *begin ), desc );
+             tsk->retain(); // HERE BE DRAGONS
+             results.emplace_back( std::dynamic_pointer_cast< promise<Result> >(tsk) );
+             tasks.push_back( tsk.get() );
+          }
+       }
+       catch( ... )
+       {
+          for( size_t i = first; i < tasks.size(); ++i )
+             tasks[i]->release();
+          throw;
+       }
+       return results;
+    }
+  }
+
 }
@@ -0,0 +1,104 @@
+#pragma once
+#include <fc/thread/parallel.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <memory>
+
+namespace fc {
+
+   namespace detail {
+      class task_group_state;
+   }
+
+   /**
+    *  @brief owns a set of tasks and cancels them together
+    *
+    *  Tasks started through a group, or added to it, are its children. Cancelling
+    *  the group cancels all children that have not completed yet, including those
+    *  of nested groups. The same happens when the deadline of the group passes, or
+    *  when one of the children fails: the first failure is what wait_all() reports.
+    *
+    *  Cancellation is cooperative. A child that has not started yet does not run
+    *  at all, a running child is interrupted when it waits, yields or sleeps. Long
+    *  computations should call check_canceled() now and then.
+    *
+    *  The destructor cancels the remaining children and waits for them.
+    */
+   class task_group {
+   public:
+      explicit task_group( const char* desc FC_TASK_NAME_DEFAULT_ARG );
+      /** @param deadline the group is canceled when this time has passed */
+      task_group( const time_point& deadline, const char* desc FC_TASK_NAME_DEFAULT_ARG );
+      /** Creates a group that is canceled together with its parent, and never
+       *  has a later deadline than the parent. */
+      task_group( task_group& parent, const time_point& deadline = time_point::maximum(),
+                  const char* desc FC_TASK_NAME_DEFAULT_ARG );
+      ~task_group();
+
+      task_group( const task_group& ) = delete;
+      task_group& operator=( const task_group& ) = delete;
+
+      /** Calls f in thread t as a child of this group, see thread::async() */
+      template<typename Functor>
+      auto async( thread& t, Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG,
+                  priority prio = priority() ) -> fc::future<decltype(f())> {
+         fc::future<decltype(f())> result = t.async( std::forward<Functor>(f), desc, prio );
+         add( result );
+         return result;
+      }
+
+      /** Calls f in the current thread as a child of this group */
+      template<typename Functor>
+      auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG,
+                  priority prio = priority() ) -> fc::future<decltype(f())> {
+         return async( thread::current(), std::forward<Functor>(f), desc, prio );
+      }
+
+      /** Calls f in the worker pool as a child of this group, see fc::do_parallel() */
+      template<typename Functor>
+      auto do_parallel( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG ) -> fc::future<decltype(f())> {
+         fc::future<decltype(f())> result = fc::do_parallel( std::forward<Functor>(f), desc );
+         add( result );
+         return result;
+      }
+
+      /** Makes an operation that has been started otherwise a child of this group */
+      template<typename T>
+      void add( const future<T>& f ) {
+         const uint64_t id = add_child( [f]( const char* reason ) { f.cancel( reason ); } );
+         detail::on_complete_without_value( f, [state=std::weak_ptr<detail::task_group_state>( my ),id]
+                                               ( const exception_ptr& e ) {
+            child_completed( state, id, e );
+         } );
+      }
+
+      /** Cancels all children, and any that are added later */
+      void cancel( const char* reason FC_CANCELATION_REASON_DEFAULT_ARG );
+      /** @return true if the group has been canceled, failed, or its deadline has passed */
+      bool canceled()const;
+      /** @throw canceled_exception if canceled() */
+      void check_canceled()const;
+
+      /** @return the deadline of the group, time_point::maximum() if it has none */
+      time_point deadline()const;
+
+      /** @return the number of children that have not completed yet */
+      size_t size()const;
+
+      /**
+       *  Waits until all children have completed.
+       *  @return the first failure of a child, a canceled_exception if the group has
+       *          been canceled, a timeout_exception if its deadline has passed first,
+       *          or nullptr if all children have succeeded
+       */
+      exception_ptr wait_all();
+
+   private:
+      uint64_t add_child( std::function<void(const char*)>&& cancel );
+      static void child_completed( const std::weak_ptr<detail::task_group_state>& state, uint64_t id,
+                                   const exception_ptr& e );
+
+      std::shared_ptr<detail::task_group_state> my;
+   };
+
+} // fc
@@ -7,6 +7,7 @@
 namespace fc {
   class time_point;
   class microseconds;
+  class variant;
 
    namespace detail
    {
@@ -36,9 +37,42 @@ namespace fc {
       virtual void busy() = 0;
    };
 
+   /** Selects the data structure a thread uses for keeping track of scheduled
+    *  tasks and of fibers that sleep or wait with a timeout.
+    */
+   enum class timer_backend {
+      /** A binary heap. Inserting, firing and cancelling a timer take O(log n). */
+      binary_heap,
+      /** A hierarchical timing wheel with a resolution of 1us. Inserting, firing
+       *  and cancelling a timer take (amortized) O(1), at the cost of a few
+       *  dozen kilobytes of memory per thread.
+       */
+      timing_wheel
+   };
+
+   /** Tells a thread what to do when it has run out of work. The thread first
+    *  checks for new tasks in a busy loop, then yields its CPU to other threads a
+    *  number of times, and finally sleeps until it is notified. Posting a task to a
+    *  thread that has not gone to sleep yet does not need a system call.
+    */
+   struct idle_policy {
+      idle_policy( uint32_t spins = 0, uint32_t yields = 0 ) : spin_iterations(spins), yield_iterations(yields) {}
+
+      /** Go to sleep right away. This is the default. */
+      static idle_policy park() { return idle_policy(); }
+      /** Spin and yield for a few microseconds before going to sleep */
+      static idle_policy spin_then_park( uint32_t spins = 4000, uint32_t yields = 20 ) { return idle_policy( spins, yields ); }
+
+      /** The maximum number of busy checks. The thread spins shorter after
+       *  spinning has not paid off, and returns to the maximum when it has. */
+      uint32_t spin_iterations;
+      uint32_t yield_iterations; ///< the number of yields after spinning
+   };
+
   class thread {
     public:
-      thread( const std::string& name = "", thread_idle_notifier* notifier = 0 );
+      thread( const std::string& name = "", thread_idle_notifier* notifier = 0,
+              timer_backend timers = timer_backend::binary_heap );
       thread( thread&& m ) = delete;
       thread& operator=(thread&& t ) = delete;
 
@@ -74,6 +108,35 @@ namespace fc {
        *  async tasks and promises.
        */
       void    debug( const std::string& d );
+
+      /**
+       *  @brief returns a snapshot of the scheduler statistics of this thread.
+       *
+       *  The statistics are always collected. The result contains the counters
+       *  <code>tasks_posted</code>, <code>tasks_run</code>, <code>context_switches</code>,
+       *  <code>idle_waits</code> (times the thread went to sleep) and <code>spin_wakeups</code>
+       *  (times new work arrived while spinning, see idle_policy), <code>deadline_tasks_run</code>
+       *  and <code>deadlines_missed</code> (tasks with a deadline, see priority, that completed
+       *  and those that completed late), histograms of the task queue and ready queue
+       *  depths, and for each task description a histogram of the time tasks
+       *  waited in the queue before they started (<code>queue_latency_ns</code>),
+       *  of the time they ran before they completed or yielded
+       *  (<code>run_slice_ns</code>) and of how late they completed (<code>deadline_lateness_us</code>).
+       *
+       *  Histograms contain <code>count</code>, <code>mean</code>, <code>max</code>
+       *  and a list of power-of-two <code>buckets</code> as [upper bound, count] pairs.
+       *
+       *  If called from a different thread, this blocks until this thread gets
+       *  around to taking the snapshot.
+       */
+      variant get_stats();
+
+      /** @brief resets the scheduler statistics of this thread */
+      void    reset_stats();
+
+      /** @brief sets what this thread does when it runs out of work, may be called from any thread */
+      void        set_idle_policy( const idle_policy& policy );
+      idle_policy get_idle_policy()const;
      
      
       /**
@@ -81,20 +144,40 @@ namespace fc {
        *  be used to wait on the result.  
        *
        *  @param f the operation to perform
-       *  @param prio the priority relative to other tasks
+       *  @param prio the priority relative to other tasks, may carry a deadline
+       *  @param stack_size the minimum stack size the task needs, or 0 for
+       *        FC_CONTEXT_STACK_SIZE. It is rounded up to a power of two.
        */
       template<typename Functor>
-      auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
+      auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority(),
+                  size_t stack_size = 0 ) -> fc::future<decltype(f())> {
          typedef decltype(f()) Result;
          typedef typename std::remove_const_t< std::remove_reference_t<Functor> > FunctorType;
          typename task<Result,sizeof(FunctorType)>::ptr tsk = 
               task<Result,sizeof(FunctorType)>::create( std::forward<Functor>(f), desc );
+         tsk->_stack_size = stack_size;
          tsk->retain(); // HERE BE DRAGONS
          fc::future<Result> r( std::dynamic_pointer_cast< promise<Result> >(tsk) );
          async_task(tsk.get(),prio);
          return r;
       }
       void poke();
+
+      /**
+       *  Calls each functor of the range [begin,end) in this thread, as separate tasks.
+       *  The tasks are published together with a single atomic operation, and this
+       *  thread is woken up at most once.
+       *
+       *  @return the futures of the tasks, in the order of the functors
+       */
+      template<typename Iterator>
+      auto async_batch( Iterator begin, Iterator end, const char* desc FC_TASK_NAME_DEFAULT_ARG,
+                        priority prio = priority() ) -> std::vector<fc::future<decltype((*begin)())>> {
+         std::vector<task_base*> tasks;
+         auto results = detail::create_task_batch( begin, end, desc, tasks );
+         async_task_batch( tasks, prio );
+         return results;
+      }
      
      
       /**
@@ -105,13 +188,16 @@ namespace fc {
        *  @param prio the priority of this method relative to others
        *  @param when determines when this call will happen, as soon as 
        *        possible after <code>when</code>
+       *  @param stack_size the minimum stack size the task needs, see async()
        */
       template<typename Functor>
       auto schedule( Functor&& f, const fc::time_point& when, 
-                     const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
+                     const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority(),
+                     size_t stack_size = 0 ) -> fc::future<decltype(f())> {
          typedef decltype(f()) Result;
          typename task<Result,sizeof(Functor)>::ptr tsk = 
               task<Result,sizeof(Functor)>::create( std::forward<Functor>(f), desc );
+         tsk->_stack_size = stack_size;
          tsk->retain(); // HERE BE DRAGONS
          fc::future<Result> r( std::dynamic_pointer_cast< promise<Result> >(tsk) );
          async_task(tsk.get(),prio,when);
@@ -159,12 +245,15 @@ namespace fc {
       friend class task_base;
       friend class thread_d;
       friend class mutex;
+      friend class shared_mutex;
+      friend class semaphore;
       friend class detail::worker_pool;
       friend void* detail::get_thread_specific_data(unsigned slot);
       friend void detail::set_thread_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
       friend unsigned detail::get_next_unused_task_storage_slot();
       friend void* detail::get_task_specific_data(unsigned slot);
       friend void detail::set_task_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
+      friend detail::fast_task_slots** detail::init_fast_task_slots();
 #ifndef NDEBUG
       friend class non_preemptable_scope_check;
 #endif
@@ -184,8 +273,13 @@ namespace fc {
 
       void async_task( task_base* t, const priority& p );
       void async_task( task_base* t, const priority& p, const time_point& tp );
+      void async_task_batch( const std::vector<task_base*>& tasks, const priority& p );
+      /** Prepends the list head...tail to task_in_queue and wakes up this thread if necessary */
+      void publish_tasks( task_base* head, task_base* tail );
 
-      void notify_task_has_been_canceled();
+      /** Queues the canceled task t for this thread, which removes it from its timer queue
+       *  or wakes up the fiber running it */
+      void notify_task_has_been_canceled( task_base* t );
       void unblock(fc::context* c);
 
       class thread_d* my;
@@ -224,14 +318,39 @@ namespace fc {
    int wait_any_until( std::vector<promise_base::ptr>&& v, const time_point& tp );
 
    template<typename Functor>
-   auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
-      return fc::thread::current().async( std::forward<Functor>(f), desc, prio );
+   auto async( Functor&& f, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority(),
+               size_t stack_size = 0 ) -> fc::future<decltype(f())> {
+      return fc::thread::current().async( std::forward<Functor>(f), desc, prio, stack_size );
    }
    template<typename Functor>
-   auto schedule( Functor&& f, const fc::time_point& t, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority()) -> fc::future<decltype(f())> {
-      return fc::thread::current().schedule( std::forward<Functor>(f), t, desc, prio );
+   auto schedule( Functor&& f, const fc::time_point& t, const char* desc FC_TASK_NAME_DEFAULT_ARG, priority prio = priority(),
+                  size_t stack_size = 0 ) -> fc::future<decltype(f())> {
+      return fc::thread::current().schedule( std::forward<Functor>(f), t, desc, prio, stack_size );
    }
 
+   /** Stack usage of all tasks with the same description, see enable_stack_usage_tracking() */
+   struct stack_usage {
+      stack_usage() : stack_size(0), max_used(0), samples(0) {}
+
+      std::string task_desc;
+      size_t      stack_size; ///< size of the largest stack the tasks have run on
+      size_t      max_used;   ///< highest number of stack bytes used by any of the tasks
+      uint64_t    samples;    ///< number of task executions that have been measured
+   };
+
+   /**
+    *  Enables or disables measuring the stack space used by tasks. While enabled,
+    *  the unused part of a fiber's stack is filled with a pattern before each task
+    *  runs, and checked for overwritten memory afterwards.
+    *
+    *  This is slow and commits the full stack of every fiber, so it is meant for
+    *  finding suitable stack sizes for async(), not for production use.
+    */
+   void enable_stack_usage_tracking( bool enable );
+
+   /** @return the stack usage measured so far, per task description */
+   std::vector<stack_usage> get_stack_usage();
+
   /**
    * Call f() in thread t and block the current thread until it returns.
    * 
@@ -248,6 +367,56 @@ namespace fc {
      return r.wait();
   }
 
+  template<typename T>
+  template<typename Functor>
+  auto future<T>::then( thread& t, Functor&& f, const char* desc )const
+     -> future<decltype(f(std::declval<const T&>()))> {
+    typedef decltype(f(std::declval<const T&>())) Result;
+    typename promise<Result>::ptr result = promise<Result>::create( desc );
+    // a weak reference, because the handler is owned by the promise
+    std::weak_ptr<promise<T>> source = m_prom;
+    on_complete( [result,source,&t,f=std::forward<Functor>(f),desc]( const T&, const exception_ptr& e ) mutable {
+       if( e )
+       {
+          result->set_exception( e );
+          return;
+       }
+       try
+       {
+          t.async( [result,value=source.lock(),f=std::move(f)]() mutable {
+             detail::fulfill_promise( *result, f, value->wait() );
+          }, desc );
+       }
+       catch( const exception& ex )
+       {
+          result->set_exception( ex.dynamic_copy_exception() );
+       }
+    } );
+    return future<Result>( result );
+  }
+
+  template<typename Functor>
+  auto future<void>::then( thread& t, Functor&& f, const char* desc )const -> future<decltype(f())> {
+    typedef decltype(f()) Result;
+    typename promise<Result>::ptr result = promise<Result>::create( desc );
+    on_complete( [result,&t,f=std::forward<Functor>(f),desc]( const exception_ptr& e ) mutable {
+       if( e )
+       {
+          result->set_exception( e );
+          return;
+       }
+       try
+       {
+          t.async( [result,f=std::move(f)]() mutable { detail::fulfill_promise( *result, f ); }, desc );
+       }
+       catch( const exception& ex )
+       {
+          result->set_exception( ex.dynamic_copy_exception() );
+       }
+    } );
+    return future<Result>( result );
+  }
+
 } // end namespace fc
 
 #ifdef _MSC_VER
@@ -7,6 +7,33 @@ namespace fc
   {
     unsigned get_next_unused_thread_storage_slot();
     unsigned get_next_unused_task_storage_slot();
+
+    /** Caches the thread specific data of the calling thread, nullptr until first used */
+    inline std::vector<specific_data_info>*& current_thread_specific_data()
+    {
+#ifdef _MSC_VER
+      static __declspec(thread) std::vector<specific_data_info>* data = nullptr;
+#else
+      static __thread std::vector<specific_data_info>* data = nullptr;
+#endif
+      return data;
+    }
+
+    /** Points to the fast slots of the task running on the calling thread, or to those
+     *  of the thread itself outside of tasks. It is updated by the scheduler on every
+     *  switch, and is nullptr until the thread first uses fast slots.
+     */
+    inline fast_task_slots**& current_fast_task_slots()
+    {
+#ifdef _MSC_VER
+      static __declspec(thread) fast_task_slots** slots = nullptr;
+#else
+      static __thread fast_task_slots** slots = nullptr;
+#endif
+      return slots;
+    }
+
+    void set_fast_task_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*));
   }
 
   template <typename T>
@@ -21,7 +48,10 @@ namespace fc
 
     T* get() const
     {
-      return static_cast<T*>(detail::get_thread_specific_data(slot));
+      const std::vector<detail::specific_data_info>* data = detail::current_thread_specific_data();
+      if (!data)
+        return static_cast<T*>(detail::get_thread_specific_data(slot));
+      return slot < data->size() ? static_cast<T*>((*data)[slot].value) : nullptr;
     }
     T* operator->() const
     {
@@ -81,4 +111,47 @@ namespace fc
     }
   };
 
+  /**
+   *  Like task_specific_ptr, but the slot is chosen at compile time from a small
+   *  fixed set (FC_FAST_TASK_SLOTS), so get() does not need to look up the
+   *  current thread and task: the scheduler keeps a pointer to the slots of the
+   *  running task in native thread-local storage.
+   *
+   *  All instances with the same Slot share the value. Unlike task_specific_ptr,
+   *  reset() cleans up the previous value.
+   */
+  template <typename T, unsigned Slot>
+  class fast_task_specific_ptr
+  {
+    static_assert(Slot < FC_FAST_TASK_SLOTS, "Slot must be less than FC_FAST_TASK_SLOTS");
+  public:
+    T* get() const
+    {
+      detail::fast_task_slots** slots = detail::current_fast_task_slots();
+      if (!slots)
+        slots = detail::init_fast_task_slots();
+      return *slots ? static_cast<T*>((*slots)->values[Slot]) : nullptr;
+    }
+    T* operator->() const
+    {
+      return get();
+    }
+    T& operator*() const
+    {
+      return *get();
+    }
+    operator bool() const
+    {
+      return get() != static_cast<T*>(0);
+    }
+    static void cleanup_function(void* obj)
+    {
+      delete static_cast<T*>(obj);
+    }
+    void reset(T* new_value = 0)
+    {
+      detail::set_fast_task_specific_data(Slot, new_value, cleanup_function);
+    }
+  };
+
 }
@@ -1,5 +1,6 @@
 #include <fc/asio.hpp>
 #include <fc/thread/thread.hpp>
+#include <fc/thread/affinity.hpp>
 #include <boost/thread.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/exception/exception.hpp>
@@ -91,6 +92,40 @@ namespace fc {
     }
 
     uint16_t fc::asio::default_io_service_scope::num_io_threads = 0;
+    bool     fc::asio::default_io_service_scope::sharded_mode = false;
+
+    namespace {
+       void run_io_service( boost::asio::io_service& io, uint16_t i )
+       {
+          fc::thread::current().set_name( "fc::asio worker #" + fc::to_string(i) );
+
+          BOOST_SCOPE_EXIT(void)
+          {
+             fc::thread::cleanup();
+          }
+          BOOST_SCOPE_EXIT_END
+
+          while (!io.stopped())
+          {
+             try
+             {
+                io.run();
+             }
+             catch (const fc::exception& e)
+             {
+                elog("Caught unhandled exception in asio service loop: ${e}", ("e", e));
+             }
+             catch (const std::exception& e)
+             {
+                elog("Caught unhandled exception in asio service loop: ${e}", ("e", e.what()));
+             }
+             catch (...)
+             {
+                elog("Caught unhandled exception in asio service loop");
+             }
+          }
+       }
+    }
 
     /***
      * @brief set the default number of threads for the io service
@@ -107,52 +142,57 @@ namespace fc {
 
     uint16_t default_io_service_scope::get_num_threads() { return num_io_threads; }
 
+    void default_io_service_scope::set_sharded(bool sharded) { sharded_mode = sharded; }
+
+    bool default_io_service_scope::get_sharded() { return sharded_mode; }
+
     /***
-     * Default constructor
+     * Default constructor, uses the configured number of threads and mode
      */
     default_io_service_scope::default_io_service_scope()
+       : default_io_service_scope( num_io_threads, sharded_mode )
     {
-       io           = new boost::asio::io_service();
-       the_work     = new boost::asio::io_service::work(*io);
-
+       // the number of threads may have been determined by the delegated constructor
        if( num_io_threads == 0 )
+          num_io_threads = asio_threads.size();
+    }
+
+    default_io_service_scope::default_io_service_scope( uint16_t num_threads, bool sharded )
+       : next(0)
+    {
+       if( num_threads == 0 )
        {
           // the default was not set by the configuration. Determine a good
           // number of threads. Minimum of 8, maximum of hardware_concurrency
-          num_io_threads = std::max( boost::thread::hardware_concurrency(), 8U );
+          num_threads = std::max( boost::thread::hardware_concurrency(), 8U );
        }
 
-       for( uint16_t i = 0; i < num_io_threads; ++i )
+       const size_t num_shards = sharded ? num_threads : 1;
+       for( size_t i = 0; i < num_shards; ++i )
        {
-          asio_threads.push_back( new boost::thread( [i,this]()
+          // a concurrency hint of 1 tells asio that a shard is run by a single thread
+          shards.push_back( sharded ? new boost::asio::io_service( 1 ) : new boost::asio::io_service() );
+          works.push_back( new boost::asio::io_service::work( *shards.back() ) );
+       }
+       io = shards.front();
+
+       thread_placement placement = get_thread_placement( thread_group::asio_workers );
+       if( sharded && placement.cpus.empty() && placement.numa_node < 0 )
+       {
+          // without a configuration, shards are spread over all cores
+          for( unsigned cpu = 0; cpu < std::max( boost::thread::hardware_concurrency(), 1U ); ++cpu )
+             placement.cpus.push_back( cpu );
+          placement.pin_each = true;
+       }
+       for( uint16_t i = 0; i < num_threads; ++i )
+       {
+          boost::asio::io_service* shard = shards[ sharded ? i : 0 ];
+          const thread_placement member_placement = placement.for_member( i );
+          asio_threads.push_back( new boost::thread( [i,shard,member_placement]()
                 {
-                 fc::thread::current().set_name( "fc::asio worker #" + fc::to_string(i) );
-                 
-                 BOOST_SCOPE_EXIT(void)
-                 {
-                    fc::thread::cleanup();
-                 } 
-                 BOOST_SCOPE_EXIT_END
-
-                 while (!io->stopped())
-                 {
-                    try
-                    {
-                       io->run();
-                    }
-                    catch (const fc::exception& e)
-                    {
-                       elog("Caught unhandled exception in asio service loop: ${e}", ("e", e));
-                    }
-                    catch (const std::exception& e)
-                    {
-                       elog("Caught unhandled exception in asio service loop: ${e}", ("e", e.what()));
-                    }
-                    catch (...)
-                    {
-                       elog("Caught unhandled exception in asio service loop");
-                    }
-                 }
+                   if( !member_placement.empty() && !apply_thread_placement( member_placement ) )
+                      wlog( "Failed to apply the placement of asio worker #${i}", ("i",i) );
+                   run_io_service( *shard, i );
                 }) );
        } // build thread loop
     } // end of constructor
@@ -162,26 +202,56 @@ namespace fc {
      */
     default_io_service_scope::~default_io_service_scope()
     {
-       delete the_work;
-       io->stop();
+       for( auto work : works )
+          delete work;
+       for( auto shard : shards )
+          shard->stop();
        for( auto asio_thread : asio_threads )
        {
           asio_thread->join();
        }
-       delete io;
+       for( auto shard : shards )
+          delete shard;
        for( auto asio_thread : asio_threads )
        {
           delete asio_thread;
        }
     } // end of destructor
 
+    boost::asio::io_service& default_io_service_scope::next_shard()
+    {
+       if( shards.size() == 1 )
+          return *io;
+       return *shards[ next.fetch_add( 1, std::memory_order_relaxed ) % shards.size() ];
+    }
+
+    boost::asio::io_service& default_io_service_scope::shard_for( uint64_t key )
+    {
+       return *shards[ key % shards.size() ];
+    }
+
+    namespace {
+       default_io_service_scope& default_scope()
+       {
+          static default_io_service_scope fc_asio_service[1];
+          return fc_asio_service[0];
+       }
+    }
+
     /***
      * @brief create an io_service
      * @returns the io_service
      */
     boost::asio::io_service& default_io_service() {
-        static default_io_service_scope fc_asio_service[1];
-        return *fc_asio_service[0].io;
+        return *default_scope().io;
+    }
+
+    boost::asio::io_service& next_default_io_service_shard() {
+        return default_scope().next_shard();
+    }
+
+    boost::asio::io_service& default_io_service( uint64_t key ) {
+        return default_scope().shard_for( key );
     }
 
     namespace tcp {
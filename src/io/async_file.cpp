@@ -0,0 +1,573 @@
+#include <fc/io/async_file.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/thread/parallel.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+# include <io.h>
+# include <windows.h>
+#else
+# include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  define FC_HAS_IO_URING
+# endif
+#endif
+
+#ifdef FC_HAS_IO_URING
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <sys/uio.h>
+#endif
+
+namespace fc {
+
+   class async_file::impl {
+      public:
+         explicit impl( int f ) : fd(f) {}
+         ~impl() { ::close( fd ); }
+         const int fd;
+   };
+
+   namespace detail {
+
+      namespace {
+         uint16_t            num_file_io_threads = 4;
+         boost::atomic<bool> io_uring_enabled( true );
+
+         worker_pool& get_file_io_pool()
+         {
+            static worker_pool the_pool( num_file_io_threads, "file io worker" );
+            return the_pool;
+         }
+
+         /** Like do_parallel(), but runs f in the file I/O pool */
+         template<typename Functor>
+         auto run_blocking( Functor&& f, const char* desc ) -> fc::future<decltype(f())>
+         {
+            typedef decltype(f()) Result;
+            typedef typename std::remove_const_t< std::remove_reference_t<Functor> > FunctorType;
+            typename task<Result,sizeof(FunctorType)>::ptr tsk =
+               task<Result,sizeof(FunctorType)>::create( std::forward<Functor>(f), desc );
+            tsk->retain(); // HERE BE DRAGONS
+            fc::future<Result> r( std::dynamic_pointer_cast< promise<Result> >(tsk) );
+            get_file_io_pool().post( tsk.get() );
+            return r;
+         }
+
+         fc::exception io_error( const char* operation, int err )
+         {
+            return fc::exception( FC_LOG_MESSAGE( error, "${op} failed: ${e}",
+                                                  ("op",operation)("e",std::strerror( err )) ) );
+         }
+
+#ifdef _WIN32
+         /** Positional I/O on the handle behind fd, does not touch the file pointer of fd */
+         int64_t sys_pread( int fd, char* buf, size_t len, uint64_t offset )
+         {
+            OVERLAPPED ov = {};
+            ov.Offset = DWORD( offset );
+            ov.OffsetHigh = DWORD( offset >> 32 );
+            DWORD done = 0;
+            if( !ReadFile( HANDLE( _get_osfhandle( fd ) ), buf, DWORD( std::min<size_t>( len, 1 << 30 ) ), &done, &ov ) )
+               return GetLastError() == ERROR_HANDLE_EOF ? 0 : ( errno = EIO, -1 );
+            return done;
+         }
+         int64_t sys_pwrite( int fd, const char* buf, size_t len, uint64_t offset )
+         {
+            OVERLAPPED ov = {};
+            ov.Offset = DWORD( offset );
+            ov.OffsetHigh = DWORD( offset >> 32 );
+            DWORD done = 0;
+            if( !WriteFile( HANDLE( _get_osfhandle( fd ) ), buf, DWORD( std::min<size_t>( len, 1 << 30 ) ), &done, &ov ) )
+               return errno = EIO, -1;
+            return done;
+         }
+         int sys_fsync( int fd ) { return _commit( fd ); }
+#else
+         int64_t sys_pread( int fd, char* buf, size_t len, uint64_t offset ) { return ::pread( fd, buf, len, offset ); }
+         int64_t sys_pwrite( int fd, const char* buf, size_t len, uint64_t offset ) { return ::pwrite( fd, buf, len, offset ); }
+         int sys_fsync( int fd ) { return ::fsync( fd ); }
+#endif
+
+         size_t blocking_pread( int fd, char* buf, size_t len, uint64_t offset )
+         {
+            size_t done = 0;
+            while( done < len )
+            {
+               const int64_t r = sys_pread( fd, buf + done, len - done, offset + done );
+               if( r < 0 && errno == EINTR )
+                  continue;
+               if( r < 0 )
+                  throw io_error( "pread", errno );
+               if( r == 0 )
+                  break;
+               done += r;
+            }
+            return done;
+         }
+
+         size_t blocking_pwrite( int fd, const char* buf, size_t len, uint64_t offset )
+         {
+            size_t done = 0;
+            while( done < len )
+            {
+               const int64_t r = sys_pwrite( fd, buf + done, len - done, offset + done );
+               if( r < 0 && errno == EINTR )
+                  continue;
+               if( r < 0 )
+                  throw io_error( "pwrite", errno );
+               done += r;
+            }
+            return done;
+         }
+
+#ifdef FC_HAS_IO_URING
+         /** An operation in flight in the ring */
+         class uring_op {
+            public:
+               virtual ~uring_op() {}
+               /** Called by the completion thread with the result of the operation */
+               virtual void complete( int result ) = 0;
+         };
+
+         /** A single io_uring instance, set up with raw system calls so that
+          *  liburing is not needed. Submissions are serialized by a lock, and a
+          *  dedicated thread reaps completions and resolves the promises.
+          */
+         class uring {
+            public:
+               static const unsigned entries = 256;
+
+               /** @return the ring, or nullptr if the kernel does not provide or permit io_uring */
+               static uring* instance()
+               {
+                  static uring the_ring;
+                  return the_ring.ring_fd >= 0 ? &the_ring : nullptr;
+               }
+
+               /** Submits an operation. Fails if the ring is full, unless it is a
+                *  continuation, which takes over the slot of the operation it continues.
+                *  @return false if the operation was not submitted */
+               bool submit( uint8_t opcode, int fd, const iovec* iov, uint64_t offset, uring_op* op,
+                            bool continuation = false )
+               {
+                  boost::unique_lock<boost::mutex> lock( submit_lock );
+                  if( !continuation && in_flight.load( boost::memory_order_relaxed ) >= sq_entries )
+                     return false;
+                  const unsigned tail = *sq_tail;
+                  if( tail - __atomic_load_n( sq_head, __ATOMIC_ACQUIRE ) >= sq_entries )
+                     return false;
+                  const unsigned index = tail & *sq_mask;
+                  io_uring_sqe& sqe = sqes[index];
+                  memset( &sqe, 0, sizeof(sqe) );
+                  sqe.opcode = opcode;
+                  sqe.fd = fd;
+                  sqe.off = offset;
+                  sqe.addr = reinterpret_cast<uint64_t>( iov );
+                  sqe.len = iov ? 1 : 0;
+                  sqe.user_data = reinterpret_cast<uint64_t>( op );
+                  sq_array[index] = index;
+                  __atomic_store_n( sq_tail, tail + 1, __ATOMIC_RELEASE );
+                  while( true )
+                  {
+                     if( syscall( __NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0 ) >= 0 )
+                        break;
+                     if( errno == EINTR || errno == EAGAIN || errno == EBUSY )
+                     {
+                        boost::this_thread::yield();
+                        continue;
+                     }
+                     // the kernel did not take the entry, withdraw it
+                     if( __atomic_load_n( sq_head, __ATOMIC_ACQUIRE ) == tail )
+                     {
+                        __atomic_store_n( sq_tail, tail, __ATOMIC_RELEASE );
+                        return false;
+                     }
+                     break;
+                  }
+                  if( !continuation )
+                     in_flight.fetch_add( 1, boost::memory_order_relaxed );
+                  return true;
+               }
+
+            private:
+               uring() : ring_fd( -1 )
+               {
+                  io_uring_params params;
+                  memset( &params, 0, sizeof(params) );
+                  const int fd = syscall( __NR_io_uring_setup, entries, &params );
+                  if( fd < 0 )
+                  {
+                     ilog( "io_uring is not available, file I/O runs in a thread pool: ${e}", ("e",std::strerror( errno )) );
+                     return;
+                  }
+                  sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                  cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                  const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+                  if( single_mmap )
+                     sq_size = cq_size = std::max( sq_size, cq_size );
+                  sq_ring = mmap( nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+                  cq_ring = single_mmap ? sq_ring
+                                        : mmap( nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                fd, IORING_OFF_CQ_RING );
+                  sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+                  void* sqe_map = mmap( nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                        fd, IORING_OFF_SQES );
+                  if( sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqe_map == MAP_FAILED )
+                  {
+                     wlog( "Failed to map the io_uring, file I/O runs in a thread pool" );
+                     if( sq_ring != MAP_FAILED ) munmap( sq_ring, sq_size );
+                     if( !single_mmap && cq_ring != MAP_FAILED ) munmap( cq_ring, cq_size );
+                     if( sqe_map != MAP_FAILED ) munmap( sqe_map, sqes_size );
+                     ::close( fd );
+                     return;
+                  }
+                  char* sq = static_cast<char*>( sq_ring );
+                  char* cq = static_cast<char*>( cq_ring );
+                  sq_head = reinterpret_cast<unsigned*>( sq + params.sq_off.head );
+                  sq_tail = reinterpret_cast<unsigned*>( sq + params.sq_off.tail );
+                  sq_mask = reinterpret_cast<unsigned*>( sq + params.sq_off.ring_mask );
+                  sq_array = reinterpret_cast<unsigned*>( sq + params.sq_off.array );
+                  sq_entries = params.sq_entries;
+                  sqes = static_cast<io_uring_sqe*>( sqe_map );
+                  cq_head = reinterpret_cast<unsigned*>( cq + params.cq_off.head );
+                  cq_tail = reinterpret_cast<unsigned*>( cq + params.cq_off.tail );
+                  cq_mask = reinterpret_cast<unsigned*>( cq + params.cq_off.ring_mask );
+                  cqes = reinterpret_cast<io_uring_cqe*>( cq + params.cq_off.cqes );
+                  in_flight.store( 0 );
+                  ring_fd = fd;
+                  reaper = boost::thread( [this] { reap(); } );
+               }
+
+               ~uring()
+               {
+                  if( ring_fd < 0 )
+                     return;
+                  // a NOP without an operation tells the completion thread to stop
+                  if( submit( IORING_OP_NOP, -1, nullptr, 0, nullptr, true ) )
+                     reaper.join();
+                  else
+                     reaper.detach();
+                  munmap( sqes, sqes_size );
+                  if( cq_ring != sq_ring )
+                     munmap( cq_ring, cq_size );
+                  munmap( sq_ring, sq_size );
+                  ::close( ring_fd );
+               }
+
+               void reap()
+               {
+                  bool stop = false;
+                  while( !stop )
+                  {
+                     if( syscall( __NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0 ) < 0
+                         && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+                     {
+                        elog( "io_uring_enter failed: ${e}", ("e",std::strerror( errno )) );
+                        return;
+                     }
+                     unsigned head = *cq_head;
+                     const unsigned tail = __atomic_load_n( cq_tail, __ATOMIC_ACQUIRE );
+                     while( head != tail )
+                     {
+                        const io_uring_cqe& cqe = cqes[head & *cq_mask];
+                        uring_op* op = reinterpret_cast<uring_op*>( cqe.user_data );
+                        const int result = cqe.res;
+                        ++head;
+                        __atomic_store_n( cq_head, head, __ATOMIC_RELEASE );
+                        if( op )
+                           op->complete( result );
+                        else
+                           stop = true;
+                     }
+                  }
+               }
+
+            public:
+               /** Called by an operation when it is done for good */
+               void release_slot() { in_flight.fetch_sub( 1, boost::memory_order_relaxed ); }
+
+            private:
+               int                   ring_fd;
+               boost::mutex          submit_lock;
+               boost::atomic<unsigned> in_flight;
+               boost::thread         reaper;
+
+               void*         sq_ring;
+               void*         cq_ring;
+               size_t        sq_size;
+               size_t        cq_size;
+               size_t        sqes_size;
+               unsigned*     sq_head;
+               unsigned*     sq_tail;
+               unsigned*     sq_mask;
+               unsigned*     sq_array;
+               unsigned      sq_entries;
+               io_uring_sqe* sqes;
+               unsigned*     cq_head;
+               unsigned*     cq_tail;
+               unsigned*     cq_mask;
+               io_uring_cqe* cqes;
+         };
+
+         uring* get_uring()
+         {
+            return io_uring_enabled.load( boost::memory_order_relaxed ) ? uring::instance() : nullptr;
+         }
+
+         /** A read or write, resubmitted until all bytes are transferred or the end of the file is reached */
+         class uring_rw_op : public uring_op {
+            public:
+               uring_rw_op( uring& r, const std::shared_ptr<const int>& f, uint8_t code,
+                            char* b, size_t l, uint64_t off, const char* desc )
+                  : ring(r), fd(f), opcode(code), buf(b), len(l), offset(off), done(0),
+                    result( promise<size_t>::create( desc ) ) {}
+
+               bool start( bool continuation = false )
+               {
+                  iov.iov_base = buf + done;
+                  iov.iov_len = len - done;
+                  return ring.submit( opcode, *fd, &iov, offset + done, this, continuation );
+               }
+
+               virtual void complete( int res ) override
+               {
+                  if( res == -EINTR || res == -EAGAIN )
+                     res = 0;
+                  else if( res < 0 )
+                     return finish( io_error( opcode == IORING_OP_READV ? "pread" : "pwrite", -res ).dynamic_copy_exception() );
+                  else if( res == 0 && opcode == IORING_OP_READV )
+                     return finish( nullptr );
+                  done += res;
+                  if( done == len )
+                     return finish( nullptr );
+                  if( start( true ) )
+                     return;
+                  // the ring has failed, do the rest the slow way
+                  ring.release_slot();
+                  run_blocking( [this] () {
+                     std::unique_ptr<uring_rw_op> self( this );
+                     try
+                     {
+                        done += opcode == IORING_OP_READV ? blocking_pread( *fd, buf + done, len - done, offset + done )
+                                                          : blocking_pwrite( *fd, buf + done, len - done, offset + done );
+                        result->set_value( done );
+                     }
+                     catch( const fc::exception& e )
+                     {
+                        result->set_exception( e.dynamic_copy_exception() );
+                     }
+                     catch( const std::exception& e )
+                     {
+                        result->set_exception( std::make_shared<unhandled_exception>( FC_LOG_MESSAGE( warn, "${what}", ("what",e.what()) ) ) );
+                     }
+                     catch( ... )
+                     {
+                        result->set_exception( std::make_shared<unhandled_exception>( FC_LOG_MESSAGE( warn, "unhandled exception: ${diagnostic}", ("diagnostic",boost::current_exception_diagnostic_information()) ) ) );
+                     }
+                  }, "async_file continuation" );
+               }
+
+               uring&                          ring;
+               std::shared_ptr<const int>      fd; // keeps the file open
+               const uint8_t                   opcode;
+               char* const                     buf;
+               const size_t                    len;
+               const uint64_t                  offset;
+               size_t                          done;
+               iovec                           iov;
+               promise<size_t>::ptr            result;
+
+            private:
+               void finish( const fc::exception_ptr& e )
+               {
+                  std::unique_ptr<uring_rw_op> self( this );
+                  ring.release_slot();
+                  if( e )
+                     result->set_exception( e );
+                  else
+                     result->set_value( done );
+               }
+         };
+
+         class uring_fsync_op : public uring_op {
+            public:
+               uring_fsync_op( uring& r, const std::shared_ptr<const int>& f )
+                  : ring(r), fd(f), result( promise<void>::create( "async_file::fsync" ) ) {}
+
+               virtual void complete( int res ) override
+               {
+                  std::unique_ptr<uring_fsync_op> self( this );
+                  ring.release_slot();
+                  if( res < 0 )
+                     result->set_exception( io_error( "fsync", -res ).dynamic_copy_exception() );
+                  else
+                     result->set_value();
+               }
+
+               uring&                     ring;
+               std::shared_ptr<const int> fd; // keeps the file open
+               promise<void>::ptr         result;
+         };
+#endif
+      }
+   }
+
+   async_file::async_file() {}
+
+   async_file::async_file( const fc::path& file, int m )
+   {
+      open( file, m );
+   }
+
+   async_file::~async_file() {}
+
+   void async_file::open( const fc::path& file, int m )
+   {
+      int flags = ( m & read ) && ( m & write ) ? O_RDWR : ( m & write ) ? O_WRONLY : O_RDONLY;
+      if( m & create )   flags |= O_CREAT;
+      if( m & truncate ) flags |= O_TRUNC;
+#ifdef _WIN32
+      flags |= O_BINARY;
+      const int fd = ::_wopen( file.wstring().c_str(), flags, _S_IREAD | _S_IWRITE );
+#else
+      flags |= O_CLOEXEC;
+      const int fd = ::open( file.string().c_str(), flags, 0644 );
+#endif
+      if( fd < 0 )
+      {
+         if( errno == ENOENT )
+            FC_THROW_EXCEPTION( file_not_found_exception, "Unable to open ${file}", ("file",file) );
+         FC_THROW( "Unable to open ${file}: ${e}", ("file",file)("e",std::strerror( errno )) );
+      }
+      my = std::make_shared<impl>( fd );
+   }
+
+   bool async_file::is_open()const { return my != nullptr; }
+
+   void async_file::close() { my.reset(); }
+
+   uint64_t async_file::size()const
+   {
+      FC_ASSERT( my, "File is not open" );
+      struct stat st;
+      if( fstat( my->fd, &st ) != 0 )
+         throw detail::io_error( "fstat", errno );
+      return st.st_size;
+   }
+
+   future<size_t> async_file::pread( char* buf, size_t len, uint64_t offset )
+   {
+      FC_ASSERT( my, "File is not open" );
+      if( len == 0 )
+         return future<size_t>( promise<size_t>::create( size_t(0) ) );
+#ifdef FC_HAS_IO_URING
+      if( detail::uring* ring = detail::get_uring() )
+      {
+         auto op = new detail::uring_rw_op( *ring, std::shared_ptr<const int>( my, &my->fd ), IORING_OP_READV, buf, len, offset, "async_file::pread" );
+         future<size_t> result( op->result );
+         if( op->start() )
+            return result;
+         delete op;
+      }
+#endif
+      std::shared_ptr<impl> file = my;
+      return detail::run_blocking( [file,buf,len,offset] () {
+         return detail::blocking_pread( file->fd, buf, len, offset );
+      }, "async_file::pread" );
+   }
+
+   future<size_t> async_file::pwrite( const char* buf, size_t len, uint64_t offset )
+   {
+      FC_ASSERT( my, "File is not open" );
+      if( len == 0 )
+         return future<size_t>( promise<size_t>::create( size_t(0) ) );
+#ifdef FC_HAS_IO_URING
+      if( detail::uring* ring = detail::get_uring() )
+      {
+         // the buffer is only read from, the op shares its type with reads
+         auto op = new detail::uring_rw_op( *ring, std::shared_ptr<const int>( my, &my->fd ), IORING_OP_WRITEV, const_cast<char*>( buf ), len, offset, "async_file::pwrite" );
+         future<size_t> result( op->result );
+         if( op->start() )
+            return result;
+         delete op;
+      }
+#endif
+      std::shared_ptr<impl> file = my;
+      return detail::run_blocking( [file,buf,len,offset] () {
+         return detail::blocking_pwrite( file->fd, buf, len, offset );
+      }, "async_file::pwrite" );
+   }
+
+   future<void> async_file::fsync()
+   {
+      FC_ASSERT( my, "File is not open" );
+#ifdef FC_HAS_IO_URING
+      if( detail::uring* ring = detail::get_uring() )
+      {
+         auto op = new detail::uring_fsync_op( *ring, std::shared_ptr<const int>( my, &my->fd ) );
+         future<void> result( op->result );
+         if( ring->submit( IORING_OP_FSYNC, my->fd, nullptr, 0, op ) )
+            return result;
+         delete op;
+      }
+#endif
+      std::shared_ptr<impl> file = my;
+      return detail::run_blocking( [file] () {
+         while( detail::sys_fsync( file->fd ) != 0 )
+            if( errno != EINTR )
+               throw detail::io_error( "fsync", errno );
+      }, "async_file::fsync" );
+   }
+
+   void async_file::set_num_io_threads( uint16_t num_threads )
+   {
+      FC_ASSERT( num_threads > 0 );
+      detail::num_file_io_threads = num_threads;
+   }
+
+   uint16_t async_file::get_num_io_threads() { return detail::num_file_io_threads; }
+
+   void async_file::enable_io_uring( bool enable )
+   {
+      detail::io_uring_enabled.store( enable );
+   }
+
+   bool async_file::uses_io_uring()
+   {
+#ifdef FC_HAS_IO_URING
+      return detail::get_uring() != nullptr;
+#else
+      return false;
+#endif
+   }
+
+   future<std::string> async_read_file( const fc::path& filename )
+   {
+      // opening and sizing the file block as well, so all of it runs in the pool
+      return detail::run_blocking( [filename] () {
+         async_file file( filename, async_file::read );
+         std::string result;
+         result.resize( file.size() );
+         result.resize( detail::blocking_pread( file.my->fd, &result[0], result.size(), 0 ) );
+         return result;
+      }, "async_read_file" );
+   }
+
+} // namespace fc
@@ -0,0 +1,199 @@
+#include <fc/thread/affinity.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#ifdef __linux__
+# include <pthread.h>
+# include <sched.h>
+#endif
+
+namespace fc {
+
+   namespace detail {
+
+      namespace {
+         /** Parses a list like "0-3,8,10-11", as found in /sys */
+         std::vector<unsigned> parse_cpu_list( const std::string& list )
+         {
+            std::vector<unsigned> result;
+            std::stringstream ss( list );
+            std::string range;
+            while( std::getline( ss, range, ',' ) )
+            {
+               if( range.empty() || range[0] < '0' || range[0] > '9' )
+                  continue;
+               const size_t dash = range.find( '-' );
+               const unsigned first = std::stoul( range.substr( 0, dash ) );
+               const unsigned last = dash == std::string::npos ? first : std::stoul( range.substr( dash + 1 ) );
+               for( unsigned cpu = first; cpu <= last; ++cpu )
+                  result.push_back( cpu );
+            }
+            return result;
+         }
+
+         struct numa_topology {
+            numa_topology()
+            {
+#ifdef __linux__
+               std::ifstream online( "/sys/devices/system/node/online" );
+               std::string nodes;
+               if( std::getline( online, nodes ) )
+                  for( unsigned node : parse_cpu_list( nodes ) )
+                  {
+                     std::ifstream cpulist( "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist" );
+                     std::string cpus;
+                     if( !std::getline( cpulist, cpus ) )
+                        continue;
+                     if( node_cpus.size() <= node )
+                        node_cpus.resize( node + 1 );
+                     node_cpus[node] = parse_cpu_list( cpus );
+                  }
+#endif
+               if( node_cpus.empty() )
+               {
+                  node_cpus.resize( 1 );
+                  for( unsigned cpu = 0; cpu < std::max( boost::thread::hardware_concurrency(), 1U ); ++cpu )
+                     node_cpus[0].push_back( cpu );
+               }
+               for( unsigned node = 0; node < node_cpus.size(); ++node )
+                  for( unsigned cpu : node_cpus[node] )
+                  {
+                     if( cpu_node.size() <= cpu )
+                        cpu_node.resize( cpu + 1, 0 );
+                     cpu_node[cpu] = node;
+                  }
+            }
+
+            std::vector<std::vector<unsigned>> node_cpus;
+            std::vector<unsigned>              cpu_node;
+         };
+
+         const numa_topology& get_topology()
+         {
+            static const numa_topology topology;
+            return topology;
+         }
+
+         struct placement_registry {
+            boost::mutex                            lock;
+            thread_placement                        groups[2];
+            std::map<std::string, thread_placement> named;
+         };
+
+         placement_registry& get_placement_registry()
+         {
+            static placement_registry* registry = new placement_registry();
+            return *registry;
+         }
+      }
+
+      void apply_named_thread_placement( const std::string& thread_name )
+      {
+         const thread_placement placement = get_thread_placement( thread_name );
+         if( !placement.empty() && !apply_thread_placement( placement ) )
+            wlog( "Failed to apply the placement of thread ${n}", ("n",thread_name) );
+      }
+
+   } // detail
+
+   thread_placement thread_placement::for_member( size_t index )const
+   {
+      if( !pin_each )
+         return *this;
+      thread_placement result;
+      result.numa_node = numa_node;
+      const std::vector<unsigned> all = cpus.empty() && numa_node >= 0 ? numa_node_cpus( numa_node ) : cpus;
+      if( !all.empty() )
+         result.cpus.push_back( all[ index % all.size() ] );
+      return result;
+   }
+
+   void set_thread_placement( thread_group group, const thread_placement& placement )
+   {
+      detail::placement_registry& registry = detail::get_placement_registry();
+      boost::unique_lock<boost::mutex> guard( registry.lock );
+      registry.groups[ size_t(group) ] = placement;
+   }
+
+   thread_placement get_thread_placement( thread_group group )
+   {
+      detail::placement_registry& registry = detail::get_placement_registry();
+      boost::unique_lock<boost::mutex> guard( registry.lock );
+      return registry.groups[ size_t(group) ];
+   }
+
+   void set_thread_placement( const std::string& thread_name, const thread_placement& placement )
+   {
+      detail::placement_registry& registry = detail::get_placement_registry();
+      boost::unique_lock<boost::mutex> guard( registry.lock );
+      if( placement.empty() )
+         registry.named.erase( thread_name );
+      else
+         registry.named[thread_name] = placement;
+   }
+
+   thread_placement get_thread_placement( const std::string& thread_name )
+   {
+      detail::placement_registry& registry = detail::get_placement_registry();
+      boost::unique_lock<boost::mutex> guard( registry.lock );
+      auto itr = registry.named.find( thread_name );
+      return itr == registry.named.end() ? thread_placement() : itr->second;
+   }
+
+   bool apply_thread_placement( const thread_placement& placement )
+   {
+      std::vector<unsigned> cpus = placement.cpus;
+      if( cpus.empty() && placement.numa_node >= 0 )
+      {
+         if( unsigned(placement.numa_node) >= numa_node_count() )
+            return false;
+         cpus = numa_node_cpus( placement.numa_node );
+      }
+      if( cpus.empty() )
+         return true;
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO( &set );
+      for( unsigned cpu : cpus )
+      {
+         if( cpu >= CPU_SETSIZE )
+            return false;
+         CPU_SET( cpu, &set );
+      }
+      return pthread_setaffinity_np( pthread_self(), sizeof(set), &set ) == 0;
+#else
+      return false;
+#endif
+   }
+
+   unsigned numa_node_count()
+   {
+      return detail::get_topology().node_cpus.size();
+   }
+
+   std::vector<unsigned> numa_node_cpus( unsigned node )
+   {
+      const detail::numa_topology& topology = detail::get_topology();
+      return node < topology.node_cpus.size() ? topology.node_cpus[node] : std::vector<unsigned>();
+   }
+
+   unsigned current_numa_node()
+   {
+#ifdef __linux__
+      const detail::numa_topology& topology = detail::get_topology();
+      if( topology.node_cpus.size() < 2 )
+         return 0;
+      const int cpu = sched_getcpu();
+      return cpu >= 0 && size_t(cpu) < topology.cpu_node.size() ? topology.cpu_node[cpu] : 0;
+#else
+      return 0;
+#endif
+   }
+
+} // fc
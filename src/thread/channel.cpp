@@ -0,0 +1,72 @@
+#include <fc/thread/channel.hpp>
+#include <fc/thread/unique_lock.hpp>
+
+#include <boost/assert.hpp>
+
+#include <algorithm>
+
+namespace fc { namespace detail {
+
+   channel_waiters::channel_waiters() : _count(0) {}
+
+   channel_waiters::~channel_waiters()
+   {
+      BOOST_ASSERT( _waiters.empty() && "Attempt to destroy a channel while others are blocking on it." );
+   }
+
+   promise<void>::ptr channel_waiters::enqueue()
+   {
+      promise<void>::ptr waiter = promise<void>::create( "channel_waiter" );
+      {
+         fc::unique_lock<fc::spin_yield_lock> lock( _lock );
+         _waiters.push_back( waiter );
+         _count.fetch_add( 1 );
+      }
+      // pairs with the fence in the channel after it has changed its state
+      std::atomic_thread_fence( std::memory_order_seq_cst );
+      return waiter;
+   }
+
+   void channel_waiters::cancel( const promise<void>::ptr& waiter )
+   {
+      {
+         fc::unique_lock<fc::spin_yield_lock> lock( _lock );
+         auto itr = std::find( _waiters.begin(), _waiters.end(), waiter );
+         if( itr != _waiters.end() )
+         {
+            _waiters.erase( itr );
+            _count.fetch_sub( 1 );
+            return;
+         }
+      }
+      // we have been notified, but someone else has to take our turn
+      notify_one();
+   }
+
+   void channel_waiters::notify_one()
+   {
+      promise<void>::ptr waiter;
+      {
+         fc::unique_lock<fc::spin_yield_lock> lock( _lock );
+         if( _waiters.empty() )
+            return;
+         waiter = std::move( _waiters.front() );
+         _waiters.pop_front();
+         _count.fetch_sub( 1 );
+      }
+      waiter->set_value();
+   }
+
+   void channel_waiters::notify_all()
+   {
+      std::deque<promise<void>::ptr> waiters;
+      {
+         fc::unique_lock<fc::spin_yield_lock> lock( _lock );
+         waiters.swap( _waiters );
+         _count.store( 0 );
+      }
+      for( const auto& waiter : waiters )
+         waiter->set_value();
+   }
+
+} } // fc::detail
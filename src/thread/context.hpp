@@ -15,24 +15,25 @@
 #endif
 
 #if BOOST_VERSION >= 106100
-  #include <boost/coroutine/stack_allocator.hpp>
   namespace bc  = boost::context::detail;
-  namespace bco = boost::coroutines;
-  typedef bco::stack_allocator stack_allocator;
 #else
-# include <boost/coroutine/stack_context.hpp>
   namespace bc  = boost::context;
-  namespace bco = boost::coroutines;
-# if !defined(NDEBUG)
-#  include <boost/assert.hpp>
-#  include <boost/coroutine/protected_stack_allocator.hpp>
+#endif // BOOST_VERSION >= 106100
+
+#include <boost/coroutine/stack_context.hpp>
+namespace bco = boost::coroutines;
+#if !defined(NDEBUG)
+# include <boost/assert.hpp>
+# include <boost/coroutine/protected_stack_allocator.hpp>
   typedef bco::protected_stack_allocator stack_allocator;
-# else
-#  include <boost/coroutine/stack_allocator.hpp>
+#else
+# include <boost/coroutine/stack_allocator.hpp>
   typedef bco::stack_allocator stack_allocator;
-# endif
+#endif
 
-#endif // BOOST_VERSION >= 106100
+#include "stack_pool.hpp"
+
+namespace fc { namespace detail { struct task_stats; } }
 
 namespace fc {
   class thread;
@@ -54,9 +55,10 @@ namespace fc {
     using context_fn = void(*)(intptr_t);
 #endif
 
-    context( context_fn sf, stack_allocator& alloc, fc::thread* t )
+    context( context_fn sf, size_t stack_size, fc::thread* t )
     : caller_context(0),
-      stack_alloc(&alloc),
+      stack_size(stack_size),
+      stack_painted(false),
       next_blocked(0), 
       next_blocked_mutex(0), 
       next(0), 
@@ -67,17 +69,18 @@ namespace fc {
 #endif
       complete(false),
       cur_task(0),
+      cur_task_stats(nullptr),
       context_posted_num(0)
     {
-     size_t stack_size = FC_CONTEXT_STACK_SIZE;
-     alloc.allocate(stack_ctx, stack_size);
+     detail::stack_pool::get().allocate(stack_ctx, stack_size);
      my_context = bc::make_fcontext( stack_ctx.sp, stack_ctx.size, sf); 
     }
 
     context( fc::thread* t) :
      my_context(nullptr),
      caller_context(0),
-     stack_alloc(0),
+     stack_size(detail::stack_pool::size_class(0)),
+     stack_painted(false),
      next_blocked(0), 
      next_blocked_mutex(0), 
      next(0), 
@@ -88,12 +91,13 @@ namespace fc {
 #endif
      complete(false),
      cur_task(0),
+     cur_task_stats(nullptr),
      context_posted_num(0)
     {}
 
     ~context() {
-      if(stack_alloc)
-        stack_alloc->deallocate( stack_ctx );
+      if(stack_ctx.sp)
+        detail::stack_pool::get().deallocate( stack_ctx );
     }
 
     void reinitialize()
@@ -181,11 +185,13 @@ namespace fc {
 
     bc::fcontext_t               my_context;
     fc::context*                caller_context;
-    stack_allocator*            stack_alloc;
+    size_t                      stack_size;    // size class of the stack, see stack_pool
+    bool                        stack_painted; // used for measuring stack usage
     priority                     prio;
     //promise_base*              prom; 
     std::vector<blocked_promise> blocking_prom;
     time_point                   resume_time;
+    detail::timer_link           sleep_link;   // links this context into the sleep queue of its thread
    // time_point                   ready_time; // time that this context was put on ready queue
     fc::context*                next_blocked;
     fc::context*                next_blocked_mutex;
@@ -197,6 +203,7 @@ namespace fc {
 #endif
     bool                         complete;
     task_base*                   cur_task;
+    detail::task_stats*          cur_task_stats; // statistics of cur_task, see thread_d::stats
     uint64_t                     context_posted_num; // serial number set each tiem the context is added to the ready list
   };
 
@@ -0,0 +1,223 @@
+#include <fc/thread/fiber_trace.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include "thread_stats.hpp"
+#include "trace_buffer.hpp"
+
+#include <boost/thread/mutex.hpp>
+
+#include <memory>
+#include <vector>
+
+#ifndef FC_FIBER_TRACE_BUFFER_SIZE
+# define FC_FIBER_TRACE_BUFFER_SIZE (64*1024)
+#endif
+
+namespace fc {
+
+   namespace detail {
+
+      boost::atomic<bool>     fiber_tracing_active(false);
+      boost::atomic<uint64_t> last_trace_id(0);
+
+      namespace {
+         struct trace_event {
+            uint64_t         ticks;
+            uint64_t         task_id; // 0 if the task was posted while tracing was disabled
+            const char*      name;
+            trace_event_type type;
+         };
+
+         /** Ring buffer of trace events, written only by the thread it belongs to.
+          *  Readers copy the events, and then discard those that the writer may
+          *  have overwritten in the meantime.
+          */
+         class trace_buffer {
+         public:
+            trace_buffer( uint32_t id, const std::string& name )
+               : thread_id(id), thread_name(name), events(FC_FIBER_TRACE_BUFFER_SIZE), head(0), start(0) {}
+
+            void record( trace_event_type type, uint64_t task_id, const char* name )
+            {
+               const uint64_t index = head.load( boost::memory_order_relaxed );
+               trace_event& event = events[ index % events.size() ];
+               event.ticks = read_cycle_counter();
+               event.task_id = task_id;
+               event.name = name;
+               event.type = type;
+               head.store( index + 1, boost::memory_order_release );
+            }
+
+            void read( std::vector<trace_event>& result )const
+            {
+               const uint64_t size = events.size();
+               const uint64_t end = head.load( boost::memory_order_acquire );
+               const uint64_t first = std::max( start.load( boost::memory_order_acquire ), end > size ? end - size : 0 );
+               const size_t offset = result.size();
+               for( uint64_t i = first; i < end; ++i )
+                  result.push_back( events[ i % size ] );
+               // the writer may be overwriting the slot of index (now - size) right now
+               boost::atomic_thread_fence( boost::memory_order_acquire );
+               const uint64_t now = head.load( boost::memory_order_relaxed );
+               const uint64_t first_valid = now >= size ? now - size + 1 : 0;
+               if( first_valid > first )
+                  result.erase( result.begin() + offset,
+                                result.begin() + offset + std::min<uint64_t>( first_valid - first, end - first ) );
+            }
+
+            void clear()
+            {
+               start.store( head.load( boost::memory_order_acquire ), boost::memory_order_release );
+            }
+
+            const uint32_t    thread_id;
+            const std::string thread_name;
+         private:
+            std::vector<trace_event> events;
+            boost::atomic<uint64_t>  head;
+            boost::atomic<uint64_t>  start;
+         };
+
+         struct trace_registry {
+            boost::mutex                               lock;
+            std::vector<std::unique_ptr<trace_buffer>> buffers;
+         };
+
+         trace_registry& get_trace_registry()
+         {
+            // never destroyed, threads may record events during static destruction
+            static trace_registry* registry = new trace_registry();
+            return *registry;
+         }
+
+         trace_buffer*& current_trace_buffer()
+         {
+#ifdef _MSC_VER
+            static __declspec(thread) trace_buffer* buffer = NULL;
+#else
+            static __thread trace_buffer* buffer = NULL;
+#endif
+            return buffer;
+         }
+
+         variant make_event( const char* phase, const char* name, const char* category, double ts, uint32_t tid )
+         {
+            return mutable_variant_object( "ph", phase )
+                                         ( "name", name ? name : "" )
+                                         ( "cat", category )
+                                         ( "ts", ts )
+                                         ( "pid", 1 )
+                                         ( "tid", tid );
+         }
+
+         std::string flow_id( uint64_t task_id )
+         {
+            return std::to_string( task_id );
+         }
+      }
+
+      void record_trace_event_slow( trace_event_type type, uint64_t task_id, const char* name )
+      {
+         trace_buffer*& buffer = current_trace_buffer();
+         if( !buffer )
+         {
+            const std::string thread_name = thread::current().name();
+            trace_registry& registry = get_trace_registry();
+            boost::unique_lock<boost::mutex> guard( registry.lock );
+            registry.buffers.emplace_back( new trace_buffer( registry.buffers.size() + 1, thread_name ) );
+            buffer = registry.buffers.back().get();
+         }
+         buffer->record( type, task_id, name );
+      }
+
+   } // detail
+
+   void enable_fiber_tracing( bool enable )
+   {
+      detail::fiber_tracing_active.store( enable, boost::memory_order_relaxed );
+   }
+
+   void clear_fiber_trace()
+   {
+      detail::trace_registry& registry = detail::get_trace_registry();
+      boost::unique_lock<boost::mutex> guard( registry.lock );
+      for( auto& buffer : registry.buffers )
+         buffer->clear();
+   }
+
+   variant get_fiber_trace()
+   {
+      using detail::trace_event_type;
+
+      std::vector<std::pair<const detail::trace_buffer*, std::vector<detail::trace_event>>> threads;
+      {
+         detail::trace_registry& registry = detail::get_trace_registry();
+         boost::unique_lock<boost::mutex> guard( registry.lock );
+         for( auto& buffer : registry.buffers )
+         {
+            threads.emplace_back( buffer.get(), std::vector<detail::trace_event>() );
+            buffer->read( threads.back().second );
+         }
+      }
+
+      uint64_t base = UINT64_MAX;
+      for( const auto& thread : threads )
+         if( !thread.second.empty() )
+            base = std::min( base, thread.second.front().ticks );
+      const double us_per_tick = detail::nanoseconds_per_tick() / 1000;
+
+      variants events;
+      for( const auto& thread : threads )
+      {
+         const uint32_t tid = thread.first->thread_id;
+         events.emplace_back( mutable_variant_object( "ph", "M" )( "name", "thread_name" )( "pid", 1 )( "tid", tid )
+                                 ( "args", mutable_variant_object( "name", thread.first->thread_name ) ) );
+         for( const detail::trace_event& event : thread.second )
+         {
+            const double ts = ( event.ticks - base ) * us_per_tick;
+            switch( event.type )
+            {
+               case trace_event_type::post:
+                  events.emplace_back( mutable_variant_object( detail::make_event( "s", event.name, "flow", ts, tid ) )
+                                          ( "id", detail::flow_id( event.task_id ) ) );
+                  break;
+               case trace_event_type::begin:
+                  events.emplace_back( detail::make_event( "B", event.name, "task", ts, tid ) );
+                  if( event.task_id )
+                     events.emplace_back( mutable_variant_object( detail::make_event( "f", event.name, "flow", ts, tid ) )
+                                             ( "id", detail::flow_id( event.task_id ) )( "bp", "e" ) );
+                  break;
+               case trace_event_type::resume:
+                  events.emplace_back( mutable_variant_object( detail::make_event( "B", event.name, "task", ts, tid ) )
+                                          ( "args", mutable_variant_object( "resumed", true ) ) );
+                  break;
+               case trace_event_type::end:
+               case trace_event_type::block:
+               case trace_event_type::yield:
+               {
+                  const char* state = event.type == trace_event_type::end ? "done"
+                                    : event.type == trace_event_type::block ? "blocked" : "yielded";
+                  events.emplace_back( mutable_variant_object( detail::make_event( "E", event.name, "task", ts, tid ) )
+                                          ( "args", mutable_variant_object( "state", state ) ) );
+                  break;
+               }
+               case trace_event_type::unblock:
+                  events.emplace_back( mutable_variant_object( detail::make_event( "i", event.name, "unblock", ts, tid ) )
+                                          ( "s", "t" ) );
+                  break;
+            }
+         }
+      }
+
+      return mutable_variant_object( "traceEvents", std::move(events) )( "displayTimeUnit", "ns" );
+   }
+
+   void write_fiber_trace( const path& file )
+   {
+      json::save_to_file( get_fiber_trace(), file, false, json::legacy_generator );
+   }
+
+} // fc
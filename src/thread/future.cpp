@@ -8,6 +8,15 @@
 
 namespace fc {
 
+  namespace {
+     /** Replaces the handler list of a promise once its handlers have been called */
+     class completed_marker : public detail::completion_handler {
+       public:
+         virtual void on_complete( const void* v, const fc::exception_ptr& e ) {}
+     };
+     completed_marker completed;
+  }
+
   promise_base::promise_base( const char* desc )
   :_ready(false),
    _blocked_thread(nullptr),
@@ -18,10 +27,19 @@ namespace fc {
    _cancellation_reason(nullptr),
 #endif
    _desc(desc),
+   _value(nullptr),
    _compl(nullptr)
   { }
 
-  promise_base::~promise_base() { }
+  promise_base::~promise_base() {
+     detail::completion_handler* hdl = _compl.load();
+     while( hdl && hdl != &completed )
+     {
+        detail::completion_handler* next = hdl->_next;
+        delete hdl;
+        hdl = next;
+     }
+  }
 
   const char* promise_base::get_desc()const{
     return _desc; 
@@ -125,16 +143,40 @@ namespace fc {
      bool ready = false;
      if( !_ready.compare_exchange_strong( ready, true ) ) //don't allow promise to be set more than once
         return;
+     _value = s;
      _notify();
-     auto* hdl = _compl.load();
-     if( nullptr != hdl )
-        hdl->on_complete( s, std::atomic_load( &_exceptp ) );
+     detail::completion_handler* hdl = _compl.exchange( &completed );
+     // handlers have been pushed in front, call them in the order of registration
+     detail::completion_handler* ordered = nullptr;
+     while( hdl )
+     {
+        detail::completion_handler* next = hdl->_next;
+        hdl->_next = ordered;
+        ordered = hdl;
+        hdl = next;
+     }
+     const fc::exception_ptr e = std::atomic_load( &_exceptp );
+     while( ordered )
+     {
+        std::unique_ptr<detail::completion_handler> current( ordered );
+        ordered = ordered->_next;
+        current->on_complete( s, e );
+     }
   }
 
   void promise_base::_on_complete( detail::completion_handler* c ) {
-     auto* hdl = _compl.load();
+     detail::completion_handler* hdl = _compl.load();
+     do
+     {
+        if( hdl == &completed )
+        {
+           std::unique_ptr<detail::completion_handler> current( c );
+           current->on_complete( _value, std::atomic_load( &_exceptp ) );
+           return;
+        }
+        c->_next = hdl;
+     }
      while( !_compl.compare_exchange_weak( hdl, c ) );
-     delete hdl;
   }
 }
 
@@ -23,6 +23,8 @@
  */
 
 #include <fc/thread/parallel.hpp>
+#include <fc/thread/affinity.hpp>
+#include <fc/thread/spin_lock.hpp>
 #include <fc/thread/spin_yield_lock.hpp>
 #include <fc/thread/unique_lock.hpp>
 #include <fc/asio.hpp>
@@ -30,49 +32,124 @@
 #include <boost/atomic/atomic.hpp>
 #include <boost/lockfree/queue.hpp>
 
+#include <deque>
+#include <memory>
+
 namespace fc {
    namespace detail {
       class idle_notifier_impl : public thread_idle_notifier
       {
       public:
-         idle_notifier_impl()
+         idle_notifier_impl() : node(0)
          {
             is_idle.store(false);
+            queued.store(0);
          }
 
          idle_notifier_impl( const idle_notifier_impl& copy )
          {
             id = copy.id;
+            node = copy.node;
             my_pool = copy.my_pool;
             is_idle.store( copy.is_idle.load() );
+            queued.store( copy.queued.load() );
+            local_tasks = copy.local_tasks;
          }
 
          virtual ~idle_notifier_impl() {}
 
          virtual task_base* idle();
-         virtual void       busy()
+         virtual void       busy();
+
+         /** Adds a task posted by this worker to its own queue */
+         void push_local( task_base* task )
          {
-            is_idle.store(false);
+            fc::unique_lock<fc::spin_lock> lock( local_lock );
+            local_tasks.push_back( task );
+            queued.store( local_tasks.size(), boost::memory_order_release );
+         }
+
+         /** Adds several tasks posted by this worker to its own queue */
+         void push_local( const std::vector<task_base*>& tasks )
+         {
+            fc::unique_lock<fc::spin_lock> lock( local_lock );
+            local_tasks.insert( local_tasks.end(), tasks.begin(), tasks.end() );
+            queued.store( local_tasks.size(), boost::memory_order_release );
          }
 
-         uint32_t            id;
-         pool_impl*          my_pool;
-         boost::atomic<bool> is_idle;
+         /** Takes the most recently posted task from the own queue (LIFO, cache-friendly) */
+         task_base* pop_local()
+         {
+            if( queued.load( boost::memory_order_acquire ) == 0 )
+               return 0;
+            fc::unique_lock<fc::spin_lock> lock( local_lock );
+            if( local_tasks.empty() )
+               return 0;
+            task_base* task = local_tasks.back();
+            local_tasks.pop_back();
+            queued.store( local_tasks.size(), boost::memory_order_release );
+            return task;
+         }
+
+         /** Takes the oldest task from this worker's queue on behalf of another worker (FIFO) */
+         task_base* steal()
+         {
+            if( queued.load( boost::memory_order_acquire ) == 0 )
+               return 0;
+            fc::unique_lock<fc::spin_lock> lock( local_lock, fc::try_to_lock_t() );
+            if( !lock || local_tasks.empty() )
+               return 0;
+            task_base* task = local_tasks.front();
+            local_tasks.pop_front();
+            queued.store( local_tasks.size(), boost::memory_order_release );
+            return task;
+         }
+
+         uint32_t                  id;
+         uint32_t                  node; // the NUMA node the worker last went idle on
+         pool_impl*                my_pool;
+         boost::atomic<bool>       is_idle;
+         boost::atomic<uint32_t>   queued;
+         fc::spin_lock             local_lock;
+         std::deque<task_base*>    local_tasks;
+         char                      padding[64]; // keep the hot members of neighbouring workers apart
       };
 
+      static idle_notifier_impl*& current_worker()
+      {
+#ifdef _MSC_VER
+         static __declspec(thread) idle_notifier_impl* w = NULL;
+#else
+         static __thread idle_notifier_impl* w = NULL;
+#endif
+         return w;
+      }
+
       class pool_impl
       {
       public:
-         explicit pool_impl( const uint16_t num_threads )
-            : idle_threads( 2 * num_threads ), waiting_tasks( 200 )
+         pool_impl( const uint16_t num_threads, const std::string& name )
+            : waiting_tasks( 200 )
          {
+            idle_count.store( 0 );
+            for( unsigned node = 0; node < numa_node_count(); node++ )
+               idle_threads.emplace_back( new boost::lockfree::queue<idle_notifier_impl*>( 2 * num_threads ) );
             notifiers.resize( num_threads );
             threads.reserve( num_threads );
+            const thread_placement placement = get_thread_placement( thread_group::pool_workers );
             for( uint32_t i = 0; i < num_threads; i++ )
             {
                notifiers[i].id = i;
                notifiers[i].my_pool = this;
-               threads.push_back( new thread( "pool worker " + fc::to_string(i), &notifiers[i] ) );
+               threads.push_back( new thread( name + " " + fc::to_string(i), &notifiers[i] ) );
+               if( !placement.empty() )
+               {
+                  const thread_placement member_placement = placement.for_member( i );
+                  threads.back()->async( [i,member_placement] {
+                     if( !apply_thread_placement( member_placement ) )
+                        wlog( "Failed to apply the placement of pool worker ${i}", ("i",i) );
+                  }, "thread placement" ).wait();
+               }
             }
          }
          ~pool_impl()
@@ -82,59 +159,196 @@ namespace fc {
             waiting_tasks.consume_all( [] ( task_base* t ) {
                t->cancel( "thread pool quitting" );
             });
+            for( idle_notifier_impl& worker : notifiers )
+               for( task_base* t : worker.local_tasks )
+                  t->cancel( "thread pool quitting" );
          }
 
-         thread* post( task_base* task )
+         uint16_t size()const { return threads.size(); }
+
+         /** Hands the task to an idle worker if there is one. Tasks posted
+          *  from within a worker of this pool are queued locally by that
+          *  worker, where they are picked up by the worker itself or stolen
+          *  by others. Everything else goes into the shared queue.
+          *  @param task the task to post. If a worker is returned, task is
+          *          set to the task that worker must receive - nullptr means
+          *          the worker only needs to be woken up to look for work.
+          *  @return the thread that must receive the task, or nullptr if it
+          *          has been queued
+          */
+         thread* post( task_base*& task )
          {
-            idle_notifier_impl* ini;
-            while( idle_threads.pop( ini ) )
-               if( ini->is_idle.exchange( false ) )
-               { // minor race condition here, a thread might receive a task while it's busy
-                  return threads[ini->id];
-               }
+            idle_notifier_impl* self = current_worker();
+            if( self && self->my_pool == this )
+            {
+               self->push_local( task );
+               task = 0;
+               // An idle worker registers itself before it looks for tasks
+               // to steal, so checking for idle workers *after* queueing
+               // guarantees that at least one side sees the other.
+               if( idle_count.load() == 0 )
+                  return 0;
+               thread* idle = claim_idle_thread();
+               if( idle )
+                  task = self->pop_local(); // may have been stolen in the meantime
+               return idle;
+            }
+
+            thread* idle = idle_count.load( boost::memory_order_relaxed ) > 0 ? claim_idle_thread() : 0;
+            if( idle )
+               return idle;
             boost::unique_lock<fc::spin_yield_lock> lock(pool_lock);
-            while( idle_threads.pop( ini ) )
-               if( ini->is_idle.exchange( false ) )
-               { // minor race condition here, a thread might receive a task while it's busy
-                  return threads[ini->id];
-               }
+            idle = claim_idle_thread();
+            if( idle )
+               return idle;
             while( !waiting_tasks.push( task ) )
                elog( "Worker pool internal error" );
             return 0;
          }
 
+         /** Like post(), for several tasks. Idle workers are claimed for as many
+          *  tasks as possible, the remaining tasks are queued in one go.
+          *  @param handoffs receives the workers that must be notified, together with
+          *          the task they must receive - nullptr means the worker only needs
+          *          to be woken up to look for work
+          */
+         void post_batch( const std::vector<task_base*>& tasks, std::vector<std::pair<thread*,task_base*>>& handoffs )
+         {
+            idle_notifier_impl* self = current_worker();
+            if( self && self->my_pool == this )
+            {
+               self->push_local( tasks );
+               // idle workers steal from us, we keep at least one task for ourselves
+               for( size_t i = 1; i < tasks.size() && idle_count.load() > 0; i++ )
+               {
+                  thread* idle = claim_idle_thread();
+                  if( !idle )
+                     break;
+                  handoffs.emplace_back( idle, nullptr );
+               }
+               return;
+            }
+
+            size_t next = 0;
+            while( next < tasks.size() && idle_count.load( boost::memory_order_relaxed ) > 0 )
+            {
+               thread* idle = claim_idle_thread();
+               if( !idle )
+                  break;
+               handoffs.emplace_back( idle, tasks[next++] );
+            }
+            if( next == tasks.size() )
+               return;
+            boost::unique_lock<fc::spin_yield_lock> lock(pool_lock);
+            while( next < tasks.size() )
+            {
+               thread* idle = claim_idle_thread();
+               if( !idle )
+                  break;
+               handoffs.emplace_back( idle, tasks[next++] );
+            }
+            for( ; next < tasks.size(); next++ )
+               while( !waiting_tasks.push( tasks[next] ) )
+                  elog( "Worker pool internal error" );
+         }
+
+         /** Looks for work in this order: own queue, shared queue, other workers' queues */
+         task_base* find_task( idle_notifier_impl* ini )
+         {
+            task_base* task = ini->pop_local();
+            if( task || waiting_tasks.pop( task ) )
+               return task;
+            return steal( ini );
+         }
+
          task_base* enqueue_idle_thread( idle_notifier_impl* ini )
          {
             task_base* task;
-            if( waiting_tasks.pop( task ) )
-               return task;
-            fc::unique_lock<fc::spin_yield_lock> lock(pool_lock);
-            if( waiting_tasks.pop( task ) )
-               return task;
-            while( !idle_threads.push( ini ) )
-               elog( "Worker pool internal error" );
-            return 0;
+            {
+               fc::unique_lock<fc::spin_yield_lock> lock(pool_lock);
+               if( waiting_tasks.pop( task ) )
+                  return task;
+               ini->is_idle.store( true );
+               idle_count.fetch_add( 1 );
+               ini->node = std::min<uint32_t>( current_numa_node(), idle_threads.size() - 1 );
+               while( !idle_threads[ini->node]->push( ini ) )
+                  elog( "Worker pool internal error" );
+            }
+            // a busy worker may have queued something locally while we were registering
+            task = steal( ini );
+            if( task && ini->is_idle.exchange( false ) )
+               idle_count.fetch_sub( 1 );
+            return task;
          }
+
+         void worker_busy( idle_notifier_impl* ini )
+         {
+            if( ini->is_idle.exchange( false ) )
+               idle_count.fetch_sub( 1 );
+         }
+
       private:
+         /** Prefers idle workers on the NUMA node of the calling thread */
+         thread* claim_idle_thread()
+         {
+            const uint32_t nodes = idle_threads.size();
+            const uint32_t preferred = nodes > 1 ? std::min<uint32_t>( current_numa_node(), nodes - 1 ) : 0;
+            for( uint32_t i = 0; i < nodes; i++ )
+            {
+               idle_notifier_impl* ini;
+               while( idle_threads[(preferred + i) % nodes]->pop( ini ) )
+                  if( ini->is_idle.exchange( false ) )
+                  { // minor race condition here, a thread might receive a task while it's busy
+                     idle_count.fetch_sub( 1 );
+                     return threads[ini->id];
+                  }
+            }
+            return 0;
+         }
+
+         task_base* steal( idle_notifier_impl* thief )
+         {
+            const uint32_t count = notifiers.size();
+            for( uint32_t i = 1; i < count; i++ )
+            {
+               task_base* task = notifiers[(thief->id + i) % count].steal();
+               if( task )
+                  return task;
+            }
+            return 0;
+         }
+
          std::vector<idle_notifier_impl>                notifiers;
          std::vector<thread*>                           threads;
-         boost::lockfree::queue<idle_notifier_impl*>    idle_threads;
+         // one queue of idle workers per NUMA node
+         std::vector<std::unique_ptr<boost::lockfree::queue<idle_notifier_impl*>>> idle_threads;
          boost::lockfree::queue<task_base*>             waiting_tasks;
          fc::spin_yield_lock                            pool_lock;
+         boost::atomic<uint32_t>                        idle_count;
       };
 
       task_base* idle_notifier_impl::idle()
       {
-         is_idle.store( true );
-         task_base* result = my_pool->enqueue_idle_thread( this );
-         if( result ) is_idle.store( false );
-         return result;
+         current_worker() = this;
+         task_base* result = my_pool->find_task( this );
+         if( result ) return result;
+         return my_pool->enqueue_idle_thread( this );
+      }
+
+      void idle_notifier_impl::busy()
+      {
+         my_pool->worker_busy( this );
       }
 
       worker_pool::worker_pool()
       {
          fc::asio::default_io_service();
-         my = new pool_impl( fc::asio::default_io_service_scope::get_num_threads() );
+         my = new pool_impl( fc::asio::default_io_service_scope::get_num_threads(), "pool worker" );
+      }
+
+      worker_pool::worker_pool( uint16_t num_threads, const std::string& name )
+      {
+         my = new pool_impl( num_threads, name );
       }
 
       worker_pool::~worker_pool()
@@ -142,11 +356,34 @@ namespace fc {
          delete my;
       }
 
+      uint16_t worker_pool::size()const
+      {
+         return my->size();
+      }
+
       void worker_pool::post( task_base* task )
       {
          thread* worker = my->post( task );
          if( worker )
-             worker->async_task( task, priority() );
+         {
+            if( task )
+               worker->async_task( task, priority() );
+            else
+               worker->poke();
+         }
+      }
+
+      void worker_pool::post_batch( const std::vector<task_base*>& tasks )
+      {
+         std::vector<std::pair<thread*,task_base*>> handoffs;
+         my->post_batch( tasks, handoffs );
+         for( const auto& handoff : handoffs )
+         {
+            if( handoff.second )
+               handoff.first->async_task( handoff.second, priority() );
+            else
+               handoff.first->poke();
+         }
       }
 
       worker_pool& get_worker_pool()
@@ -0,0 +1,87 @@
+#include <fc/thread/semaphore.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/thread/unique_lock.hpp>
+#include "context.hpp"
+#include "thread_d.hpp"
+
+#include <algorithm>
+
+namespace fc {
+
+  semaphore::semaphore( unsigned initial_count ) :
+    m_count(initial_count)
+  {}
+
+  semaphore::~semaphore() {
+    BOOST_ASSERT( m_waiting.empty() && "Attempt to free semaphore while others are blocking on it." );
+  }
+
+  bool semaphore::try_acquire() {
+    fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+    if( m_count == 0 )
+      return false;
+    --m_count;
+    return true;
+  }
+
+  void semaphore::acquire() {
+    fc::thread& current_thread = fc::thread::current();
+    if( !current_thread.my->current )
+      current_thread.my->current = new fc::context( &current_thread );
+    fc::context* current_context = current_thread.my->current;
+
+    {
+      fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+      if( m_count > 0 )
+      {
+        --m_count;
+        return;
+      }
+      m_waiting.push_back( current_context );
+    }
+
+    // the permit is handed over to us by release()
+    std::exception_ptr e; // cleanup may yield, so we need to move the exception outside of the catch block
+    try
+    {
+      current_thread.yield(false);
+    }
+    catch( ... )
+    {
+      e = std::current_exception();
+    }
+    if( e )
+    {
+      bool owned = true;
+      {
+        fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+        auto itr = std::find( m_waiting.begin(), m_waiting.end(), current_context );
+        if( itr != m_waiting.end() )
+        {
+          m_waiting.erase( itr );
+          owned = false;
+        }
+      }
+      if( owned )
+        release();
+      std::rethrow_exception(e);
+    }
+  }
+
+  void semaphore::release( unsigned count ) {
+    std::deque<fc::context*> to_unblock;
+    {
+      fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+      while( count > 0 && !m_waiting.empty() )
+      {
+        to_unblock.push_back( m_waiting.front() );
+        m_waiting.pop_front();
+        --count;
+      }
+      m_count += count;
+    }
+    for( fc::context* c : to_unblock )
+      c->ctx_thread->my->unblock( c );
+  }
+
+} // fc
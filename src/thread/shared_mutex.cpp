@@ -0,0 +1,161 @@
+#include <fc/thread/shared_mutex.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/thread/unique_lock.hpp>
+#include "context.hpp"
+#include "thread_d.hpp"
+
+#include <algorithm>
+
+namespace fc {
+
+  namespace {
+    bool remove_waiter( std::deque<fc::context*>& waiters, fc::context* c ) {
+      auto itr = std::find( waiters.begin(), waiters.end(), c );
+      if( itr == waiters.end() )
+        return false;
+      waiters.erase( itr );
+      return true;
+    }
+  }
+
+  shared_mutex::shared_mutex() :
+    m_readers(0),
+    m_writer(false)
+  {}
+
+  shared_mutex::~shared_mutex() {
+    BOOST_ASSERT( m_waiting_writers.empty() && m_waiting_readers.empty()
+                  && "Attempt to free shared_mutex while others are blocking on lock." );
+  }
+
+  bool shared_mutex::try_lock() {
+    fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+    if( m_writer || m_readers > 0 )
+      return false;
+    m_writer = true;
+    return true;
+  }
+
+  void shared_mutex::lock() {
+    fc::thread& current_thread = fc::thread::current();
+    if( !current_thread.my->current )
+      current_thread.my->current = new fc::context( &current_thread );
+    fc::context* current_context = current_thread.my->current;
+
+    {
+      fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+      if( !m_writer && m_readers == 0 )
+      {
+        m_writer = true;
+        return;
+      }
+      m_waiting_writers.push_back( current_context );
+    }
+
+    // the lock is handed over to us by the fiber that releases it
+    std::exception_ptr e; // cleanup may yield, so we need to move the exception outside of the catch block
+    try
+    {
+      current_thread.yield(false);
+    }
+    catch( ... )
+    {
+      e = std::current_exception();
+    }
+    if( e )
+    {
+      bool owned;
+      {
+        fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+        owned = !remove_waiter( m_waiting_writers, current_context );
+      }
+      if( owned )
+        unlock();
+      std::rethrow_exception(e);
+    }
+  }
+
+  void shared_mutex::unlock() {
+    std::deque<fc::context*> to_unblock;
+    {
+      fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+      assert( m_writer );
+      if( !m_waiting_writers.empty() )
+      {
+        // m_writer stays set, ownership passes directly to the next writer
+        to_unblock.push_back( m_waiting_writers.front() );
+        m_waiting_writers.pop_front();
+      }
+      else
+      {
+        m_writer = false;
+        m_readers = m_waiting_readers.size();
+        to_unblock.swap( m_waiting_readers );
+      }
+    }
+    for( fc::context* c : to_unblock )
+      c->ctx_thread->my->unblock( c );
+  }
+
+  bool shared_mutex::try_lock_shared() {
+    fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+    if( m_writer || !m_waiting_writers.empty() )
+      return false;
+    ++m_readers;
+    return true;
+  }
+
+  void shared_mutex::lock_shared() {
+    fc::thread& current_thread = fc::thread::current();
+    if( !current_thread.my->current )
+      current_thread.my->current = new fc::context( &current_thread );
+    fc::context* current_context = current_thread.my->current;
+
+    {
+      fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+      // queue up behind waiting writers, so that they are not starved
+      if( !m_writer && m_waiting_writers.empty() )
+      {
+        ++m_readers;
+        return;
+      }
+      m_waiting_readers.push_back( current_context );
+    }
+
+    std::exception_ptr e;
+    try
+    {
+      current_thread.yield(false);
+    }
+    catch( ... )
+    {
+      e = std::current_exception();
+    }
+    if( e )
+    {
+      bool owned;
+      {
+        fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+        owned = !remove_waiter( m_waiting_readers, current_context );
+      }
+      if( owned )
+        unlock_shared();
+      std::rethrow_exception(e);
+    }
+  }
+
+  void shared_mutex::unlock_shared() {
+    fc::context* to_unblock = nullptr;
+    {
+      fc::unique_lock<fc::spin_yield_lock> lock(m_lock);
+      assert( m_readers > 0 );
+      if( --m_readers > 0 || m_waiting_writers.empty() )
+        return;
+      m_writer = true;
+      to_unblock = m_waiting_writers.front();
+      m_waiting_writers.pop_front();
+    }
+    to_unblock->ctx_thread->my->unblock( to_unblock );
+  }
+
+} // fc
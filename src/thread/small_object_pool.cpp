@@ -0,0 +1,259 @@
+#include <fc/thread/small_object_pool.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#ifndef FC_SMALL_OBJECT_CACHE_SIZE
+# define FC_SMALL_OBJECT_CACHE_SIZE 256 // blocks per size class and thread
+#endif
+
+namespace fc {
+
+   namespace detail {
+
+      namespace {
+         const size_t GRANULARITY = 64;
+         const unsigned SIZE_CLASSES = 32; // up to 2 kB
+         const size_t BATCH_SIZE = FC_SMALL_OBJECT_CACHE_SIZE / 2 > 0 ? FC_SMALL_OBJECT_CACHE_SIZE / 2 : 1;
+
+         struct free_block {
+            free_block* next;
+         };
+
+         /** A singly linked list of free blocks that knows its length */
+         struct free_list {
+            free_list() : head(nullptr), count(0) {}
+
+            void push( free_block* block )
+            {
+               block->next = head;
+               head = block;
+               ++count;
+            }
+            free_block* pop()
+            {
+               free_block* block = head;
+               head = block->next;
+               --count;
+               return block;
+            }
+            /** Moves up to n blocks from the front of this list to the front of the other */
+            void move_to( free_list& other, size_t n )
+            {
+               while( n-- > 0 && head )
+                  other.push( pop() );
+            }
+
+            free_block* head;
+            size_t      count;
+         };
+
+         struct counters {
+            counters() : allocations(0), deallocations(0), system_allocations(0), oversized(0) {}
+
+            /** For counters that are written by the owning thread only */
+            static void increment( boost::atomic<uint64_t>& counter )
+            {
+               counter.store( counter.load( boost::memory_order_relaxed ) + 1, boost::memory_order_relaxed );
+            }
+            /** For counters that are written by several threads */
+            static void increment_shared( boost::atomic<uint64_t>& counter )
+            {
+               counter.fetch_add( 1, boost::memory_order_relaxed );
+            }
+
+            boost::atomic<uint64_t> allocations;
+            boost::atomic<uint64_t> deallocations;
+            boost::atomic<uint64_t> system_allocations;
+            boost::atomic<uint64_t> oversized;
+         };
+
+         struct thread_cache {
+            free_list lists[SIZE_CLASSES];
+            counters  stats;
+         };
+
+         class shared_pool {
+         public:
+            /** Moves a batch of free blocks of the given class to the thread cache
+             *  @return false if there are none */
+            bool refill( unsigned index, free_list& list )
+            {
+               boost::unique_lock<boost::mutex> guard( lock );
+               if( !lists[index].head )
+                  return false;
+               lists[index].move_to( list, BATCH_SIZE );
+               return true;
+            }
+            void give_back( unsigned index, free_list& list, size_t n )
+            {
+               boost::unique_lock<boost::mutex> guard( lock );
+               list.move_to( lists[index], n );
+            }
+
+            void add( thread_cache* cache )
+            {
+               boost::unique_lock<boost::mutex> guard( lock );
+               caches.push_back( cache );
+            }
+            /** Takes over all blocks and counts of an exiting thread */
+            void retire( thread_cache* cache )
+            {
+               boost::unique_lock<boost::mutex> guard( lock );
+               for( unsigned i = 0; i < SIZE_CLASSES; ++i )
+                  cache->lists[i].move_to( lists[i], cache->lists[i].count );
+               add( retired, cache->stats );
+               caches.erase( std::remove( caches.begin(), caches.end(), cache ), caches.end() );
+            }
+
+            small_object_pool_stats get_stats()
+            {
+               boost::unique_lock<boost::mutex> guard( lock );
+               small_object_pool_stats result = retired;
+               add( result, uncached );
+               for( const thread_cache* cache : caches )
+                  add( result, cache->stats );
+               return result;
+            }
+
+            /** Counts oversized requests, and activity of threads that have no cache anymore */
+            counters uncached;
+
+         private:
+            static void add( small_object_pool_stats& sum, const counters& c )
+            {
+               sum.allocations        += c.allocations.load( boost::memory_order_relaxed );
+               sum.deallocations      += c.deallocations.load( boost::memory_order_relaxed );
+               sum.system_allocations += c.system_allocations.load( boost::memory_order_relaxed );
+               sum.oversized          += c.oversized.load( boost::memory_order_relaxed );
+            }
+
+            boost::mutex               lock;
+            free_list                  lists[SIZE_CLASSES];
+            std::vector<thread_cache*> caches;
+            small_object_pool_stats    retired = {};
+         };
+
+         shared_pool& get_shared_pool()
+         {
+            // never destroyed, because tasks may still be released during static destruction
+            static shared_pool* pool = new shared_pool();
+            return *pool;
+         }
+
+#ifdef _MSC_VER
+         static __declspec(thread) thread_cache* current_cache = NULL;
+         static __declspec(thread) bool          cache_retired = false;
+#else
+         static __thread thread_cache* current_cache = NULL;
+         static __thread bool          cache_retired = false;
+#endif
+
+         /** Hands the cache of a thread over to the shared pool when the thread exits */
+         struct cache_retirement {
+            ~cache_retirement()
+            {
+               thread_cache* cache = current_cache;
+               current_cache = NULL;
+               cache_retired = true;
+               get_shared_pool().retire( cache );
+               delete cache;
+            }
+         };
+
+         /** @return the cache of the current thread, or NULL while the thread is exiting */
+         thread_cache* get_thread_cache()
+         {
+            if( !current_cache && !cache_retired )
+            {
+               current_cache = new thread_cache();
+               get_shared_pool().add( current_cache );
+               static thread_local cache_retirement retirement;
+               (void)retirement;
+            }
+            return current_cache;
+         }
+
+         void* allocate_block( unsigned index )
+         {
+            return ::operator new( ( index + 1 ) * GRANULARITY );
+         }
+      }
+
+      void* small_object_allocate( size_t size )
+      {
+         if( size == 0 )
+            size = 1;
+         const unsigned index = ( size - 1 ) / GRANULARITY;
+         if( index >= SIZE_CLASSES )
+         {
+            counters::increment_shared( get_shared_pool().uncached.oversized );
+            return ::operator new( size );
+         }
+
+         thread_cache* cache = get_thread_cache();
+         if( !cache )
+         {
+            shared_pool& pool = get_shared_pool();
+            counters::increment_shared( pool.uncached.allocations );
+            free_list list;
+            if( !pool.refill( index, list ) )
+            {
+               counters::increment_shared( pool.uncached.system_allocations );
+               return allocate_block( index );
+            }
+            free_block* block = list.pop();
+            pool.give_back( index, list, list.count );
+            return block;
+         }
+
+         free_list& list = cache->lists[index];
+         counters::increment( cache->stats.allocations );
+         if( list.head || get_shared_pool().refill( index, list ) )
+            return list.pop();
+         counters::increment( cache->stats.system_allocations );
+         return allocate_block( index );
+      }
+
+      void small_object_deallocate( void* p, size_t size )
+      {
+         if( !p )
+            return;
+         if( size == 0 )
+            size = 1;
+         const unsigned index = ( size - 1 ) / GRANULARITY;
+         if( index >= SIZE_CLASSES )
+         {
+            ::operator delete( p );
+            return;
+         }
+
+         thread_cache* cache = get_thread_cache();
+         if( !cache )
+         {
+            shared_pool& pool = get_shared_pool();
+            counters::increment_shared( pool.uncached.deallocations );
+            free_list list;
+            list.push( static_cast<free_block*>( p ) );
+            pool.give_back( index, list, 1 );
+            return;
+         }
+
+         free_list& list = cache->lists[index];
+         counters::increment( cache->stats.deallocations );
+         list.push( static_cast<free_block*>( p ) );
+         if( list.count > FC_SMALL_OBJECT_CACHE_SIZE )
+            get_shared_pool().give_back( index, list, BATCH_SIZE );
+      }
+
+   } // detail
+
+   small_object_pool_stats get_small_object_pool_stats()
+   {
+      return detail::get_shared_pool().get_stats();
+   }
+
+} // fc
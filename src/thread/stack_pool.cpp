@@ -0,0 +1,178 @@
+#include "stack_pool.hpp"
+#include "context.hpp"
+
+#include <fc/thread/thread.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/coroutine/stack_traits.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <map>
+#include <vector>
+
+#ifndef FC_STACK_POOL_CACHE_SIZE
+# define FC_STACK_POOL_CACHE_SIZE (32*1024*1024)
+#endif
+
+namespace fc {
+
+   namespace detail {
+
+      namespace {
+         const unsigned MAX_SIZE_CLASSES = 64;
+         const uint64_t STACK_PATTERN = 0x5a5a5a5a5a5a5a5aULL;
+         // keep this much distance from the stack pointer when painting, to stay clear
+         // of the red zone and of the frames of functions called while painting
+         const size_t PAINT_MARGIN = 4096;
+
+         unsigned log2_of( size_t size )
+         {
+            unsigned result = 0;
+            while( ( size_t(1) << result ) < size )
+               ++result;
+            return result;
+         }
+
+         /** @return the lowest usable address of the given stack */
+         char* stack_bottom( const bco::stack_context& ctx )
+         {
+            char* bottom = static_cast<char*>( ctx.sp ) - ctx.size;
+#ifndef NDEBUG
+            bottom += bco::stack_traits::page_size(); // guard page, see stack_allocator
+#endif
+            return bottom;
+         }
+
+         boost::atomic<bool> tracking_enabled(false);
+
+         struct usage_registry {
+            boost::mutex                       lock;
+            std::map<std::string, stack_usage> usage;
+         };
+
+         usage_registry& get_usage_registry()
+         {
+            static usage_registry* registry = new usage_registry();
+            return *registry;
+         }
+      }
+
+      class stack_pool::impl {
+      public:
+         boost::mutex                    lock;
+         std::vector<bco::stack_context> free_stacks[MAX_SIZE_CLASSES];
+         stack_allocator                 alloc;
+      };
+
+      stack_pool::stack_pool() : my( new impl() ) {}
+
+      stack_pool::~stack_pool()
+      {
+         for( auto& free_stacks : my->free_stacks )
+            for( auto& ctx : free_stacks )
+               my->alloc.deallocate( ctx );
+         delete my;
+      }
+
+      stack_pool& stack_pool::get()
+      {
+         // never destroyed, because fibers may still be released during static destruction
+         static stack_pool* pool = new stack_pool();
+         return *pool;
+      }
+
+      size_t stack_pool::size_class( size_t requested )
+      {
+         static const size_t min_size = size_t(1) << log2_of( std::max( { size_t(16*1024),
+                                                                           2 * bco::stack_traits::page_size(),
+                                                                           bco::stack_traits::minimum_size() } ) );
+         if( requested == 0 )
+            requested = FC_CONTEXT_STACK_SIZE;
+         if( requested <= min_size )
+            return min_size;
+         return size_t(1) << log2_of( requested );
+      }
+
+      void stack_pool::allocate( bco::stack_context& ctx, size_t size )
+      {
+         const unsigned index = log2_of( size );
+         FC_ASSERT( index < MAX_SIZE_CLASSES && ( size_t(1) << index ) == size, "Invalid stack size ${s}", ("s",size) );
+         {
+            boost::unique_lock<boost::mutex> guard( my->lock );
+            auto& free_stacks = my->free_stacks[index];
+            if( !free_stacks.empty() )
+            {
+               ctx = free_stacks.back();
+               free_stacks.pop_back();
+               return;
+            }
+         }
+         my->alloc.allocate( ctx, size );
+      }
+
+      void stack_pool::deallocate( bco::stack_context& ctx )
+      {
+         const unsigned index = log2_of( ctx.size );
+         {
+            boost::unique_lock<boost::mutex> guard( my->lock );
+            auto& free_stacks = my->free_stacks[index];
+            if( ( free_stacks.size() + 1 ) * ctx.size <= FC_STACK_POOL_CACHE_SIZE )
+            {
+               free_stacks.push_back( ctx );
+               ctx = bco::stack_context();
+               return;
+            }
+         }
+         my->alloc.deallocate( ctx );
+         ctx = bco::stack_context();
+      }
+
+      bool stack_usage_tracking_enabled()
+      {
+         return tracking_enabled.load( boost::memory_order_relaxed );
+      }
+
+      void paint_stack( const bco::stack_context& ctx )
+      {
+         volatile char marker = 0;
+         uint64_t* limit = reinterpret_cast<uint64_t*>( const_cast<char*>( &marker ) - PAINT_MARGIN );
+         for( uint64_t* p = reinterpret_cast<uint64_t*>( stack_bottom( ctx ) ); p < limit; ++p )
+            *p = STACK_PATTERN;
+      }
+
+      void record_stack_usage( const bco::stack_context& ctx, const char* task_desc )
+      {
+         const uint64_t* top = static_cast<const uint64_t*>( ctx.sp );
+         const uint64_t* p = reinterpret_cast<const uint64_t*>( stack_bottom( ctx ) );
+         while( p < top && *p == STACK_PATTERN )
+            ++p;
+         const size_t used = ( top - p ) * sizeof(uint64_t);
+
+         usage_registry& registry = get_usage_registry();
+         boost::unique_lock<boost::mutex> guard( registry.lock );
+         stack_usage& usage = registry.usage[ task_desc ? task_desc : "" ];
+         if( usage.samples++ == 0 )
+            usage.task_desc = task_desc ? task_desc : "";
+         usage.stack_size = std::max( usage.stack_size, ctx.size );
+         usage.max_used = std::max( usage.max_used, used );
+      }
+
+   } // detail
+
+   void enable_stack_usage_tracking( bool enable )
+   {
+      detail::tracking_enabled.store( enable, boost::memory_order_relaxed );
+   }
+
+   std::vector<stack_usage> get_stack_usage()
+   {
+      detail::usage_registry& registry = detail::get_usage_registry();
+      boost::unique_lock<boost::mutex> guard( registry.lock );
+      std::vector<stack_usage> result;
+      result.reserve( registry.usage.size() );
+      for( const auto& usage : registry.usage )
+         result.push_back( usage.second );
+      return result;
+   }
+
+} // fc
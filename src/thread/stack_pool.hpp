@@ -0,0 +1,49 @@
+#pragma once
+#include <boost/coroutine/stack_context.hpp>
+
+#include <cstddef>
+
+namespace fc { namespace detail {
+
+   /**
+    *  Process-wide cache of fiber stacks.
+    *
+    *  Stack sizes are rounded up to a power of two (the size class), and
+    *  released stacks are kept in a free list per size class for reuse by any
+    *  thread, up to a limit of FC_STACK_POOL_CACHE_SIZE bytes per class.
+    *  In debug builds each stack has a guard page at its lower end.
+    */
+   class stack_pool {
+   public:
+      static stack_pool& get();
+
+      /** @return the size class for the requested stack size, 0 means FC_CONTEXT_STACK_SIZE */
+      static size_t size_class( size_t requested );
+
+      /** Provides a stack of the given size class, which must be a result of size_class() */
+      void allocate( boost::coroutines::stack_context& ctx, size_t size );
+      /** Returns the stack to the pool */
+      void deallocate( boost::coroutines::stack_context& ctx );
+
+   private:
+      stack_pool();
+      ~stack_pool();
+
+      class impl;
+      impl* my;
+   };
+
+   /** @return true if stack usage tracking has been enabled */
+   bool stack_usage_tracking_enabled();
+
+   /** Fills the unused part of the currently active stack with a known pattern.
+    *  Must be called from the fiber that owns the stack.
+    */
+   void paint_stack( const boost::coroutines::stack_context& ctx );
+
+   /** Measures how much of the given (painted) stack has been used since it
+    *  was painted, and records it for the given task.
+    */
+   void record_stack_usage( const boost::coroutines::stack_context& ctx, const char* task_desc );
+
+} } // fc::detail
@@ -18,9 +18,16 @@ namespace fc {
   :
   promise_base("task_base"),
   _posted_num(0),
+  _stack_size(0),
+  _enqueue_time(0),
+  _trace_id(0),
   _active_context(nullptr),
   _next(nullptr),
+  _posted_to(nullptr),
+  _next_canceled(nullptr),
+  _cancel_notified(false),
   _task_specific_data(nullptr),
+  _fast_task_slots(nullptr),
   _promise_impl(nullptr),
   _functor(func),
   _retain_count(0){
@@ -75,7 +82,12 @@ namespace fc {
 #ifndef NDEBUG
       _active_context->cancellation_reason = reason;
 #endif
-      _active_context->ctx_thread->notify_task_has_been_canceled();
+      _active_context->ctx_thread->notify_task_has_been_canceled(this);
+    }
+    else if (_posted_to && _when != time_point::min() && !ready())
+    {
+      // a scheduled task that has not started, the thread removes it from its timer queue
+      _posted_to->notify_task_has_been_canceled(this);
     }
   }
 
@@ -100,6 +112,14 @@ namespace fc {
       delete _task_specific_data;
       _task_specific_data = nullptr;
     }
+    if (_fast_task_slots)
+    {
+      for (unsigned i = 0; i < FC_FAST_TASK_SLOTS; ++i)
+        if (_fast_task_slots->cleanups[i])
+          _fast_task_slots->cleanups[i](_fast_task_slots->values[i]);
+      delete _fast_task_slots;
+      _fast_task_slots = nullptr;
+    }
   }
 
   void task_base::retain() {
@@ -0,0 +1,225 @@
+#include <fc/thread/task_group.hpp>
+#include <fc/thread/spin_yield_lock.hpp>
+#include <fc/thread/unique_lock.hpp>
+#include <fc/exception/exception.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace fc {
+
+   namespace detail {
+
+      class task_group_state {
+      public:
+         typedef std::function<void(const char*)> canceler;
+
+         task_group_state( const char* d, const time_point& dl ) : desc(d), deadline(dl) {}
+
+         /** Cancels all children and subgroups, unless this has happened before.
+          *  @param reason becomes the result of wait_all() unless a child has failed already */
+         void cancel( const exception_ptr& reason, const char* why )
+         {
+            std::vector<canceler> to_cancel;
+            std::vector<std::shared_ptr<task_group_state>> to_cascade;
+            {
+               fc::unique_lock<fc::spin_yield_lock> guard( lock );
+               if( canceled )
+                  return;
+               canceled = true;
+               if( !first_error )
+                  first_error = reason;
+               to_cancel.reserve( children.size() );
+               for( const auto& child : children )
+                  to_cancel.push_back( child.second );
+               for( const auto& sub : subgroups )
+                  if( auto s = sub.second.lock() )
+                     to_cascade.push_back( s );
+            }
+            for( const canceler& c : to_cancel )
+               c( why );
+            for( const auto& s : to_cascade )
+               s->cancel( reason, why );
+         }
+
+         void cancel( const char* why )
+         {
+            cancel( std::make_shared<canceled_exception>( FC_LOG_MESSAGE( error, "task_group ${d} canceled",
+                                                                          ("d",desc) ) ),
+                    why );
+         }
+
+         void expire()
+         {
+            cancel( std::make_shared<timeout_exception>( FC_LOG_MESSAGE( error, "task_group ${d} missed its deadline",
+                                                                         ("d",desc) ) ),
+                    "task_group deadline" );
+         }
+
+         const char*                                               desc;
+         const time_point                                          deadline;
+         spin_yield_lock                                           lock;
+         std::unordered_map<uint64_t, canceler>                    children;
+         std::unordered_map<uint64_t, std::weak_ptr<task_group_state>> subgroups;
+         uint64_t                                                  next_id = 0;
+         std::vector<promise<void>::ptr>                           waiters;
+         exception_ptr                                             first_error;
+         bool                                                      canceled = false;
+         future<void>                                              timer;
+         std::weak_ptr<task_group_state>                           parent;
+         uint64_t                                                  id_in_parent = 0;
+      };
+
+      namespace {
+         void start_deadline_timer( const std::shared_ptr<task_group_state>& state )
+         {
+            if( state->deadline == time_point::maximum() )
+               return;
+            if( state->deadline <= time_point::now() )
+            {
+               state->expire();
+               return;
+            }
+            std::weak_ptr<task_group_state> weak( state );
+            state->timer = thread::current().schedule( [weak]() {
+               if( auto s = weak.lock() )
+                  s->expire();
+            }, state->deadline, "task_group deadline" );
+         }
+      }
+
+   } // detail
+
+   task_group::task_group( const char* desc )
+   :my( std::make_shared<detail::task_group_state>( desc, time_point::maximum() ) ) {}
+
+   task_group::task_group( const time_point& deadline, const char* desc )
+   :my( std::make_shared<detail::task_group_state>( desc, deadline ) )
+   {
+      detail::start_deadline_timer( my );
+   }
+
+   task_group::task_group( task_group& parent, const time_point& deadline, const char* desc )
+   :my( std::make_shared<detail::task_group_state>( desc, std::min( deadline, parent.deadline() ) ) )
+   {
+      my->parent = parent.my;
+      bool parent_canceled;
+      exception_ptr parent_error;
+      {
+         fc::unique_lock<fc::spin_yield_lock> guard( parent.my->lock );
+         my->id_in_parent = parent.my->next_id++;
+         parent.my->subgroups[my->id_in_parent] = my;
+         parent_canceled = parent.my->canceled;
+         parent_error = parent.my->first_error;
+      }
+      if( parent_canceled )
+         my->cancel( parent_error, "parent task_group canceled" );
+      else
+         detail::start_deadline_timer( my );
+   }
+
+   task_group::~task_group()
+   {
+      my->cancel( "task_group destroyed" );
+      try
+      {
+         wait_all();
+      }
+      catch( ... ) {}
+      my->timer.cancel( "task_group destroyed" );
+      if( auto parent = my->parent.lock() )
+      {
+         fc::unique_lock<fc::spin_yield_lock> guard( parent->lock );
+         parent->subgroups.erase( my->id_in_parent );
+      }
+   }
+
+   uint64_t task_group::add_child( std::function<void(const char*)>&& cancel )
+   {
+      uint64_t id;
+      bool canceled;
+      {
+         fc::unique_lock<fc::spin_yield_lock> guard( my->lock );
+         id = my->next_id++;
+         canceled = my->canceled;
+         my->children[id] = cancel;
+      }
+      if( canceled )
+         cancel( "task_group canceled" );
+      return id;
+   }
+
+   void task_group::child_completed( const std::weak_ptr<detail::task_group_state>& state, uint64_t id,
+                                     const exception_ptr& e )
+   {
+      std::shared_ptr<detail::task_group_state> s = state.lock();
+      if( !s )
+         return;
+      bool fail = false;
+      std::vector<promise<void>::ptr> waiters;
+      {
+         fc::unique_lock<fc::spin_yield_lock> guard( s->lock );
+         s->children.erase( id );
+         if( e && !s->first_error )
+         {
+            s->first_error = e;
+            fail = !s->canceled;
+         }
+         if( s->children.empty() )
+            waiters.swap( s->waiters );
+      }
+      if( fail )
+         s->cancel( e, "sibling task failed" );
+      for( const auto& w : waiters )
+         w->set_value();
+   }
+
+   void task_group::cancel( const char* reason )
+   {
+      my->cancel( reason );
+   }
+
+   bool task_group::canceled()const
+   {
+      {
+         fc::unique_lock<fc::spin_yield_lock> guard( my->lock );
+         if( my->canceled )
+            return true;
+      }
+      return time_point::now() >= my->deadline;
+   }
+
+   void task_group::check_canceled()const
+   {
+      if( canceled() )
+         FC_THROW_EXCEPTION( canceled_exception, "task_group ${d} canceled", ("d",my->desc) );
+   }
+
+   time_point task_group::deadline()const
+   {
+      return my->deadline;
+   }
+
+   size_t task_group::size()const
+   {
+      fc::unique_lock<fc::spin_yield_lock> guard( my->lock );
+      return my->children.size();
+   }
+
+   exception_ptr task_group::wait_all()
+   {
+      while( true )
+      {
+         promise<void>::ptr done;
+         {
+            fc::unique_lock<fc::spin_yield_lock> guard( my->lock );
+            if( my->children.empty() )
+               return my->first_error;
+            done = promise<void>::create( "task_group::wait_all" );
+            my->waiters.push_back( done );
+         }
+         future<void>( done ).wait();
+      }
+   }
+
+} // fc
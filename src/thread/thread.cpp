@@ -1,6 +1,8 @@
 #include <fc/thread/thread.hpp>
+#include <fc/thread/affinity.hpp>
 #include <fc/io/sstream.hpp>
 #include <fc/log/logger.hpp>
+#include <fc/variant.hpp>
 #include "thread_d.hpp"
 
 #include <iostream>
@@ -71,12 +73,13 @@ namespace fc {
       return t;
    }
 
-   thread::thread( const std::string& name, thread_idle_notifier* notifier ) {
+   thread::thread( const std::string& name, thread_idle_notifier* notifier, timer_backend timers ) {
       promise<void>::ptr p = promise<void>::create("thread start");
-      boost::thread* t = new boost::thread( [this,p,name,notifier]() {
+      boost::thread* t = new boost::thread( [this,p,name,notifier,timers]() {
           try {
             set_thread_name(name.c_str()); // set thread's name for the debugger to display
-            this->my = new thread_d( *this, notifier );
+            detail::apply_named_thread_placement( name );
+            this->my = new thread_d( *this, notifier, timers );
             cleanup();
             current_thread() = this;
             p->set_value();
@@ -132,6 +135,8 @@ namespace fc {
      if ( current_thread() ) {
         delete current_thread();
         current_thread() = nullptr;
+        detail::current_fast_task_slots() = nullptr;
+        detail::current_thread_specific_data() = nullptr;
      }
    }
 
@@ -160,6 +165,35 @@ namespace fc {
 
    void          thread::debug( const std::string& d ) { /*my->debug(d);*/ }
 
+   variant thread::get_stats()
+   {
+      if( !is_current() )
+         return async( [this](){ return get_stats(); }, "thread::get_stats", priority::max() ).wait();
+      return my->stats.to_variant( my->name );
+   }
+
+   void thread::reset_stats()
+   {
+      if( !is_current() )
+      {
+         async( [this](){ reset_stats(); }, "thread::reset_stats", priority::max() ).wait();
+         return;
+      }
+      my->stats.reset();
+   }
+
+   void thread::set_idle_policy( const idle_policy& policy )
+   {
+      my->spin_limit.store( policy.spin_iterations, boost::memory_order_relaxed );
+      my->yield_limit.store( policy.yield_iterations, boost::memory_order_relaxed );
+   }
+
+   idle_policy thread::get_idle_policy()const
+   {
+      return idle_policy( my->spin_limit.load( boost::memory_order_relaxed ),
+                          my->yield_limit.load( boost::memory_order_relaxed ) );
+   }
+
 #if defined(__linux__) || defined(__APPLE__)
 #include <signal.h>
 #endif
@@ -208,16 +242,22 @@ namespace fc {
       unstarted_task->set_exception(std::make_shared<canceled_exception>(FC_LOG_MESSAGE(error, "cancellation reason: thread quitting")));
     my->task_pqueue.clear();
 
-    for (task_base* scheduled_task : my->task_sch_queue)
+    while (task_base* scheduled_task = my->task_sch_queue.pop_any())
       scheduled_task->set_exception(std::make_shared<canceled_exception>(FC_LOG_MESSAGE(error, "cancellation reason: thread quitting")));
-    my->task_sch_queue.clear();
 
+    // tasks posted just before quitting have not been queued yet, and must not keep a pointer to
+    // this thread that task_base::cancel() could use after it is gone
+    for (task_base* posted_task = my->task_in_queue.exchange(0, boost::memory_order_seq_cst); posted_task; )
+    {
+      task_base* next = posted_task->_next;
+      posted_task->set_exception(std::make_shared<canceled_exception>(FC_LOG_MESSAGE(error, "cancellation reason: thread quitting")));
+      posted_task = next;
+    }
 
 
     // move all sleep tasks to ready
-    for( uint32_t i = 0; i < my->sleep_pqueue.size(); ++i )
-      my->add_context_to_ready_list( my->sleep_pqueue[i] );
-    my->sleep_pqueue.clear();
+    while( fc::context* sleeping = my->sleep_pqueue.pop_any() )
+      my->add_context_to_ready_list( sleeping );
 
     // move all idle tasks to ready
     fc::context* cur = my->pt_head;
@@ -240,6 +280,13 @@ namespace fc {
       my->start_next_fiber(true);
       my->check_for_timeouts();
     }
+    // the fibers have finished, nothing is left to do for canceled tasks
+    for (task_base* canceled = my->canceled_tasks.exchange(nullptr); canceled; )
+    {
+      task_base* next = canceled->_next_canceled;
+      canceled->release();
+      canceled = next;
+    }
     my->clear_free_list();
     my->cleanup_thread_specific_data();
   }
@@ -312,10 +359,7 @@ namespace fc {
        if( timeout != time_point::maximum() )
        {
            my->current->resume_time = timeout;
-           my->sleep_pqueue.push_back(my->current);
-           std::push_heap( my->sleep_pqueue.begin(),
-                           my->sleep_pqueue.end(),
-                           sleep_priority_less()   );
+           my->sleep_pqueue.push( my->current, timeout );
        }
 
        my->add_to_blocked( my->current );
@@ -338,8 +382,8 @@ namespace fc {
    }
 
    void thread::poke() {
-     boost::unique_lock<boost::mutex> lock(my->task_ready_mutex);
-     my->task_ready.notify_one();
+     my->poked.store( true, boost::memory_order_relaxed );
+     my->notify_if_parked();
    }
 
    void thread::async_task( task_base* t, const priority& p, const time_point& tp ) {
@@ -348,18 +392,55 @@ namespace fc {
       {
          FC_THROW_EXCEPTION( canceled_exception, "Thread is not running.");
       }
+      t->_prio = p;
       t->_when = tp;
+      t->_posted_to = this;
+      // before publishing the task, because it may be gone as soon as it is published
+      t->_trace_id = detail::new_trace_id();
+      detail::record_trace_event( detail::trace_event_type::post, t->_trace_id, t->get_desc() );
+      publish_tasks( t, t );
+   }
+
+   void thread::async_task_batch( const std::vector<task_base*>& tasks, const priority& p ) {
+      assert(my);
+      if( tasks.empty() )
+         return;
+      if ( !is_running() )
+      {
+         for( task_base* t : tasks )
+            t->release();
+         FC_THROW_EXCEPTION( canceled_exception, "Thread is not running.");
+      }
+      // link the tasks locally, the most recent one first like in task_in_queue
+      task_base* head = nullptr;
+      for( task_base* t : tasks )
+      {
+         t->_prio = p;
+         t->_when = time_point::min();
+         t->_trace_id = detail::new_trace_id();
+         detail::record_trace_event( detail::trace_event_type::post, t->_trace_id, t->get_desc() );
+         t->_next = head;
+         head = t;
+      }
+      publish_tasks( head, tasks.front() );
+   }
+
+   void thread::publish_tasks( task_base* head, task_base* tail ) {
+      // queue latency starts now, the tasks cannot be touched once they are published
+      const uint64_t posted = detail::read_cycle_counter();
+      for( task_base* t = head; t != tail; t = t->_next )
+         t->_enqueue_time = posted;
+      tail->_enqueue_time = posted;
       task_base* stale_head = my->task_in_queue.load(boost::memory_order_relaxed);
-      do { t->_next = stale_head;
-      }while( !my->task_in_queue.compare_exchange_weak( stale_head, t, boost::memory_order_release ) );
+      do { tail->_next = stale_head;
+      }while( !my->task_in_queue.compare_exchange_weak( stale_head, head, boost::memory_order_release ) );
 
       // Because only one thread can post the 'first task', only that thread will attempt
       // to aquire the lock and therefore there should be no contention on this lock except
-      // when *this thread is about to block on a wait condition.
-      if( this != &current() &&  !stale_head ) {
-          boost::unique_lock<boost::mutex> lock(my->task_ready_mutex);
-          my->task_ready.notify_one();
-      }
+      // when *this thread is about to block on a wait condition. A thread that is still
+      // running or spinning will find the task without being notified.
+      if( this != &current() &&  !stale_head )
+          my->notify_if_parked();
    }
 
    void yield() {
@@ -404,10 +485,7 @@ namespace fc {
          if( timeout != time_point::maximum() )
          {
              my->current->resume_time = timeout;
-             my->sleep_pqueue.push_back(my->current);
-             std::push_heap( my->sleep_pqueue.begin(),
-                             my->sleep_pqueue.end(),
-                             sleep_priority_less() );
+             my->sleep_pqueue.push( my->current, timeout );
          }
 
          my->add_to_blocked( my->current );
@@ -443,17 +521,8 @@ namespace fc {
           // remove it from the blocked list.
 
           // remove this context from the sleep queue...
-          for( uint32_t i = 0; i < my->sleep_pqueue.size(); ++i )
-          {
-            if( my->sleep_pqueue[i] == cur_blocked )
-            {
-              my->sleep_pqueue[i]->blocking_prom.clear();
-              my->sleep_pqueue[i] = my->sleep_pqueue.back();
-              my->sleep_pqueue.pop_back();
-              std::make_heap( my->sleep_pqueue.begin(),my->sleep_pqueue.end(), sleep_priority_less() );
-              break;
-            }
-          }
+          if( my->sleep_pqueue.remove( cur_blocked ) )
+            cur_blocked->blocking_prom.clear();
           auto cur = cur_blocked;
           if( prev_blocked )
           {
@@ -466,6 +535,8 @@ namespace fc {
               cur_blocked = my->blocked;
           }
           cur->next_blocked = 0;
+          if( cur->cur_task )
+            detail::record_trace_event( detail::trace_event_type::unblock, cur->cur_task->_trace_id, cur->cur_task->get_desc() );
           my->add_context_to_ready_list( cur );
         }
         else
@@ -481,9 +552,20 @@ namespace fc {
       return this == &current();
     }
 
-    void thread::notify_task_has_been_canceled()
+    void thread::notify_task_has_been_canceled( task_base* t )
     {
-      async( [this](){ my->notify_task_has_been_canceled(); }, "notify_task_has_been_canceled", priority::max() );
+      if( !is_running() )
+        return; // quit() fails or wakes up all tasks itself, and nothing would release the reference
+      if( t->_cancel_notified.exchange( true ) )
+        return; // queued already
+      t->retain(); // released when the thread has processed it
+      task_base* stale_head = my->canceled_tasks.load(boost::memory_order_relaxed);
+      do { t->_next_canceled = stale_head;
+      } while( !my->canceled_tasks.compare_exchange_weak( stale_head, t, boost::memory_order_release ) );
+
+      // like in publish_tasks(), a non-empty list will be seen by the thread anyway
+      if( this != &current() && !stale_head )
+        my->notify_if_parked();
     }
 
     void thread::unblock(fc::context* c)
@@ -499,6 +581,7 @@ namespace fc {
              task_base* work = notifier->idle();
              if( work )
              {
+                work->_enqueue_time = detail::read_cycle_counter();
                 task_base* stale_head = t->task_in_queue.load(boost::memory_order_relaxed);
                 do {
                    work->_next = stale_head;
@@ -1,8 +1,12 @@
 #include <fc/thread/thread.hpp>
+#include <fc/thread/thread_specific.hpp>
 #include <fc/stacktrace.hpp>
 #include <fc/time.hpp>
 #include <boost/thread.hpp>
 #include "context.hpp"
+#include "timer_queue.hpp"
+#include "thread_stats.hpp"
+#include "trace_buffer.hpp"
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread.hpp>
 #include <boost/atomic.hpp>
@@ -11,13 +15,19 @@
 #include <vector>
 
 namespace fc {
-    struct sleep_priority_less {
-        bool operator()( const context::ptr& a, const context::ptr& b ) {
-            return a->resume_time > b->resume_time;
-        }
-    };
-
     namespace detail {
+       /** Tells the CPU that we are in a busy loop */
+       inline void cpu_relax()
+       {
+#if defined(__x86_64__) || defined(__i386__)
+          __builtin_ia32_pause();
+#elif defined(_M_X64) || defined(_M_IX86)
+          _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+          __asm__ __volatile__( "yield" );
+#endif
+       }
+
        class idle_guard {
        public:
           explicit idle_guard( thread_d* t );
@@ -32,15 +42,24 @@ namespace fc {
         public:
            using context_pair = std::pair<thread_d*, fc::context*>;
 
-           thread_d( fc::thread& s, thread_idle_notifier* n = 0 )
+           thread_d( fc::thread& s, thread_idle_notifier* n = 0, timer_backend timers = timer_backend::binary_heap )
             :self(s), boost_thread(0),
+             parked(false),
+             poked(false),
+             spin_limit(0),
+             yield_limit(0),
+             spin_budget(UINT32_MAX),
              task_in_queue(0),
+             canceled_tasks(0),
              next_posted_num(1),
+             task_sch_queue(timers),
+             sleep_pqueue(timers),
              done(false),
              current(0),
              pt_head(0),
              blocked(0),
              next_unused_task_storage_slot(0),
+             non_task_fast_slots(nullptr),
              notifier(n)
 #ifndef NDEBUG
              ,non_preemptable_scope_count(0)
@@ -90,15 +109,22 @@ namespace fc {
 
            fc::thread&             self;
            boost::thread* boost_thread;
-           stack_allocator                  stack_alloc;
            boost::condition_variable        task_ready;
            boost::mutex                     task_ready_mutex;
+           boost::atomic<bool>              parked;      // waiting for task_ready, see notify_if_parked()
+           boost::atomic<bool>              poked;       // see thread::poke()
+           boost::atomic<uint32_t>          spin_limit;  // see idle_policy
+           boost::atomic<uint32_t>          yield_limit;
+           uint32_t                         spin_budget; // current number of spins, adapts to success
 
            boost::atomic<task_base*>       task_in_queue;
+           boost::atomic<task_base*>       canceled_tasks; // linked through _next_canceled, see thread::notify_task_has_been_canceled
            std::vector<task_base*>         task_pqueue;    // heap of tasks that have never started, ordered by proirity & scheduling time
            uint64_t                        next_posted_num; // each task or context gets assigned a number in the order it is ready to execute, tracked here
-           std::vector<task_base*>         task_sch_queue; // heap of tasks that have never started but are scheduled for a time in the future, ordered by the time they should be run
-           std::vector<fc::context*>       sleep_pqueue;   // heap of running tasks that have sleeped, ordered by the time they should resume
+           // tasks that have never started but are scheduled for a time in the future, ordered by the time they should be run
+           detail::timer_queue<task_base, &task_base::_timer_link> task_sch_queue;
+           // running tasks that have sleeped, ordered by the time they should resume
+           detail::timer_queue<fc::context, &fc::context::sleep_link> sleep_pqueue;
            std::vector<fc::context*>       free_list;      // list of unused contexts that are ready for deletion
 
            bool                     done;
@@ -109,6 +135,8 @@ namespace fc {
 
            std::vector<fc::context*> ready_heap; // priority heap of contexts that are ready to run
 
+           detail::thread_stats     stats;       // scheduler statistics, see thread::get_stats()
+
            fc::context*             blocked;     // linked list of contexts (using 'next_blocked') blocked on promises via wait()
 
            // values for thread specific data objects for this thread
@@ -118,6 +146,7 @@ namespace fc {
            // thread in a process)
            std::vector<detail::specific_data_info> non_task_specific_data;
            unsigned next_unused_task_storage_slot;
+           detail::fast_task_slots* non_task_fast_slots; // like non_task_specific_data, for fast_task_specific_ptr
 
            thread_idle_notifier *notifier;
 
@@ -194,6 +223,7 @@ namespace fc {
 
           fc::context::ptr ready_pop_front() 
           {
+            stats.ready_queue_depth.add(ready_heap.size());
             fc::context* highest_priority_context = ready_heap.front();
             std::pop_heap(ready_heap.begin(), ready_heap.end(), task_priority_less());
             ready_heap.pop_back();
@@ -208,39 +238,32 @@ namespace fc {
              std::push_heap(ready_heap.begin(), ready_heap.end(), task_priority_less());
            }
 
+          /** Orders by priority value, then earliest deadline, then posting order */
           struct task_priority_less 
           {
+            static bool less( const priority& a, uint64_t a_posted, const priority& b, uint64_t b_posted )
+            {
+              if( a.value != b.value )
+                return a.value < b.value;
+              if( a.deadline != b.deadline )
+                return b.deadline < a.deadline;
+              return a_posted > b_posted;
+            }
             bool operator()(const task_base* a, const task_base* b) const
             {
-              return a->_prio.value < b->_prio.value ? true : 
-                                                       (a->_prio.value > b->_prio.value ? false : 
-                                                                                          a->_posted_num > b->_posted_num);
+              return less( a->_prio, a->_posted_num, b->_prio, b->_posted_num );
             }
             bool operator()(const task_base* a, const context* b) const
             {
-              return a->_prio.value < b->prio.value ? true : 
-                                                      (a->_prio.value > b->prio.value ? false : 
-                                                                                        a->_posted_num > b->context_posted_num);
+              return less( a->_prio, a->_posted_num, b->prio, b->context_posted_num );
             }
             bool operator()(const context* a, const task_base* b) const
             {
-              return a->prio.value < b->_prio.value ? true : 
-                                                      (a->prio.value > b->_prio.value ? false : 
-                                                                                        a->context_posted_num > b->_posted_num);
+              return less( a->prio, a->context_posted_num, b->_prio, b->_posted_num );
             }
             bool operator()(const context* a, const context* b) const
             {
-              return a->prio.value < b->prio.value ? true : 
-                                                     (a->prio.value > b->prio.value ? false : 
-                                                                                      a->context_posted_num > b->context_posted_num);
-            }
-          };
-
-          struct task_when_less 
-          {
-            bool operator()( task_base* a, task_base* b ) 
-            {
-              return a->_when > b->_when;
+              return less( a->prio, a->context_posted_num, b->prio, b->context_posted_num );
             }
           };
 
@@ -263,15 +286,14 @@ namespace fc {
 
               cur = t;
               next_posted_num += num_ready_tasks;
+              stats.tasks_posted += num_ready_tasks;
+              for (task_base* c = t; c; c = c->_next)
+                c->_stack_size = detail::stack_pool::size_class(c->_stack_size);
               unsigned tasks_posted = 0;
               while (cur)
               {
                 if (cur->_when > now)
-                {
-                  task_sch_queue.push_back(cur);
-                  std::push_heap(task_sch_queue.begin(),
-                                 task_sch_queue.end(), task_when_less());
-                }
+                  task_sch_queue.push(cur, cur->_when);
                 else
                 {
                   cur->_posted_num = next_posted_num - (++tasks_posted);
@@ -292,23 +314,30 @@ namespace fc {
             // have been just been async or scheduled, but we haven't processed them.
             // move them into the task_sch_queue or task_pqueue, as appropriate
 
+            // take the canceled tasks first: a task is canceled after it has been posted, so
+            // all canceled tasks are either queued already or in pending_list
+            task_base* canceled_list = canceled_tasks.load(boost::memory_order_relaxed)
+                                       ? canceled_tasks.exchange(0, boost::memory_order_acquire) : nullptr;
+
             //DLN: changed from memory_order_consume for boost 1.55.
             //This appears to be safest replacement for now, maybe
             //can be changed to relaxed later, but needs analysis.
             task_base* pending_list = task_in_queue.exchange(0, boost::memory_order_seq_cst);
             if (pending_list)
               enqueue(pending_list);
+            if (canceled_list)
+              process_canceled_tasks(canceled_list);
 
             // second, walk through task_sch_queue and move any scheduled tasks that are now
             // able to run (because their scheduled time has arrived) to task_pqueue
 
-            while (!task_sch_queue.empty() &&
-                   task_sch_queue.front()->_when <= time_point::now())
+            if (task_sch_queue.empty())
+              return;
+            const time_point now = time_point::now();
+            while (task_base* ready_task = task_sch_queue.pop_expired(now))
             {
-              task_base* ready_task = task_sch_queue.front();
-              std::pop_heap(task_sch_queue.begin(), task_sch_queue.end(), task_when_less());
-              task_sch_queue.pop_back();
-
+              ++stats.tasks_posted;
+              ready_task->_enqueue_time = detail::read_cycle_counter(); // queue latency starts when it's due
               ready_task->_posted_num = next_posted_num++;
               task_pqueue.push_back(ready_task);
               std::push_heap(task_pqueue.begin(), task_pqueue.end(), task_priority_less());
@@ -321,34 +350,34 @@ namespace fc {
                 BOOST_ASSERT( this == thread::current().my );
 
                 assert(!task_pqueue.empty());
+                stats.task_queue_depth.add(task_pqueue.size());
                 task_base* p = task_pqueue.front();
                 std::pop_heap(task_pqueue.begin(), task_pqueue.end(), task_priority_less() );
                 task_pqueue.pop_back();
                 return p;
            }
 
-           bool process_canceled_tasks()
+           /** Removes canceled tasks that have not started from the timer queue and runs them, which
+            *  fails them. Wakes up the blocked or sleeping fibers of canceled tasks that are running.
+            */
+           void process_canceled_tasks( task_base* canceled_list )
            {
-              bool canceled_task = false;
-              for( auto task_itr = task_sch_queue.begin();
-                   task_itr != task_sch_queue.end();
-                   )
+              while (canceled_list)
               {
-                 if( (*task_itr)->canceled() )
-                 {
-                    (*task_itr)->run();
-                    (*task_itr)->release(); // HERE BE DRAGONS
-                    task_itr = task_sch_queue.erase(task_itr);
-                    canceled_task = true;
-                    continue;
-                 }
-                 ++task_itr;
+                task_base* t = canceled_list;
+                canceled_list = t->_next_canceled;
+                // a running task may catch the canceled_exception and block again, so that it
+                // has to be woken up again by the next cancel()
+                t->_cancel_notified.store(false);
+                if (task_sch_queue.remove(t))
+                {
+                  t->run();
+                  t->release(); // HERE BE DRAGONS
+                }
+                else if (t->_active_context && t->_active_context->canceled)
+                  wake_canceled_context(t->_active_context);
+                t->release(); // the reference of thread::notify_task_has_been_canceled
               }
-
-              if( canceled_task )  
-                 std::make_heap( task_sch_queue.begin(), task_sch_queue.end(), task_when_less() );
-
-              return canceled_task;
            }
            
            /**
@@ -377,8 +406,10 @@ namespace fc {
             *   Find the next available context and switch to it.
             *   If none are available then create a new context and
             *   have it wait for something to do.
+            *   With for_next_task, ready contexts are passed over and a context with a stack
+            *   for the task at the front of task_pqueue takes over, see process_tasks().
             */
-           bool start_next_fiber( bool reschedule = false ) 
+           bool start_next_fiber( bool reschedule = false, bool for_next_task = false ) 
            {
               /* If this assert fires, it means you are executing an operation that is causing
                * the current task to yield, but there is a ASSERT_TASK_NOT_PREEMPTED() in effect
@@ -407,8 +438,14 @@ namespace fc {
 
               priority original_priority = current->prio;
 
+              account_run_slice();
+              ++stats.context_switches;
+              if( current->cur_task )
+                detail::record_trace_event( reschedule ? detail::trace_event_type::yield : detail::trace_event_type::block,
+                                            current->cur_task->_trace_id, current->cur_task->get_desc() );
+
               // check to see if any other contexts are ready
-              if (!ready_heap.empty())
+              if (!for_next_task && !ready_heap.empty())
               {
                 fc::context* next = ready_pop_front();
                 if (next == current)
@@ -446,19 +483,26 @@ namespace fc {
                 // that will process posted tasks...
                 fc::context* prev = current;
 
+                // the next task to run determines the size of the stack we need
+                const size_t stack_size = task_pqueue.empty() ? 0 : task_pqueue.front()->_stack_size;
                 fc::context* next = nullptr;
-                if( pt_head ) 
-                { 
-                  // grab cached context
-                  next = pt_head;
-                  pt_head = pt_head->next;
-                  next->next = 0;
-                  next->reinitialize();
-                } 
-                else 
+                for( fc::context** cached = &pt_head; *cached; cached = &(*cached)->next )
+                {
+                  if( stack_size == 0 || (*cached)->stack_size == stack_size )
+                  {
+                    // grab cached context
+                    next = *cached;
+                    *cached = next->next;
+                    next->next = 0;
+                    next->reinitialize();
+                    break;
+                  }
+                }
+                if( !next ) 
                 { 
                   // create new context.
-                  next = new fc::context( &thread_d::start_process_tasks, stack_alloc,
+                  next = new fc::context( &thread_d::start_process_tasks,
+                                          stack_size ? stack_size : detail::stack_pool::size_class(0),
                                           &fc::thread::current() );
                 }
 
@@ -483,8 +527,15 @@ namespace fc {
                 //current = prev;
               }
 
-              if (reschedule)
-                current->prio = original_priority;
+              // resumed
+              stats.slice_start = detail::read_cycle_counter();
+              update_fast_task_slots();
+              if( current->cur_task )
+                detail::record_trace_event( detail::trace_event_type::resume, current->cur_task->_trace_id, current->cur_task->get_desc() );
+
+              // the fiber that switched to us may have given us the short sleep priority, and a
+              // context running a task must keep the priority of its task
+              current->prio = current->cur_task ? current->cur_task->_prio : original_priority;
 
               if( current->canceled ) 
               {
@@ -526,24 +577,118 @@ namespace fc {
               self->start_next_fiber( false );
            }
 
+           /** Points the fast task-specific slots of this thread at those of the current task */
+           void update_fast_task_slots()
+           {
+              detail::current_fast_task_slots() = current && current->cur_task ? &current->cur_task->_fast_task_slots
+                                                                                : &non_task_fast_slots;
+           }
+
+           /** Adds the time since the last slice start to the statistics of the current task */
+           void account_run_slice()
+           {
+              if( current->cur_task_stats )
+                current->cur_task_stats->run_slices.add( detail::read_cycle_counter() - stats.slice_start );
+           }
+
            void run_next_task() 
            {
               task_base* next = dequeue();
 
               next->_set_active_context( current );
               current->cur_task = next;
+              current->prio = next->_prio; // keeps the deadline while the task is blocked
+              update_fast_task_slots();
+              current->cur_task_stats = &stats.for_task( next->get_desc() );
+              ++current->cur_task_stats->runs;
+              ++stats.tasks_run;
+              stats.slice_start = detail::read_cycle_counter();
+              current->cur_task_stats->queue_latency.add( stats.slice_start - next->_enqueue_time );
+              const bool measure_stack = current->stack_ctx.sp && detail::stack_usage_tracking_enabled();
+              if( measure_stack && !current->stack_painted )
+              {
+                detail::paint_stack( current->stack_ctx );
+                current->stack_painted = true;
+              }
+              detail::record_trace_event( detail::trace_event_type::begin, next->_trace_id, next->get_desc() );
               next->run();
+              detail::record_trace_event( detail::trace_event_type::end, next->_trace_id, next->get_desc() );
+              if( measure_stack )
+              {
+                detail::record_stack_usage( current->stack_ctx, next->get_desc() );
+                detail::paint_stack( current->stack_ctx );
+              }
+              account_run_slice();
+              if( next->_prio.has_deadline() )
+              {
+                ++stats.deadline_tasks_run;
+                const time_point now = time_point::now();
+                if( now > next->_prio.deadline )
+                {
+                  ++stats.deadlines_missed;
+                  current->cur_task_stats->deadline_lateness.add( (now - next->_prio.deadline).count() );
+                }
+              }
+              current->prio = priority();
+              current->cur_task_stats = nullptr;
               current->cur_task = nullptr;
+              update_fast_task_slots();
               next->_set_active_context(nullptr);
               next->release(); // HERE BE DRAGONS
               current->reinitialize();
            }
 
+           /** @return true if other threads have posted or canceled tasks that have not been processed */
+           bool has_posted_work()const
+           {
+              return task_in_queue.load( boost::memory_order_relaxed ) || canceled_tasks.load( boost::memory_order_relaxed );
+           }
+
+           /** Wakes up the thread if it is waiting for task_ready */
+           void notify_if_parked()
+           {
+              boost::atomic_thread_fence( boost::memory_order_seq_cst );
+              if( parked.load( boost::memory_order_relaxed ) )
+              {
+                 boost::unique_lock<boost::mutex> lock(task_ready_mutex);
+                 task_ready.notify_one();
+              }
+           }
+
+           /** Checks for new work in a busy loop and then while yielding, as far
+            *  as the idle policy allows.
+            *  @return true if work has arrived
+            */
+           bool spin_for_work()
+           {
+              const uint32_t max_spins = spin_limit.load( boost::memory_order_relaxed );
+              const uint32_t yields = yield_limit.load( boost::memory_order_relaxed );
+              // on a single core, the poster can't run while we spin
+              static const bool single_core = boost::thread::hardware_concurrency() <= 1;
+              const uint32_t spins = single_core ? 0 : std::min( spin_budget, max_spins );
+              for( uint32_t i = 0; i < spins + yields; ++i )
+              {
+                 if( has_posted_work() || poked.exchange( false ) )
+                 {
+                    spin_budget = max_spins;
+                    ++stats.spin_wakeups;
+                    return true;
+                 }
+                 if( i < spins )
+                    detail::cpu_relax();
+                 else
+                    boost::this_thread::yield();
+              }
+              // spinning didn't pay off, spin less next time
+              spin_budget = std::max( spins / 2, max_spins / 16 );
+              return false;
+           }
+
            bool has_next_task() 
            {
              if( task_pqueue.size() ||
-                 (task_sch_queue.size() && task_sch_queue.front()->_when <= time_point::now()) ||
-                 task_in_queue.load( boost::memory_order_relaxed ) )
+                 task_sch_queue.next_expiry() <= time_point::now() ||
+                 has_posted_work() )
                return true;
              return false;
            }
@@ -581,6 +726,14 @@ namespace fc {
 
                   // if we made it here, either there's no ready context, or the ready context is
                   // scheduled after the ready task, so we should run the task first
+                  if (task_pqueue.front()->_stack_size != current->stack_size)
+                  {
+                    // the task needs a stack of a different size, let another context run it, and do
+                    // not resume a ready context of lower priority on the way
+                    pt_push_back(current);
+                    start_next_fiber(false, true);
+                    continue;
+                  }
                   run_next_task();
                   continue;
                 }
@@ -594,9 +747,6 @@ namespace fc {
                    continue;
                 }
 
-                if( process_canceled_tasks() ) 
-                  continue;
-
                 clear_free_list();
 
                 { // lock scope
@@ -609,9 +759,22 @@ namespace fc {
                     return;
 
                   detail::idle_guard guard( this );
-                  if( task_in_queue.load(boost::memory_order_relaxed) )
+                  if( has_posted_work() )
+                     continue;
+                  if( timeout_time != time_point::min() && spin_for_work() )
+                     continue;
+
+                  // pairs with the fence in notify_if_parked(): either we see the new task, or
+                  // the poster sees that we're parked
+                  parked.store( true, boost::memory_order_relaxed );
+                  boost::atomic_thread_fence( boost::memory_order_seq_cst );
+                  if( has_posted_work() || poked.exchange( false ) )
+                  {
+                     parked.store( false, boost::memory_order_relaxed );
                      continue;
+                  }
 
+                  ++stats.idle_waits;
                   if( timeout_time == time_point::maximum() ) 
                     task_ready.wait( lock );
                   else if( timeout_time != time_point::min() ) 
@@ -639,6 +802,8 @@ namespace fc {
                     task_ready.wait_until( lock, boost::chrono::steady_clock::now() + 
                                                  boost::chrono::microseconds(timeout_time.time_since_epoch().count() - time_point::now().time_since_epoch().count()) );
                   }
+                  parked.store( false, boost::memory_order_relaxed );
+                  poked.store( false, boost::memory_order_relaxed );
                 }
               }
            }
@@ -655,24 +820,16 @@ namespace fc {
           return time_point::maximum();
         }
 
-        time_point next = time_point::maximum();
-        if( !sleep_pqueue.empty() && next > sleep_pqueue.front()->resume_time )
-          next = sleep_pqueue.front()->resume_time;
-        if( !task_sch_queue.empty() && next > task_sch_queue.front()->_when )
-          next = task_sch_queue.front()->_when;
+        // the timing wheel reports a lower bound, popping from it narrows that down
+        time_point next = std::min( sleep_pqueue.next_expiry(), task_sch_queue.next_expiry() );
 
         time_point now = time_point::now();
         if( now < next )
           return next;
 
         // move all expired sleeping tasks to the ready queue
-        while( sleep_pqueue.size() && sleep_pqueue.front()->resume_time < now ) 
+        while( fc::context::ptr c = sleep_pqueue.pop_expired( now ) ) 
         {
-          fc::context::ptr c = sleep_pqueue.front();
-          std::pop_heap(sleep_pqueue.begin(), sleep_pqueue.end(), sleep_priority_less() );
-          // ilog( "sleep pop back..." );
-          sleep_pqueue.pop_back();
-
           if( c->blocking_prom.size() ) 
           {
             // ilog( "timeout blocking prom" );
@@ -716,24 +873,12 @@ namespace fc {
           current->resume_time = tp;
           current->clear_blocking_promises();
 
-          sleep_pqueue.push_back(current);
-          std::push_heap( sleep_pqueue.begin(),
-                          sleep_pqueue.end(), sleep_priority_less()   );
+          sleep_pqueue.push( current, tp );
           
           start_next_fiber(reschedule);
 
           // clear current context from sleep queue...
-          for( uint32_t i = 0; i < sleep_pqueue.size(); ++i ) 
-          {
-            if( sleep_pqueue[i] == current ) 
-            {
-              sleep_pqueue[i] = sleep_pqueue.back();
-              sleep_pqueue.pop_back();
-              std::make_heap( sleep_pqueue.begin(),
-                              sleep_pqueue.end(), sleep_priority_less() );
-              break;
-            }
-          }
+          sleep_pqueue.remove( current );
 
           current->resume_time = time_point::maximum();
           check_fiber_exceptions();
@@ -759,10 +904,7 @@ namespace fc {
           if( timeout != time_point::maximum() ) 
           {
             current->resume_time = timeout;
-            sleep_pqueue.push_back(current);
-            std::push_heap( sleep_pqueue.begin(),
-                            sleep_pqueue.end(), 
-                            sleep_priority_less()   );
+            sleep_pqueue.push( current, timeout );
           }
 
           // elog( "blocking %1%", current );
@@ -788,40 +930,36 @@ namespace fc {
           for (auto iter = thread_specific_data.begin(); iter != thread_specific_data.end(); ++iter)
             if (iter->cleanup)
               iter->cleanup(iter->value);
-        }
 
-        void notify_task_has_been_canceled()
-        {
-          for (fc::context** iter = &blocked; *iter;)
+          if (non_task_fast_slots)
           {
-            if ((*iter)->canceled)
-            {
-              fc::context* next_blocked = (*iter)->next_blocked;
-              (*iter)->next_blocked = nullptr;
-              add_context_to_ready_list(*iter);
-              *iter = next_blocked;
-              continue;
-            }
-            iter = &(*iter)->next_blocked;
+            for (unsigned i = 0; i < FC_FAST_TASK_SLOTS; ++i)
+              if (non_task_fast_slots->cleanups[i])
+                non_task_fast_slots->cleanups[i](non_task_fast_slots->values[i]);
+            delete non_task_fast_slots;
+            non_task_fast_slots = nullptr;
           }
+          detail::current_fast_task_slots() = nullptr;
+          detail::current_thread_specific_data() = nullptr;
+        }
 
-          bool task_removed_from_sleep_pqueue = false;
-          for (auto sleep_iter = sleep_pqueue.begin(); sleep_iter != sleep_pqueue.end();)
+        /** Moves the fiber of a canceled task to the ready list if it is blocked or sleeping */
+        void wake_canceled_context( fc::context* c )
+        {
+          bool woken = false;
+          for (fc::context** iter = &blocked; *iter; iter = &(*iter)->next_blocked)
           {
-            if ((*sleep_iter)->canceled)
+            if (*iter == c)
             {
-              bool already_on_ready_list = std::find(ready_heap.begin(), ready_heap.end(), 
-                                                     *sleep_iter) != ready_heap.end();
-              if (!already_on_ready_list)
-                add_context_to_ready_list(*sleep_iter);
-              sleep_iter = sleep_pqueue.erase(sleep_iter);
-              task_removed_from_sleep_pqueue = true;
+              *iter = c->next_blocked;
+              c->next_blocked = nullptr;
+              add_context_to_ready_list(c);
+              woken = true;
+              break;
             }
-            else
-              ++sleep_iter;
           }
-          if (task_removed_from_sleep_pqueue)
-            std::make_heap(sleep_pqueue.begin(), sleep_pqueue.end(), sleep_priority_less());
+          if (sleep_pqueue.remove(c) && !woken)
+            add_context_to_ready_list(c);
         }
     };
 } // namespace fc
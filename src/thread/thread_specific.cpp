@@ -27,7 +27,8 @@ namespace fc
 
     void* get_thread_specific_data(unsigned slot)
     {
-      return get_specific_data(&thread::current().my->thread_specific_data, slot);
+      current_thread_specific_data() = &thread::current().my->thread_specific_data;
+      return get_specific_data(current_thread_specific_data(), slot);
     }
     void set_thread_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*))
     {
@@ -61,5 +62,25 @@ namespace fc
         set_specific_data(current_context->cur_task->_task_specific_data, slot, new_value, cleanup);
       }
     }
+
+    fast_task_slots** init_fast_task_slots()
+    {
+      thread::current().my->update_fast_task_slots();
+      return current_fast_task_slots();
+    }
+    void set_fast_task_specific_data(unsigned slot, void* new_value, void(*cleanup)(void*))
+    {
+      fast_task_slots** slots = current_fast_task_slots();
+      if (!slots)
+        slots = init_fast_task_slots();
+      if (!*slots)
+        *slots = new fast_task_slots;
+      void* old_value = (*slots)->values[slot];
+      void (*old_cleanup)(void*) = (*slots)->cleanups[slot];
+      (*slots)->values[slot] = new_value;
+      (*slots)->cleanups[slot] = cleanup;
+      if (old_cleanup && old_value != new_value)
+        old_cleanup(old_value);
+    }
   }
 } // end namespace fc
@@ -0,0 +1,134 @@
+#include "thread_stats.hpp"
+
+#include <fc/variant.hpp>
+#include <fc/variant_object.hpp>
+
+#include <cstring>
+#include <map>
+
+namespace fc { namespace detail {
+
+   namespace {
+      struct tick_reference {
+         tick_reference()
+            : ticks( read_cycle_counter() ), time( std::chrono::steady_clock::now() ) {}
+         uint64_t                              ticks;
+         std::chrono::steady_clock::time_point time;
+      };
+      // taken at startup, so that calibration can use a long interval later on
+      const tick_reference startup_reference;
+
+      uint64_t scaled( uint64_t value, double scale )
+      {
+         const double result = value * scale;
+         return result >= double(UINT64_MAX) ? UINT64_MAX : uint64_t(result);
+      }
+   }
+
+   double nanoseconds_per_tick()
+   {
+      static const double result = [] () {
+         tick_reference now;
+         // make sure the interval is long enough for a meaningful result
+         while( now.time - startup_reference.time < std::chrono::milliseconds(10) )
+            now = tick_reference();
+         const double elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   now.time - startup_reference.time ).count();
+         return elapsed / double( now.ticks - startup_reference.ticks );
+      }();
+      return result;
+   }
+
+   void log2_histogram::reset()
+   {
+      count = 0;
+      sum = 0;
+      max = 0;
+      memset( buckets, 0, sizeof(buckets) );
+   }
+
+   void log2_histogram::merge( const log2_histogram& other )
+   {
+      count += other.count;
+      sum += other.sum;
+      max = std::max( max, other.max );
+      for( unsigned i = 0; i < 65; i++ )
+         buckets[i] += other.buckets[i];
+   }
+
+   variant log2_histogram::to_variant( double scale )const
+   {
+      variants non_empty;
+      for( unsigned i = 0; i < 65; i++ )
+         if( buckets[i] )
+         {
+            // report the upper bound of each bucket, together with its count
+            const uint64_t upper = i == 0 ? 0 : i == 64 ? UINT64_MAX : ( uint64_t(1) << i ) - 1;
+            non_empty.emplace_back( variants{ variant( scaled( upper, scale ) ), variant( buckets[i] ) } );
+         }
+      return mutable_variant_object( "count", count )
+                                   ( "mean", count ? scaled( sum / count, scale ) : 0 )
+                                   ( "max", scaled( max, scale ) )
+                                   ( "buckets", std::move(non_empty) );
+   }
+
+   void thread_stats::reset()
+   {
+      tasks_posted = 0;
+      tasks_run = 0;
+      context_switches = 0;
+      idle_waits = 0;
+      spin_wakeups = 0;
+      deadline_tasks_run = 0;
+      deadlines_missed = 0;
+      task_queue_depth.reset();
+      ready_queue_depth.reset();
+      // keep the entries, running tasks may hold pointers to them
+      for( auto& task : tasks )
+      {
+         task.second.runs = 0;
+         task.second.queue_latency.reset();
+         task.second.run_slices.reset();
+         task.second.deadline_lateness.reset();
+      }
+   }
+
+   variant thread_stats::to_variant( const std::string& thread_name )const
+   {
+      // merge entries whose descriptions are equal but stored at different addresses
+      std::map<std::string, task_stats> merged;
+      for( const auto& task : tasks )
+      {
+         if( task.second.runs == 0 )
+            continue;
+         task_stats& target = merged[ task.first ? task.first : "" ];
+         target.runs += task.second.runs;
+         target.queue_latency.merge( task.second.queue_latency );
+         target.run_slices.merge( task.second.run_slices );
+         target.deadline_lateness.merge( task.second.deadline_lateness );
+      }
+
+      const double ns = nanoseconds_per_tick();
+      variants task_list;
+      task_list.reserve( merged.size() );
+      for( const auto& task : merged )
+         task_list.emplace_back( mutable_variant_object( "desc", task.first )
+                                                       ( "runs", task.second.runs )
+                                                       ( "queue_latency_ns", task.second.queue_latency.to_variant( ns ) )
+                                                       ( "run_slice_ns", task.second.run_slices.to_variant( ns ) )
+                                                       ( "deadline_lateness_us", task.second.deadline_lateness.to_variant( 1 ) ) );
+
+      return mutable_variant_object( "name", thread_name )
+                                   ( "tasks_posted", tasks_posted )
+                                   ( "tasks_run", tasks_run )
+                                   ( "context_switches", context_switches )
+                                   ( "idle_waits", idle_waits )
+                                   ( "spin_wakeups", spin_wakeups )
+                                   ( "deadline_tasks_run", deadline_tasks_run )
+                                   ( "deadlines_missed", deadlines_missed )
+                                   ( "task_queue_depth", task_queue_depth.to_variant( 1 ) )
+                                   ( "ready_queue_depth", ready_queue_depth.to_variant( 1 ) )
+                                   ( "tasks", std::move(task_list) );
+   }
+
+} } // fc::detail
@@ -0,0 +1,109 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+namespace fc {
+   class variant;
+
+namespace detail {
+
+   /** @return a cheap, monotonic timestamp, see nanoseconds_per_tick() */
+   inline uint64_t read_cycle_counter()
+   {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+      return __rdtsc();
+#else
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+   }
+
+   /** @return the duration of one read_cycle_counter() tick, in nanoseconds */
+   double nanoseconds_per_tick();
+
+   /** Histogram with power-of-two buckets. Bucket 0 counts zeroes, bucket i > 0
+    *  counts values in [2^(i-1), 2^i).
+    */
+   struct log2_histogram
+   {
+      log2_histogram() { reset(); }
+
+      void add( uint64_t value )
+      {
+         ++count;
+         sum += value;
+         if( value > max )
+            max = value;
+         ++buckets[ value ? 64 - count_leading_zeroes( value ) : 0 ];
+      }
+
+      void reset();
+      void merge( const log2_histogram& other );
+
+      /** @param scale factor for converting values into the reported unit */
+      variant to_variant( double scale )const;
+
+      uint64_t count;
+      uint64_t sum;
+      uint64_t max;
+      uint64_t buckets[65];
+
+   private:
+      static unsigned count_leading_zeroes( uint64_t value )
+      {
+#ifdef _MSC_VER
+         unsigned long index;
+         _BitScanReverse64( &index, value );
+         return 63 - index;
+#else
+         return __builtin_clzll( value );
+#endif
+      }
+   };
+
+   /** Statistics for all tasks with the same description */
+   struct task_stats
+   {
+      task_stats() : runs(0) {}
+
+      uint64_t       runs;
+      log2_histogram queue_latency; // ticks from posting (or becoming due) until first run
+      log2_histogram run_slices;    // ticks a task ran before it completed or yielded
+      log2_histogram deadline_lateness; // microseconds tasks completed after their deadline
+   };
+
+   /** Scheduler statistics of a thread. Only ever accessed by the thread itself. */
+   struct thread_stats
+   {
+      thread_stats() : tasks_posted(0), tasks_run(0), context_switches(0), idle_waits(0), spin_wakeups(0),
+                       deadline_tasks_run(0), deadlines_missed(0), slice_start(0) {}
+
+      task_stats& for_task( const char* desc ) { return tasks[desc]; }
+
+      void    reset();
+      variant to_variant( const std::string& thread_name )const;
+
+      uint64_t       tasks_posted;
+      uint64_t       tasks_run;
+      uint64_t       context_switches;
+      uint64_t       idle_waits;
+      uint64_t       spin_wakeups;
+      uint64_t       deadline_tasks_run; // tasks with a deadline that have completed
+      uint64_t       deadlines_missed;   // those of them that completed after their deadline
+      log2_histogram task_queue_depth;  // sampled whenever a new task is started
+      log2_histogram ready_queue_depth; // sampled whenever a ready context is resumed
+
+      uint64_t       slice_start;       // start of the current run slice
+      // keyed by the description pointer, tasks with equal descriptions are merged in to_variant
+      std::unordered_map<const char*, task_stats> tasks;
+   };
+
+} } // fc::detail
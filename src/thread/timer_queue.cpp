@@ -0,0 +1,325 @@
+#include "timer_queue.hpp"
+
+#include <cstring>
+
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
+namespace fc { namespace detail {
+
+   namespace {
+      const unsigned WHEEL_LEVELS    = 8;
+      const unsigned WHEEL_SLOT_BITS = 8;
+      const unsigned WHEEL_SLOTS     = 1 << WHEEL_SLOT_BITS;
+      const unsigned WHEEL_WORDS     = WHEEL_SLOTS / 64;
+
+      uint64_t to_ticks( const time_point& t )
+      {
+         const int64_t us = t.time_since_epoch().count();
+         return us < 0 ? 0 : uint64_t(us);
+      }
+
+      time_point from_ticks( uint64_t t )
+      {
+         if( t >= uint64_t(time_point::maximum().time_since_epoch().count()) )
+            return time_point::maximum();
+         return time_point( microseconds( int64_t(t) ) );
+      }
+
+      unsigned lowest_bit( uint64_t v )
+      {
+#ifdef _MSC_VER
+         unsigned long index;
+         _BitScanForward64( &index, v );
+         return index;
+#else
+         return __builtin_ctzll( v );
+#endif
+      }
+
+      unsigned highest_bit( uint64_t v )
+      {
+#ifdef _MSC_VER
+         unsigned long index;
+         _BitScanReverse64( &index, v );
+         return index;
+#else
+         return 63 - __builtin_clzll( v );
+#endif
+      }
+
+      bool expires_before( const timer_link* a, const timer_link* b )
+      {
+         return a->expires < b->expires;
+      }
+   }
+
+   struct timer_queue_base::wheel
+   {
+      wheel() : current( to_ticks( time_point::now() ) ), expired( nullptr ), used_levels( 0 )
+      {
+         memset( used_slots, 0, sizeof(used_slots) );
+         memset( slots, 0, sizeof(slots) );
+      }
+
+      uint64_t    current;      // all links that expire up to this time are in the expired list
+      timer_link* expired;
+      uint32_t    used_levels;  // bit i is set if level i has a non-empty slot
+      uint64_t    used_slots[WHEEL_LEVELS][WHEEL_WORDS];
+      timer_link* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+   };
+
+   timer_queue_base::timer_queue_base( timer_backend backend ) : count(0)
+   {
+      if( backend == timer_backend::timing_wheel )
+         my_wheel.reset( new wheel() );
+   }
+
+   timer_queue_base::~timer_queue_base() {}
+
+   void timer_queue_base::push( timer_link* link, const time_point& when )
+   {
+      link->expires = to_ticks( when );
+      if( my_wheel )
+      {
+         // an empty wheel can jump to the current time, which keeps new links in low levels
+         if( count == 0 )
+            my_wheel->current = to_ticks( time_point::now() );
+         ++count;
+         wheel_insert( link );
+         return;
+      }
+      ++count;
+      heap.push_back( link );
+      link->heap_index = heap.size();
+      heap_sift_up( heap.size() - 1 );
+   }
+
+   bool timer_queue_base::remove( timer_link* link )
+   {
+      if( my_wheel )
+      {
+         if( !link->pprev )
+            return false;
+         wheel_unlink( link );
+      }
+      else
+      {
+         if( !link->heap_index )
+            return false;
+         heap_remove( link->heap_index - 1 );
+      }
+      --count;
+      return true;
+   }
+
+   time_point timer_queue_base::next_expiry()const
+   {
+      if( my_wheel )
+      {
+         if( my_wheel->expired )
+            return from_ticks( my_wheel->current );
+         unsigned level, slot;
+         uint64_t start;
+         if( !wheel_first_slot( level, slot, start ) )
+            return time_point::maximum();
+         return from_ticks( start );
+      }
+      if( heap.empty() )
+         return time_point::maximum();
+      return from_ticks( heap.front()->expires );
+   }
+
+   timer_link* timer_queue_base::pop_expired( const time_point& now )
+   {
+      if( my_wheel )
+      {
+         if( !my_wheel->expired )
+            wheel_advance( to_ticks( now ) );
+         timer_link* link = my_wheel->expired;
+         if( !link )
+            return nullptr;
+         wheel_unlink( link );
+         --count;
+         return link;
+      }
+      if( heap.empty() || heap.front()->expires > to_ticks( now ) )
+         return nullptr;
+      timer_link* link = heap.front();
+      heap_remove( 0 );
+      --count;
+      return link;
+   }
+
+   timer_link* timer_queue_base::pop_any()
+   {
+      if( count == 0 )
+         return nullptr;
+      timer_link* link;
+      if( my_wheel )
+      {
+         link = my_wheel->expired;
+         if( !link )
+         {
+            unsigned level, slot;
+            uint64_t start;
+            wheel_first_slot( level, slot, start );
+            link = my_wheel->slots[level][slot];
+         }
+         wheel_unlink( link );
+      }
+      else
+      {
+         link = heap.back();
+         heap_remove( heap.size() - 1 );
+      }
+      --count;
+      return link;
+   }
+
+   void timer_queue_base::heap_sift_up( size_t pos )
+   {
+      timer_link* link = heap[pos];
+      while( pos > 0 )
+      {
+         const size_t parent = ( pos - 1 ) / 2;
+         if( !expires_before( link, heap[parent] ) )
+            break;
+         heap[pos] = heap[parent];
+         heap[pos]->heap_index = pos + 1;
+         pos = parent;
+      }
+      heap[pos] = link;
+      link->heap_index = pos + 1;
+   }
+
+   void timer_queue_base::heap_sift_down( size_t pos )
+   {
+      timer_link* link = heap[pos];
+      const size_t size = heap.size();
+      while( true )
+      {
+         size_t child = 2 * pos + 1;
+         if( child >= size )
+            break;
+         if( child + 1 < size && expires_before( heap[child + 1], heap[child] ) )
+            ++child;
+         if( !expires_before( heap[child], link ) )
+            break;
+         heap[pos] = heap[child];
+         heap[pos]->heap_index = pos + 1;
+         pos = child;
+      }
+      heap[pos] = link;
+      link->heap_index = pos + 1;
+   }
+
+   void timer_queue_base::heap_remove( size_t pos )
+   {
+      heap[pos]->heap_index = 0;
+      timer_link* last = heap.back();
+      heap.pop_back();
+      if( pos == heap.size() )
+         return;
+      heap[pos] = last;
+      last->heap_index = pos + 1;
+      heap_sift_down( pos );
+      heap_sift_up( last->heap_index - 1 );
+   }
+
+   void timer_queue_base::wheel_insert( timer_link* link )
+   {
+      wheel& w = *my_wheel;
+      timer_link** head;
+      if( link->expires <= w.current )
+         head = &w.expired;
+      else
+      {
+         // the level is determined by the most significant byte in which expiry and current time differ
+         const unsigned level = highest_bit( link->expires ^ w.current ) / WHEEL_SLOT_BITS;
+         const unsigned slot = ( link->expires >> ( level * WHEEL_SLOT_BITS ) ) & ( WHEEL_SLOTS - 1 );
+         head = &w.slots[level][slot];
+         w.used_slots[level][slot / 64] |= uint64_t(1) << ( slot % 64 );
+         w.used_levels |= 1u << level;
+      }
+      link->next = *head;
+      if( link->next )
+         link->next->pprev = &link->next;
+      link->pprev = head;
+      *head = link;
+   }
+
+   void timer_queue_base::wheel_unlink( timer_link* link )
+   {
+      wheel& w = *my_wheel;
+      timer_link** head = link->pprev;
+      *head = link->next;
+      if( link->next )
+         link->next->pprev = head;
+      link->next = nullptr;
+      link->pprev = nullptr;
+
+      // if the slot became empty, clear its bit
+      if( *head || head < &w.slots[0][0] || head > &w.slots[WHEEL_LEVELS - 1][WHEEL_SLOTS - 1] )
+         return;
+      const size_t index = head - &w.slots[0][0];
+      const unsigned level = index / WHEEL_SLOTS;
+      const unsigned slot = index % WHEEL_SLOTS;
+      w.used_slots[level][slot / 64] &= ~( uint64_t(1) << ( slot % 64 ) );
+      for( unsigned word = 0; word < WHEEL_WORDS; word++ )
+         if( w.used_slots[level][word] )
+            return;
+      w.used_levels &= ~( 1u << level );
+   }
+
+   bool timer_queue_base::wheel_first_slot( unsigned& level, unsigned& slot, uint64_t& start )const
+   {
+      const wheel& w = *my_wheel;
+      if( !w.used_levels )
+         return false;
+      // all links in lower levels expire before those in higher levels, and
+      // within a level all occupied slots lie ahead of the current time
+      level = lowest_bit( w.used_levels );
+      unsigned word = 0;
+      while( !w.used_slots[level][word] )
+         ++word;
+      slot = word * 64 + lowest_bit( w.used_slots[level][word] );
+      const unsigned shift = ( level + 1 ) * WHEEL_SLOT_BITS;
+      const uint64_t upper = shift < 64 ? ( w.current >> shift ) << shift : 0;
+      start = upper | ( uint64_t(slot) << ( level * WHEEL_SLOT_BITS ) );
+      return true;
+   }
+
+   void timer_queue_base::wheel_advance( uint64_t target )
+   {
+      wheel& w = *my_wheel;
+      unsigned level, slot;
+      uint64_t start;
+      while( !w.expired && wheel_first_slot( level, slot, start ) && start <= target )
+      {
+         // move time forward to the start of the slot and redistribute its links
+         // to lower levels, or to the expired list
+         w.current = start;
+         timer_link* link = w.slots[level][slot];
+         w.slots[level][slot] = nullptr;
+         w.used_slots[level][slot / 64] &= ~( uint64_t(1) << ( slot % 64 ) );
+         bool level_used = false;
+         for( unsigned word = 0; word < WHEEL_WORDS; word++ )
+            level_used |= w.used_slots[level][word] != 0;
+         if( !level_used )
+            w.used_levels &= ~( 1u << level );
+         while( link )
+         {
+            timer_link* next = link->next;
+            wheel_insert( link );
+            link = next;
+         }
+      }
+      // Jumping ahead is safe as long as the next occupied slot lies beyond the target,
+      // because no link changes its level or slot then.
+      if( !w.expired && target > w.current )
+         w.current = target;
+   }
+
+} } // fc::detail
@@ -0,0 +1,92 @@
+#pragma once
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace fc { namespace detail {
+
+   /**
+    *  Keeps track of objects that must be processed at a certain time, i. e. the
+    *  scheduled tasks and the sleeping contexts of a thread. Objects are linked
+    *  into the queue through an embedded timer_link, so queueing them never
+    *  allocates (except for growing the heap).
+    *
+    *  The binary heap keeps the position of each link, so removal takes
+    *  O(log n) without searching. The timing wheel consists of 8 levels of 256
+    *  slots each, where level i holds links whose expiration time differs from
+    *  the wheel's current time in byte i at most. Links cascade to lower levels
+    *  as time advances, and bitmaps of occupied slots are used to skip over
+    *  empty ones.
+    */
+   class timer_queue_base {
+   public:
+      explicit timer_queue_base( timer_backend backend );
+      ~timer_queue_base();
+
+      bool   empty()const { return count == 0; }
+      size_t size()const  { return count; }
+
+      /** @return a lower bound for the expiration time of the earliest queued link,
+       *          or time_point::maximum() if the queue is empty
+       */
+      time_point next_expiry()const;
+
+   protected:
+      void        push( timer_link* link, const time_point& when );
+      bool        remove( timer_link* link );
+      timer_link* pop_expired( const time_point& now );
+      timer_link* pop_any();
+
+   private:
+      struct wheel;
+
+      void heap_sift_up( size_t pos );
+      void heap_sift_down( size_t pos );
+      void heap_remove( size_t pos );
+
+      void wheel_insert( timer_link* link );
+      void wheel_unlink( timer_link* link );
+      bool wheel_first_slot( unsigned& level, unsigned& slot, uint64_t& start )const;
+      void wheel_advance( uint64_t target );
+
+      size_t                   count;
+      std::vector<timer_link*> heap;
+      std::unique_ptr<wheel>   my_wheel;
+   };
+
+   /** Type-safe wrapper for timer_queue_base, for objects of type T containing
+    *  the timer_link pointed to by Link.
+    */
+   template<typename T, timer_link T::*Link>
+   class timer_queue : public timer_queue_base {
+   public:
+      explicit timer_queue( timer_backend backend ) : timer_queue_base( backend ) {}
+
+      /** Adds the given object, to expire at the given time. If it is queued already it is moved. */
+      void push( T* t, const time_point& when )
+      {
+         timer_queue_base::remove( &(t->*Link) );
+         (t->*Link).owner = t;
+         timer_queue_base::push( &(t->*Link), when );
+      }
+
+      /** Removes the given object if it is queued.
+       *  @return true if the object was queued
+       */
+      bool remove( T* t ) { return timer_queue_base::remove( &(t->*Link) ); }
+
+      /** Removes and returns one object that has expired at the given time.
+       *  @return the object, or nullptr if nothing has expired
+       */
+      T* pop_expired( const time_point& now ) { return owner( timer_queue_base::pop_expired( now ) ); }
+
+      /** Removes and returns any object, or nullptr if the queue is empty */
+      T* pop_any() { return owner( timer_queue_base::pop_any() ); }
+
+   private:
+      static T* owner( timer_link* link ) { return link ? static_cast<T*>( link->owner ) : nullptr; }
+   };
+
+} } // fc::detail
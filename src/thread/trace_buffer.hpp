@@ -0,0 +1,39 @@
+#pragma once
+#include <boost/atomic.hpp>
+
+#include <cstdint>
+
+namespace fc { namespace detail {
+
+   enum class trace_event_type : uint8_t {
+      post,    // a task was handed to a thread
+      begin,   // a task starts running
+      resume,  // a blocked or yielded task continues to run
+      end,     // a task has completed
+      block,   // a running task waits for something
+      yield,   // a running task lets others run
+      unblock  // a blocked task has become ready
+   };
+
+   extern boost::atomic<bool>     fiber_tracing_active;
+   extern boost::atomic<uint64_t> last_trace_id;
+
+   void record_trace_event_slow( trace_event_type type, uint64_t task_id, const char* name );
+
+   /** @return an id for a task that is being posted, or 0 if tracing is disabled. Tasks are not
+    *  identified by their address, because the task pool reuses it. */
+   inline uint64_t new_trace_id()
+   {
+      if( !fiber_tracing_active.load( boost::memory_order_relaxed ) )
+         return 0;
+      return last_trace_id.fetch_add( 1, boost::memory_order_relaxed ) + 1;
+   }
+
+   /** Records an event in the calling thread's trace buffer, if tracing is enabled */
+   inline void record_trace_event( trace_event_type type, uint64_t task_id, const char* name )
+   {
+      if( fiber_tracing_active.load( boost::memory_order_relaxed ) )
+         record_trace_event_slow( type, task_id, name );
+   }
+
+} } // fc::detail
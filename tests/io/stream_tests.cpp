@@ -2,6 +2,7 @@
 
 #include <fc/filesystem.hpp>
 #include <fc/exception/exception.hpp>
+#include <fc/io/async_file.hpp>
 #include <fc/io/buffered_iostream.hpp>
 #include <fc/io/fstream.hpp>
 #include <fc/io/sstream.hpp>
@@ -175,4 +176,57 @@ BOOST_AUTO_TEST_CASE(buffered_fstream_test)
    }
 }
 
+BOOST_AUTO_TEST_CASE(async_file_test)
+{
+   fc::temp_file tmp( fc::temp_directory_path(), true );
+
+   // once through io_uring if the kernel permits it, once through the thread pool
+   for( bool use_uring : { true, false } )
+   {
+      fc::async_file::enable_io_uring( use_uring );
+      BOOST_CHECK( use_uring || !fc::async_file::uses_io_uring() );
+
+      fc::async_file file( tmp.path(), fc::async_file::read | fc::async_file::write
+                                       | fc::async_file::create | fc::async_file::truncate );
+      BOOST_REQUIRE( file.is_open() );
+
+      std::string data( 100000, ' ' );
+      for( size_t i = 0; i < data.size(); i++ )
+         data[i] = char( 'a' + i % 26 );
+      // concurrent writes of both halves
+      fc::future<size_t> second = file.pwrite( data.data() + 50000, 50000, 50000 );
+      fc::future<size_t> first = file.pwrite( data.data(), 50000, 0 );
+      BOOST_CHECK_EQUAL( 50000u, first.wait() );
+      BOOST_CHECK_EQUAL( 50000u, second.wait() );
+      file.fsync().wait();
+      BOOST_CHECK_EQUAL( data.size(), file.size() );
+
+      std::string buf( 10, ' ' );
+      BOOST_CHECK_EQUAL( 10u, file.pread( &buf[0], 10, 26 ).wait() );
+      BOOST_CHECK_EQUAL( "abcdefghij", buf );
+      // short read at the end of the file
+      BOOST_CHECK_EQUAL( 5u, file.pread( &buf[0], 10, data.size() - 5 ).wait() );
+      BOOST_CHECK_EQUAL( 0u, file.pread( &buf[0], 10, data.size() ).wait() );
+      BOOST_CHECK_EQUAL( 0u, file.pread( &buf[0], 0, 0 ).wait() );
+
+      // pending operations keep the file open
+      std::string all( data.size(), ' ' );
+      fc::future<size_t> read_all = file.pread( &all[0], all.size(), 0 );
+      file.close();
+      BOOST_CHECK( !file.is_open() );
+      BOOST_CHECK_EQUAL( data.size(), read_all.wait() );
+      BOOST_CHECK( data == all );
+
+      BOOST_CHECK( data == fc::async_read_file( tmp.path() ).wait() );
+   }
+   fc::async_file::enable_io_uring( true );
+
+   fc::async_file read_only( tmp.path() );
+   char c = 'x';
+   BOOST_CHECK_THROW( read_only.pwrite( &c, 1, 0 ).wait(), fc::exception );
+   const fc::path missing( tmp.path().string() + ".missing" );
+   BOOST_CHECK_THROW( fc::async_file( missing, fc::async_file::read ), fc::file_not_found_exception );
+   BOOST_CHECK_THROW( fc::async_read_file( missing ).wait(), fc::file_not_found_exception );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,12 @@
 
 #include <fc/network/tcp_socket.hpp>
 #include <fc/asio.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/time.hpp>
+
+#include <memory>
+#include <vector>
 
 namespace fc { namespace test {
 
@@ -11,6 +17,77 @@ public:
    static void reset_num_threads() { fc::asio::default_io_service_scope::num_io_threads = 0; }
 };
 
+/** Runs echo connections on the given io services, returns the number of bytes echoed */
+static uint64_t run_echo_benchmark( fc::asio::default_io_service_scope& scope, size_t connections,
+                                    size_t message_size, size_t rounds )
+{
+   using boost::asio::ip::tcp;
+   fc::thread server_thread( "echo server" );
+   fc::thread client_thread( "echo client" );
+
+   tcp::acceptor acceptor( scope.next_shard(), tcp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) );
+   const tcp::endpoint endpoint = acceptor.local_endpoint();
+
+   std::vector<std::unique_ptr<tcp::socket>> server_sockets;
+   std::vector<std::unique_ptr<tcp::socket>> client_sockets;
+   std::vector<fc::future<void>> echoes;
+   for( size_t i = 0; i < connections; i++ )
+   {
+      server_sockets.emplace_back( new tcp::socket( scope.next_shard() ) );
+      client_sockets.emplace_back( new tcp::socket( scope.next_shard() ) );
+      tcp::socket& server = *server_sockets.back();
+      tcp::socket& client = *client_sockets.back();
+      fc::future<void> accepted = server_thread.async( [&acceptor,&server] {
+         fc::asio::tcp::accept( acceptor, server );
+      } );
+      client_thread.async( [&client,&endpoint] { fc::asio::tcp::connect( client, endpoint ); } ).wait();
+      accepted.wait();
+      client.set_option( tcp::no_delay( true ) );
+      server.set_option( tcp::no_delay( true ) );
+
+      echoes.push_back( server_thread.async( [&server,message_size] {
+         std::vector<char> buffer( message_size );
+         try
+         {
+            for(;;)
+            {
+               const size_t n = fc::asio::read_some( server, boost::asio::buffer( buffer ) ).wait();
+               fc::asio::write( server, boost::asio::buffer( buffer.data(), n ) );
+            }
+         }
+         catch( const fc::eof_exception& ) {}
+      } ) );
+   }
+
+   const fc::time_point start = fc::time_point::now();
+   std::vector<fc::future<void>> clients;
+   for( auto& socket : client_sockets )
+   {
+      tcp::socket& client = *socket;
+      clients.push_back( client_thread.async( [&client,message_size,rounds] {
+         std::vector<char> out( message_size, 'x' );
+         std::vector<char> in( message_size );
+         for( size_t r = 0; r < rounds; r++ )
+         {
+            fc::asio::write( client, boost::asio::buffer( out ) );
+            fc::asio::read( client, boost::asio::buffer( in ) );
+         }
+         client.shutdown( tcp::socket::shutdown_send );
+      } ) );
+   }
+   for( auto& client : clients )
+      client.wait();
+   const fc::microseconds elapsed = fc::time_point::now() - start;
+   for( auto& echo : echoes )
+      echo.wait();
+
+   const uint64_t bytes = uint64_t(connections) * message_size * rounds;
+   ilog( "${m} mode: ${b} bytes echoed over ${c} connections in ${t}us, ${r} MB/s",
+         ("m",scope.shard_count() > 1 ? "sharded" : "shared")("b",bytes)("c",connections)("t",elapsed.count())
+         ("r",elapsed.count() > 0 ? bytes / elapsed.count() : 0) );
+   return bytes;
+}
+
 }} // fc::test
 
 BOOST_AUTO_TEST_SUITE(tcp_tests)
@@ -55,4 +132,50 @@ BOOST_AUTO_TEST_CASE( default_number_threads_test )
    BOOST_CHECK( my_class.get_num_threads() > 1 );
 }
 
+BOOST_AUTO_TEST_CASE( sharded_io_service_test )
+{
+   fc::asio::default_io_service_scope scope( 4, true );
+   BOOST_CHECK_EQUAL( 4u, scope.shard_count() );
+   BOOST_CHECK_EQUAL( scope.io, &scope.shard_for( 0 ) );
+   BOOST_CHECK_EQUAL( &scope.shard_for( 5 ), &scope.shard_for( 1 ) );
+   BOOST_CHECK( &scope.shard_for( 1 ) != &scope.shard_for( 2 ) );
+
+   boost::asio::io_service* first = &scope.next_shard();
+   for( int i = 1; i < 4; i++ )
+      BOOST_CHECK( &scope.next_shard() != first );
+   BOOST_CHECK_EQUAL( first, &scope.next_shard() );
+
+   // handlers of a shard always run in the same thread
+   fc::promise<boost::thread::id>::ptr ran_in = fc::promise<boost::thread::id>::create( "shard thread" );
+   scope.shard_for( 2 ).post( [ran_in] { ran_in->set_value( boost::this_thread::get_id() ); } );
+   const boost::thread::id shard_thread = ran_in->wait();
+   for( int i = 0; i < 10; i++ )
+   {
+      fc::promise<boost::thread::id>::ptr p = fc::promise<boost::thread::id>::create( "shard thread" );
+      scope.shard_for( 2 ).post( [p] { p->set_value( boost::this_thread::get_id() ); } );
+      BOOST_CHECK( shard_thread == p->wait() );
+   }
+
+   fc::asio::default_io_service_scope shared( 4, false );
+   BOOST_CHECK_EQUAL( 1u, shared.shard_count() );
+   BOOST_CHECK_EQUAL( shared.io, &shared.next_shard() );
+
+   // a socket and the timers that go with it get the same service, in any mode
+   boost::asio::io_service* service = &fc::asio::default_io_service();
+   for( int i = 0; i < 4; i++ )
+   {
+      BOOST_CHECK_EQUAL( service, &fc::asio::default_io_service() );
+      fc::asio::next_default_io_service_shard();
+   }
+}
+
+BOOST_AUTO_TEST_CASE( echo_benchmark )
+{
+   for( bool sharded : { false, true } )
+   {
+      fc::asio::default_io_service_scope scope( 4, sharded );
+      BOOST_CHECK_EQUAL( 4u * 16 * 1024 * 2000, fc::test::run_echo_benchmark( scope, 4, 16 * 1024, 2000 ) );
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
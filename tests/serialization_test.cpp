@@ -2,7 +2,47 @@
 #include <fc/log/logger.hpp>
 
 #include <fc/container/flat.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/io/raw_fwd.hpp>
+
+namespace fc { namespace test {
+
+   /** Reflected with a 32 bit field, but packed with 64 bits */
+   struct wide_counter
+   {
+      uint32_t value;
+   };
+
+   struct counted_record
+   {
+      wide_counter count;
+      uint16_t     flags;
+   };
+
+   /** Reflected with 8 bits, packed with one byte below 128 and with two bytes above */
+   struct varying_tag
+   {
+      uint8_t value;
+   };
+
+   struct tagged_record
+   {
+      uint32_t    id;
+      varying_tag tag;
+   };
+
+} } // namespace fc::test
+
+namespace fc { namespace raw {
+   template<typename Stream> void pack( Stream& s, const fc::test::wide_counter& c, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+   template<typename Stream> void unpack( Stream& s, fc::test::wide_counter& c, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+   template<typename Stream> void pack( Stream& s, const fc::test::varying_tag& t, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+   template<typename Stream> void unpack( Stream& s, fc::test::varying_tag& t, uint32_t _max_depth=FC_PACK_MAX_DEPTH );
+} } // namespace fc::raw
+
 #include <fc/io/raw.hpp>
+#include <fc/io/raw_view.hpp>
+#include <fc/static_variant.hpp>
 
 namespace fc { namespace test {
 
@@ -35,10 +75,166 @@ namespace fc { namespace test {
    inline bool operator < ( const item& a, const item& b )
    { return ( std::tie( a.level, a.w ) < std::tie( b.level, b.w ) ); }
 
+   struct flat_item
+   {
+      uint64_t id;
+      int32_t  amount;
+      uint16_t flags;
+      std::array<char,2> tag;
+   };
+
+   inline bool operator == ( const flat_item& a, const flat_item& b )
+   { return ( std::tie( a.id, a.amount, a.flags, a.tag ) == std::tie( b.id, b.amount, b.flags, b.tag ) ); }
+
+   /** Same layout as flat_item, but reflected in a different order */
+   struct reordered_item
+   {
+      uint64_t id;
+      int32_t  amount;
+      uint16_t flags;
+      std::array<char,2> tag;
+   };
+
+   inline bool operator == ( const reordered_item& a, const reordered_item& b )
+   { return ( std::tie( a.id, a.amount, a.flags, a.tag ) == std::tie( b.id, b.amount, b.flags, b.tag ) ); }
+
+   struct padded_item
+   {
+      uint64_t id;
+      uint16_t flags;
+   };
+
 } } // namespace fc::test
 
 FC_REFLECT( fc::test::item_wrapper, (v) );
 FC_REFLECT( fc::test::item, (level)(w) );
+FC_REFLECT( fc::test::flat_item, (id)(amount)(flags)(tag) );
+FC_REFLECT( fc::test::reordered_item, (amount)(id)(flags)(tag) );
+FC_REFLECT( fc::test::padded_item, (id)(flags) );
+
+namespace fc { namespace test {
+
+   struct document
+   {
+      std::string                  name;
+      std::vector<char>            payload;
+      std::vector<uint64_t>        ids;
+      std::vector<reordered_item>  items;
+      flat_item                    header;
+      uint32_t                     checksum;
+   };
+
+   /** Unpacks from a packed document without copying */
+   struct document_view
+   {
+      fc::raw::string_view_t                  name;
+      fc::raw::blob_view                      payload;
+      fc::raw::packed_span<uint64_t>          ids;
+      fc::raw::packed_span<reordered_item>    items;
+      fc::raw::packed_ref<flat_item>          header;
+      uint32_t                                checksum;
+   };
+
+} } // namespace fc::test
+
+FC_REFLECT( fc::test::document, (name)(payload)(ids)(items)(header)(checksum) );
+
+namespace fc { namespace test {
+
+   enum record_kind { plain_record, special_record };
+
+   /** Has a fixed packed size, but is not trivially packable */
+   struct fixed_record
+   {
+      fc::sha256         id;
+      fc::time_point_sec time;
+      padded_item        padded;
+      bool               flag;
+      record_kind        kind;
+   };
+
+   inline bool operator == ( const fixed_record& a, const fixed_record& b )
+   {
+      return std::tie( a.id, a.time, a.padded.id, a.padded.flags, a.flag, a.kind )
+             == std::tie( b.id, b.time, b.padded.id, b.padded.flags, b.flag, b.kind );
+   }
+
+} } // namespace fc::test
+
+FC_REFLECT_ENUM( fc::test::record_kind, (plain_record)(special_record) );
+FC_REFLECT( fc::test::fixed_record, (id)(time)(padded)(flag)(kind) );
+FC_REFLECT( fc::test::document_view, (name)(payload)(ids)(items)(header)(checksum) );
+FC_REFLECT( fc::test::wide_counter, (value) );
+FC_REFLECT( fc::test::counted_record, (count)(flags) );
+FC_REFLECT( fc::test::varying_tag, (value) );
+FC_REFLECT( fc::test::tagged_record, (id)(tag) );
+
+namespace fc { namespace raw {
+   template<typename Stream>
+   void pack( Stream& s, const fc::test::wide_counter& c, uint32_t _max_depth )
+   {
+      fc::raw::pack( s, uint64_t( c.value ), _max_depth );
+   }
+   template<typename Stream>
+   void unpack( Stream& s, fc::test::wide_counter& c, uint32_t _max_depth )
+   {
+      uint64_t value;
+      fc::raw::unpack( s, value, _max_depth );
+      c.value = static_cast<uint32_t>( value );
+   }
+   template<typename Stream>
+   void pack( Stream& s, const fc::test::varying_tag& t, uint32_t _max_depth )
+   {
+      if( t.value < 0x80 )
+         return fc::raw::pack( s, t.value, _max_depth );
+      fc::raw::pack( s, uint8_t( 0x80 | ( t.value & 0x7f ) ), _max_depth );
+      fc::raw::pack( s, uint8_t( t.value >> 7 ), _max_depth );
+   }
+   template<typename Stream>
+   void unpack( Stream& s, fc::test::varying_tag& t, uint32_t _max_depth )
+   {
+      fc::raw::unpack( s, t.value, _max_depth );
+      if( t.value < 0x80 )
+         return;
+      uint8_t high;
+      fc::raw::unpack( s, high, _max_depth );
+      t.value = uint8_t( ( t.value & 0x7f ) | ( high << 7 ) );
+   }
+} } // namespace fc::raw
+
+namespace {
+   /** Packs a vector one element at a time, like fc::raw did before the bulk path */
+   template<typename T>
+   std::vector<char> pack_elementwise( const std::vector<T>& v )
+   {
+      std::vector<char> result( fc::raw::pack_size( v ) );
+      fc::datastream<char*> ds( result.data(), result.size() );
+      fc::raw::pack( ds, fc::unsigned_int( v.size() ) );
+      for( const auto& e : v )
+         fc::raw::pack( ds, e );
+      BOOST_CHECK_EQUAL( result.size(), ds.tellp() );
+      return result;
+   }
+
+   template<typename T>
+   void unpack_elementwise( const std::vector<char>& packed, std::vector<T>& v )
+   {
+      fc::datastream<const char*> ds( packed.data(), packed.size() );
+      fc::unsigned_int size;
+      fc::raw::unpack( ds, size );
+      v.resize( size.value );
+      for( auto& e : v )
+         fc::raw::unpack( ds, e );
+   }
+
+   template<typename T>
+   void check_vector_roundtrip( const std::vector<T>& v )
+   {
+      const std::vector<char> packed = fc::raw::pack( v );
+      BOOST_CHECK( packed == pack_elementwise( v ) );
+      BOOST_CHECK( fc::raw::unpack<std::vector<T>>( packed ) == v );
+   }
+}
 
 BOOST_AUTO_TEST_SUITE(fc_serialization)
 
@@ -121,4 +317,581 @@ BOOST_AUTO_TEST_CASE( unpack_recursion_test )
    FC_LOG_AND_RETHROW();
 }
 
+BOOST_AUTO_TEST_CASE( bulk_pack_test )
+{ try {
+   const bool little_endian = fc::raw::is_trivially_packable<uint64_t>::value;
+   BOOST_CHECK_EQUAL( little_endian, fc::raw::is_trivially_packable<int16_t>::value );
+   BOOST_CHECK_EQUAL( little_endian, fc::raw::is_trivially_packable<fc::test::flat_item>::value );
+   BOOST_CHECK_EQUAL( little_endian, fc::raw::is_trivially_packable<fc::test::reordered_item>::value );
+   BOOST_CHECK( fc::raw::is_trivially_packable<fc::sha256>::value );
+   BOOST_CHECK( (fc::raw::is_trivially_packable<std::array<char,3>>::value) );
+   BOOST_CHECK( fc::raw::is_trivially_packable<boost::endian::big_uint32_buf_t>::value );
+   BOOST_CHECK( !fc::raw::is_trivially_packable<bool>::value );
+   BOOST_CHECK( !fc::raw::is_trivially_packable<fc::unsigned_int>::value );
+   BOOST_CHECK( !fc::raw::is_trivially_packable<fc::test::padded_item>::value );
+   BOOST_CHECK( !fc::raw::is_trivially_packable<fc::test::item>::value );
+
+   // more than FC_MAX_PREALLOC_SIZE elements, so that unpacking has to grow the vector several times
+   std::vector<uint64_t> numbers;
+   std::vector<int16_t> shorts;
+   std::vector<fc::test::flat_item> flat;
+   std::vector<fc::test::reordered_item> reordered;
+   std::vector<fc::test::padded_item> padded;
+   std::vector<fc::sha256> hashes;
+   for( uint32_t i = 0; i < 3 * FC_MAX_PREALLOC_SIZE + 7; i++ )
+   {
+      numbers.push_back( i * 0x0102030405060708ULL );
+      shorts.push_back( int16_t( i * 0x0102 ) );
+      flat.push_back( { numbers.back(), -int32_t(i), uint16_t(i), {{ char(i), char(i >> 8) }} } );
+      reordered.push_back( { numbers.back(), -int32_t(i), uint16_t(i), {{ char(i), char(i >> 8) }} } );
+      padded.push_back( { numbers.back(), uint16_t(i) } );
+      hashes.push_back( fc::sha256::hash( numbers.back() ) );
+   }
+   check_vector_roundtrip( numbers );
+   check_vector_roundtrip( shorts );
+   check_vector_roundtrip( flat );
+   check_vector_roundtrip( reordered );
+   check_vector_roundtrip( hashes );
+   check_vector_roundtrip( std::vector<uint64_t>() );
+   {
+      const std::vector<char> packed = fc::raw::pack( padded );
+      BOOST_CHECK( packed == pack_elementwise( padded ) );
+      const auto unpacked = fc::raw::unpack<std::vector<fc::test::padded_item>>( packed );
+      BOOST_REQUIRE_EQUAL( padded.size(), unpacked.size() );
+      for( size_t i = 0; i < padded.size(); i++ )
+         BOOST_CHECK( padded[i].id == unpacked[i].id && padded[i].flags == unpacked[i].flags );
+   }
+
+   // truncated input and a bogus length fail like they do element by element
+   std::vector<char> packed = fc::raw::pack( numbers );
+   packed.pop_back();
+   BOOST_CHECK_THROW( fc::raw::unpack<std::vector<uint64_t>>( packed ), fc::out_of_range_exception );
+   packed = fc::raw::pack( fc::unsigned_int( 1ULL << 40 ) );
+   packed.resize( packed.size() + 16 );
+   BOOST_CHECK_THROW( fc::raw::unpack<std::vector<uint64_t>>( packed ), fc::out_of_range_exception );
+
+   // the depth limit still applies to the elements
+   if( little_endian )
+   {
+      std::vector<char> buf( 16 * flat.size() + 16 );
+      fc::datastream<char*> out( buf.data(), buf.size() );
+      BOOST_CHECK_THROW( fc::raw::pack( out, flat, 2 ), fc::assert_exception );
+      packed = fc::raw::pack( flat );
+      fc::datastream<const char*> in( packed.data(), packed.size() );
+      std::vector<fc::test::flat_item> unpacked;
+      BOOST_CHECK_THROW( fc::raw::unpack( in, unpacked, 2 ), fc::assert_exception );
+      fc::datastream<const char*> in3( packed.data(), packed.size() );
+      fc::raw::unpack( in3, unpacked, 3 );
+      BOOST_CHECK_EQUAL( flat.size(), unpacked.size() );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( bulk_pack_benchmark )
+{ try {
+   const uint32_t COUNT = 1 << 22;
+   auto measure = [] ( const char* name, const auto& v ) {
+      using vector_type = std::decay_t<decltype(v)>;
+      fc::time_point start = fc::time_point::now();
+      const std::vector<char> elementwise = pack_elementwise( v );
+      const fc::microseconds elementwise_pack = fc::time_point::now() - start;
+      start = fc::time_point::now();
+      const std::vector<char> bulk = fc::raw::pack( v );
+      const fc::microseconds bulk_pack = fc::time_point::now() - start;
+      BOOST_CHECK( elementwise == bulk );
+
+      vector_type unpacked;
+      start = fc::time_point::now();
+      unpack_elementwise( bulk, unpacked );
+      const fc::microseconds elementwise_unpack = fc::time_point::now() - start;
+      BOOST_CHECK( unpacked == v );
+      start = fc::time_point::now();
+      fc::datastream<const char*> ds( bulk.data(), bulk.size() );
+      fc::raw::unpack( ds, unpacked );
+      const fc::microseconds bulk_unpack = fc::time_point::now() - start;
+      BOOST_CHECK( unpacked == v );
+
+      ilog( "${n}: ${c} elements (${b} bytes), pack ${ep}us element-wise vs ${bp}us bulk, "
+            "unpack ${eu}us element-wise vs ${bu}us bulk",
+            ("n",name)("c",v.size())("b",bulk.size())("ep",elementwise_pack.count())("bp",bulk_pack.count())
+            ("eu",elementwise_unpack.count())("bu",bulk_unpack.count()) );
+   };
+
+   std::vector<uint64_t> numbers( COUNT );
+   std::vector<fc::test::flat_item> flat( COUNT / 2 );
+   for( uint32_t i = 0; i < COUNT; i++ )
+      numbers[i] = i * 0x0102030405060708ULL;
+   for( uint32_t i = 0; i < COUNT / 2; i++ )
+      flat[i] = { numbers[i], int32_t(i), uint16_t(i), {{ 'a', 'b' }} };
+   std::vector<fc::sha256> hashes( COUNT / 8 );
+   for( uint32_t i = 0; i < COUNT / 8; i++ )
+      hashes[i] = fc::sha256::hash( numbers[i] );
+
+   measure( "std::vector<uint64_t>", numbers );
+   measure( "std::vector<flat_item>", flat );
+   measure( "std::vector<sha256>", hashes );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( unpack_view_test )
+{ try {
+   fc::test::document doc;
+   doc.name = "some document";
+   doc.payload = std::vector<char>( 3000, 'x' );
+   for( uint32_t i = 0; i < 100; i++ )
+   {
+      doc.ids.push_back( i * 0x0102030405060708ULL );
+      doc.items.push_back( { i, -int32_t(i), uint16_t(i), {{ 'a', char(i) }} } );
+   }
+   doc.header = { 42, -1, 7, {{ 'h', 'd' }} };
+   doc.checksum = 0xdeadbeef;
+   const std::vector<char> packed = fc::raw::pack( doc );
+   const char* const begin = packed.data();
+   const char* const end = packed.data() + packed.size();
+   auto in_buffer = [begin,end] ( const char* p ) { return p >= begin && p < end; };
+
+   fc::test::document_view view;
+   fc::datastream<const char*> ds( packed.data(), packed.size() );
+   fc::raw::unpack( ds, view );
+   BOOST_CHECK_EQUAL( 0u, ds.remaining() );
+
+   BOOST_CHECK( view.name == doc.name );
+   BOOST_CHECK( in_buffer( view.name.data() ) );
+   BOOST_CHECK( view.payload.to_vector() == doc.payload );
+   BOOST_CHECK( in_buffer( view.payload.data() ) );
+   BOOST_REQUIRE_EQUAL( doc.ids.size(), view.ids.size() );
+   BOOST_CHECK( in_buffer( view.ids.data() ) );
+   BOOST_CHECK_EQUAL( doc.ids[17], view.ids[17] );
+   BOOST_CHECK( view.ids.to_vector() == doc.ids );
+   BOOST_CHECK_THROW( view.ids.at( doc.ids.size() ), fc::assert_exception );
+   // reordered_item is not laid out as packed, its elements are unpacked one by one
+   BOOST_CHECK( view.items[17] == doc.items[17] );
+   BOOST_CHECK( view.items.to_vector() == doc.items );
+   BOOST_CHECK( in_buffer( view.header.data() ) );
+   BOOST_CHECK( !view.header.is_unpacked() );
+   BOOST_CHECK_EQUAL( doc.header.id, view.header->id );
+   BOOST_CHECK( view.header.is_unpacked() );
+   BOOST_CHECK( *view.header == doc.header );
+   BOOST_CHECK_EQUAL( doc.checksum, view.checksum );
+
+   // views pack like the types they stand for
+   BOOST_CHECK( fc::raw::pack( view ) == packed );
+
+   // a packed_ref of a type without fixed size can be made from any buffer
+   fc::test::item nested( fc::test::item_wrapper( fc::test::item( 5 ) ), 6 );
+   const std::vector<char> packed_item = fc::raw::pack( nested );
+   fc::raw::packed_ref<fc::test::item> item_ref( fc::raw::blob_view( packed_item.data(), packed_item.size() ) );
+   BOOST_CHECK( *item_ref == nested );
+   BOOST_CHECK( fc::raw::pack( item_ref ) == packed_item );
+
+   // views never point past the end of the buffer
+   for( size_t size : { packed.size() - 1, size_t(1 + doc.name.size() + 2 + 1000) } )
+   {
+      fc::datastream<const char*> truncated( packed.data(), size );
+      BOOST_CHECK_THROW( fc::raw::unpack( truncated, view ), fc::exception );
+   }
+
+   // wide_counter looks trivially packable, but its elements are wider packed than in memory
+   const std::vector<char> packed_counters = fc::raw::pack( std::vector<fc::test::wide_counter>{ {1}, {2}, {3} } );
+   fc::datastream<const char*> counters( packed_counters.data(), packed_counters.size() );
+   fc::raw::packed_span<fc::test::wide_counter> counter_span;
+   BOOST_CHECK_THROW( fc::raw::unpack( counters, counter_span ), fc::assert_exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( single_pass_pack_test )
+{ try {
+   fc::test::document doc;
+   doc.name = "single pass";
+   doc.payload = std::vector<char>( 100, 'p' );
+   doc.ids = { 1, 2, 3 };
+   doc.items.resize( 10 );
+   doc.header = { 1, 2, 3, {{ 'a', 'b' }} };
+   doc.checksum = 4;
+   fc::test::item nested( fc::test::item_wrapper( fc::test::item( 5 ) ), 6 );
+
+   // the two-pass packing that pack() used to do
+   std::vector<char> expected( fc::raw::pack_size( doc ) );
+   fc::datastream<char*> ds( expected.data(), expected.size() );
+   fc::raw::pack( ds, doc );
+   BOOST_CHECK( fc::raw::pack( doc ) == expected );
+   BOOST_CHECK( fc::raw::unpack<fc::test::item>( fc::raw::pack( nested ) ) == nested );
+
+   std::vector<char> buffer;
+   fc::raw::pack_into( buffer, doc );
+   BOOST_CHECK( buffer == expected );
+   const char* const data = buffer.data();
+   buffer.clear();
+   fc::raw::pack_into( buffer, doc );
+   BOOST_CHECK( buffer == expected );
+   BOOST_CHECK( buffer.data() == data );
+   // pack_into appends
+   fc::raw::pack_into( buffer, nested );
+   fc::datastream<const char*> in( buffer.data(), buffer.size() );
+   fc::test::document unpacked_doc;
+   fc::test::item unpacked_item;
+   fc::raw::unpack( in, unpacked_doc );
+   fc::raw::unpack( in, unpacked_item );
+   BOOST_CHECK( fc::raw::pack( unpacked_doc ) == expected );
+   BOOST_CHECK( unpacked_item == nested );
+   BOOST_CHECK_EQUAL( 0u, in.remaining() );
+
+   // pack() while the scratch buffer of the thread is in use, as a custom pack() of an enclosing pack() may do
+   {
+      fc::raw::detail::pack_scratch outer;
+      outer.buffer().assign( 3, 'o' );
+      BOOST_CHECK( fc::raw::pack( doc ) == expected );
+      BOOST_CHECK( outer.buffer() == std::vector<char>( 3, 'o' ) );
+   }
+   BOOST_CHECK( fc::raw::pack( doc ) == expected );
+
+   // an exception while packing releases the scratch buffer
+   fc::test::item too_deep;
+   for( int32_t i = 1; i <= 200; i++ )
+      too_deep = fc::test::item( fc::test::item_wrapper( std::move(too_deep) ), i );
+   BOOST_CHECK_THROW( fc::raw::pack( too_deep ), fc::assert_exception );
+   BOOST_CHECK( fc::raw::pack( doc ) == expected );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( single_pass_pack_benchmark )
+{ try {
+   const uint32_t ROUNDS = 20000;
+   fc::test::document doc;
+   doc.name = "benchmark";
+   doc.payload = std::vector<char>( 200, 'p' );
+   doc.ids.resize( 20 );
+   doc.items.resize( 50 );
+   const fc::test::item nested = [] {
+      fc::test::item result;
+      for( int32_t i = 1; i <= 50; i++ )
+         result = fc::test::item( fc::test::item_wrapper( std::move(result) ), i );
+      return result;
+   }();
+
+   auto measure = [ROUNDS] ( const char* name, const auto& v ) {
+      size_t total = 0;
+      fc::time_point start = fc::time_point::now();
+      for( uint32_t i = 0; i < ROUNDS; i++ )
+      {
+         std::vector<char> vec( fc::raw::pack_size( v ) );
+         fc::datastream<char*> ds( vec.data(), vec.size() );
+         fc::raw::pack( ds, v );
+         total += vec.size();
+      }
+      const fc::microseconds two_pass = fc::time_point::now() - start;
+
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < ROUNDS; i++ )
+         total -= fc::raw::pack( v ).size();
+      const fc::microseconds single_pass = fc::time_point::now() - start;
+
+      std::vector<char> buffer;
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < ROUNDS; i++ )
+      {
+         buffer.clear();
+         fc::raw::pack_into( buffer, v );
+         total += buffer.size();
+      }
+      const fc::microseconds reused = fc::time_point::now() - start;
+      BOOST_CHECK_EQUAL( ROUNDS * buffer.size(), total );
+
+      ilog( "${n}: ${r} x ${b} bytes, two passes ${t}us, pack() ${s}us, pack_into() a reused buffer ${u}us",
+            ("n",name)("r",ROUNDS)("b",buffer.size())("t",two_pass.count())("s",single_pass.count())
+            ("u",reused.count()) );
+   };
+   measure( "document", doc );
+   measure( "nested item", nested );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( fixed_packed_size_test )
+{ try {
+   static_assert( fc::raw::fixed_packed_size<fc::sha256>::value == 32, "" );
+   static_assert( fc::raw::fixed_packed_size<fc::time_point_sec>::value == 4, "" );
+   static_assert( fc::raw::fixed_packed_size<fc::test::record_kind>::value == 8, "" );
+   static_assert( fc::raw::fixed_packed_size<fc::test::flat_item>::value == 16, "" );
+   static_assert( fc::raw::fixed_packed_size<fc::test::padded_item>::value == 10, "" );
+   static_assert( fc::raw::fixed_packed_size<fc::test::fixed_record>::is_fixed, "" );
+   static_assert( fc::raw::fixed_packed_size<fc::test::fixed_record>::value == 32 + 4 + 10 + 1 + 8, "" );
+   static_assert( !fc::raw::fixed_packed_size<fc::test::document>::is_fixed, "" );
+   static_assert( !fc::raw::fixed_packed_size<fc::test::item>::is_fixed, "" );
+   static_assert( !fc::raw::fixed_packed_size<std::string>::is_fixed, "" );
+   static_assert( !fc::raw::fixed_packed_size<fc::unsigned_int>::is_fixed, "" );
+
+   fc::test::fixed_record record;
+   record.id = fc::sha256::hash( std::string( "record" ) );
+   record.time = fc::time_point_sec( 1234567890 );
+   record.padded = { 0x0102030405060708ULL, 0x0a0b };
+   record.flag = true;
+   record.kind = fc::test::special_record;
+
+   // a buffer sized at compile time
+   std::array<char, fc::raw::fixed_packed_size<fc::test::fixed_record>::value> buffer;
+   fc::datastream<char*> buffer_stream( buffer.data(), buffer.size() );
+   fc::raw::pack( buffer_stream, record );
+   BOOST_CHECK( fc::raw::unpack<fc::test::fixed_record>( buffer.data(), buffer.size() ) == record );
+   BOOST_CHECK_EQUAL( buffer.size(), fc::raw::pack_size( record ) );
+
+   // same bytes as packing field by field
+   std::vector<char> expected;
+   for( const auto& field : { fc::raw::pack( record.id ), fc::raw::pack( record.time ), fc::raw::pack( record.padded ),
+                              fc::raw::pack( record.flag ), fc::raw::pack( int64_t( record.kind ) ) } )
+      expected.insert( expected.end(), field.begin(), field.end() );
+   BOOST_CHECK( std::vector<char>( buffer.begin(), buffer.end() ) == expected );
+   BOOST_CHECK( fc::raw::pack( record ) == expected );
+   std::vector<char> appended( 3, 'x' );
+   fc::raw::pack_into( appended, record );
+   BOOST_CHECK( std::vector<char>( appended.begin() + 3, appended.end() ) == expected );
+
+   // the whole object is checked against the bounds before anything is written or read
+   std::vector<char> short_buffer( expected.size() - 1, 'x' );
+   fc::datastream<char*> out( short_buffer.data(), short_buffer.size() );
+   BOOST_CHECK_THROW( fc::raw::pack( out, record ), fc::out_of_range_exception );
+   BOOST_CHECK( short_buffer == std::vector<char>( expected.size() - 1, 'x' ) );
+   fc::datastream<const char*> in( expected.data(), expected.size() - 1 );
+   fc::test::fixed_record unpacked;
+   BOOST_CHECK_THROW( fc::raw::unpack( in, unpacked ), fc::out_of_range_exception );
+   BOOST_CHECK_EQUAL( 0u, in.tellp() );
+
+   // validation of members still happens
+   expected[32 + 4 + 10] = 2;
+   BOOST_CHECK_THROW( fc::raw::unpack<fc::test::fixed_record>( expected ), fc::assert_exception );
+
+   // a custom pack() of a member may not keep to the fixed size, that must not write or read out of bounds
+   static_assert( fc::raw::fixed_packed_size<fc::test::tagged_record>::value == 4 + 1, "" );
+   const fc::test::tagged_record small_tag{ 7, { 5 } };
+   const fc::test::tagged_record large_tag{ 7, { 200 } };
+   const std::vector<char> packed_small = fc::raw::pack( small_tag );
+   BOOST_REQUIRE_EQUAL( 5u, packed_small.size() );
+   BOOST_CHECK_EQUAL( 5, fc::raw::unpack<fc::test::tagged_record>( packed_small ).tag.value );
+   std::array<char, 5 + 1> guarded;
+   guarded.fill( 'x' );
+   fc::datastream<char*> tag_out( guarded.data(), 5 );
+   BOOST_CHECK_THROW( fc::raw::pack( tag_out, large_tag ), fc::out_of_range_exception );
+   BOOST_CHECK_EQUAL( 'x', guarded[5] );
+   fc::datastream<char*> wide_tag_out( guarded.data(), guarded.size() );
+   BOOST_CHECK_THROW( fc::raw::pack( wide_tag_out, large_tag ), fc::assert_exception );
+   BOOST_CHECK_THROW( fc::raw::pack_size( large_tag ), fc::assert_exception );
+   BOOST_CHECK_THROW( fc::raw::pack( large_tag ), fc::assert_exception );
+   std::vector<char> large_packed( packed_small );
+   large_packed.back() = char( 0x80 | ( 200 & 0x7f ) );
+   fc::test::tagged_record unpacked_tag;
+   fc::datastream<const char*> tag_in( large_packed.data(), large_packed.size() );
+   BOOST_CHECK_THROW( fc::raw::unpack( tag_in, unpacked_tag ), fc::out_of_range_exception );
+   large_packed.push_back( char( 200 >> 7 ) );
+   BOOST_CHECK_THROW( fc::raw::unpack<fc::test::tagged_record>( large_packed ), fc::assert_exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( fixed_packed_size_benchmark )
+{ try {
+   const uint32_t ROUNDS = 1000000;
+   fc::test::fixed_record record;
+   record.id = fc::sha256::hash( std::string( "record" ) );
+   record.time = fc::time_point_sec( 1234567890 );
+   record.padded = { 1, 2 };
+   record.flag = false;
+   record.kind = fc::test::plain_record;
+   std::vector<char> buffer( ROUNDS * fc::raw::fixed_packed_size<fc::test::fixed_record>::value );
+
+   auto measure = [&] ( auto fixed_size ) {
+      using packer = fc::raw::detail::if_fixed_size< decltype(fixed_size)::value >;
+      fc::time_point start = fc::time_point::now();
+      {
+         fc::datastream<char*> ds( buffer.data(), buffer.size() );
+         for( uint32_t i = 0; i < ROUNDS; i++ )
+            packer::pack( ds, record, FC_PACK_MAX_DEPTH );
+      }
+      const fc::microseconds pack_time = fc::time_point::now() - start;
+      fc::test::fixed_record unpacked;
+      start = fc::time_point::now();
+      {
+         fc::datastream<const char*> ds( buffer.data(), buffer.size() );
+         for( uint32_t i = 0; i < ROUNDS; i++ )
+            packer::unpack( ds, unpacked, FC_PACK_MAX_DEPTH );
+      }
+      const fc::microseconds unpack_time = fc::time_point::now() - start;
+      BOOST_CHECK( unpacked == record );
+      ilog( "fixed_record, ${c}: ${r} x pack ${p}us, unpack ${u}us",
+            ("c",fixed_size ? "one bounds check" : "bounds checked per field")("r",ROUNDS)
+            ("p",pack_time.count())("u",unpack_time.count()) );
+   };
+   measure( std::false_type() );
+   measure( std::true_type() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( skip_test )
+{ try {
+   std::vector<fc::test::document> docs( 20 );
+   for( uint32_t i = 0; i < docs.size(); i++ )
+   {
+      docs[i].name = std::string( i, 'n' );
+      docs[i].payload = std::vector<char>( 10 * i, 'p' );
+      docs[i].ids = std::vector<uint64_t>( i, i );
+      docs[i].items = std::vector<fc::test::reordered_item>( i % 3, { i, 1, 2, {{ 'a', 'b' }} } );
+      docs[i].header = { i, 3, 4, {{ 'h', 'd' }} };
+      docs[i].checksum = i;
+   }
+   const std::vector<char> packed = fc::raw::pack( docs );
+
+   // skipping ends exactly where unpacking ends
+   auto check_skip = [] ( const auto& value ) {
+      using value_type = std::decay_t<decltype(value)>;
+      std::vector<char> buffer = fc::raw::pack( value );
+      const size_t size = buffer.size();
+      buffer.push_back( 'x' );
+      fc::datastream<const char*> ds( buffer.data(), buffer.size() );
+      fc::raw::skip<value_type>( ds );
+      BOOST_CHECK_EQUAL( size, ds.tellp() );
+   };
+   check_skip( docs );
+   check_skip( docs[7] );
+   check_skip( fc::test::item( fc::test::item_wrapper( fc::test::item( fc::test::item_wrapper( fc::test::item( 1 ) ) ) ) ) );
+   typedef fc::static_variant<int32_t, std::string, fc::test::fixed_record, std::vector<fc::test::document>> variant_type;
+   std::map<std::string, fc::optional<variant_type>> mixed;
+   mixed["none"];
+   mixed["int"] = variant_type( int32_t(5) );
+   mixed["string"] = variant_type( std::string( "value" ) );
+   mixed["record"] = variant_type( fc::test::fixed_record() );
+   mixed["docs"] = variant_type( docs );
+   check_skip( mixed );
+   check_skip( std::make_pair( fc::flat_map<uint32_t, std::string>{ { 1, "one" }, { 2, "two" } }, std::deque<bool>( 3 ) ) );
+
+   // skipping never reads past the end of the data
+   for( size_t size : { size_t(0), size_t(1), packed.size() / 2, packed.size() - 1 } )
+   {
+      fc::datastream<const char*> truncated( packed.data(), size );
+      BOOST_CHECK_THROW( fc::raw::skip<std::vector<fc::test::document>>( truncated ), fc::exception );
+   }
+   std::vector<char> bad_tag = fc::raw::pack( mixed );
+   fc::datastream<const char*> tag_stream( bad_tag.data(), bad_tag.size() );
+   fc::raw::skip<std::string>( tag_stream ); // first key is "docs"
+   bad_tag[tag_stream.tellp() + 1] = 4;
+   BOOST_CHECK_THROW( fc::raw::unpack<decltype(mixed)>( bad_tag ), fc::exception );
+   fc::datastream<const char*> bad_tag_stream( bad_tag.data(), bad_tag.size() );
+   BOOST_CHECK_THROW( fc::raw::skip<decltype(mixed)>( bad_tag_stream ), fc::assert_exception );
+
+   // packed_ref of any type can be unpacked from a stream
+   std::vector<fc::raw::packed_ref<fc::test::document>> refs;
+   fc::datastream<const char*> ref_stream( packed.data(), packed.size() );
+   fc::raw::unpack( ref_stream, refs );
+   BOOST_CHECK_EQUAL( 0u, ref_stream.remaining() );
+   BOOST_REQUIRE_EQUAL( docs.size(), refs.size() );
+   BOOST_CHECK( !refs[11].is_unpacked() );
+   BOOST_CHECK( fc::raw::pack( *refs[11] ) == fc::raw::pack( docs[11] ) );
+   BOOST_CHECK( fc::raw::pack( refs ) == packed );
+
+   // random access through an index
+   fc::datastream<const char*> index_stream( packed.data(), packed.size() );
+   fc::raw::packed_vector_index<fc::test::document> index( index_stream );
+   BOOST_CHECK_EQUAL( 0u, index_stream.remaining() );
+   BOOST_REQUIRE_EQUAL( docs.size(), index.size() );
+   BOOST_CHECK_EQUAL( packed.size() - 1, index.packed_size() );
+   for( size_t i : { size_t(0), size_t(13), docs.size() - 1 } )
+   {
+      BOOST_CHECK_EQUAL( fc::raw::pack_size( docs[i] ), index[i].size() );
+      BOOST_CHECK( fc::raw::pack( index.at( i ).get() ) == fc::raw::pack( docs[i] ) );
+   }
+   BOOST_CHECK_THROW( index.at( docs.size() ), fc::assert_exception );
+   BOOST_CHECK( fc::raw::pack( index ) == packed );
+
+   std::vector<fc::test::fixed_record> records( 5 );
+   for( uint32_t i = 0; i < records.size(); i++ )
+      records[i].padded.id = i;
+   const std::vector<char> packed_records = fc::raw::pack( records );
+   fc::datastream<const char*> records_stream( packed_records.data(), packed_records.size() );
+   fc::raw::packed_vector_index<fc::test::fixed_record> fixed_index;
+   fc::raw::unpack( records_stream, fixed_index );
+   BOOST_CHECK_EQUAL( 0u, records_stream.remaining() );
+   BOOST_REQUIRE_EQUAL( records.size(), fixed_index.size() );
+   BOOST_CHECK_EQUAL( 3 * fc::raw::fixed_packed_size<fc::test::fixed_record>::value, fixed_index.offset( 3 ) );
+   BOOST_CHECK( *fixed_index[3] == records[3] );
+   fc::datastream<const char*> short_records( packed_records.data(), packed_records.size() - 1 );
+   BOOST_CHECK_THROW( fc::raw::packed_vector_index<fc::test::fixed_record>{ short_records }, fc::exception );
+
+   // the fixed size from the reflection is not used where a custom pack() packs a different size
+   static_assert( fc::raw::fixed_packed_size<fc::test::counted_record>::value == 4 + 2, "" );
+   std::vector<fc::test::counted_record> counted( 7 );
+   for( uint32_t i = 0; i < counted.size(); i++ )
+      counted[i] = { { i }, uint16_t( 100 + i ) };
+   const size_t counted_size = 8 + 2;
+   BOOST_CHECK_EQUAL( counted_size, fc::raw::pack_size( counted[0] ) );
+   check_skip( counted[0].count );
+   check_skip( counted[0] );
+   check_skip( counted );
+   check_skip( std::make_pair( counted[1], std::string( "after" ) ) );
+   const std::vector<char> packed_counted = fc::raw::pack( counted );
+   std::vector<fc::raw::packed_ref<fc::test::counted_record>> counted_refs;
+   fc::datastream<const char*> counted_ref_stream( packed_counted.data(), packed_counted.size() );
+   fc::raw::unpack( counted_ref_stream, counted_refs );
+   BOOST_CHECK_EQUAL( 0u, counted_ref_stream.remaining() );
+   BOOST_REQUIRE_EQUAL( counted.size(), counted_refs.size() );
+   BOOST_CHECK_EQUAL( counted_size, counted_refs[3].size() );
+   BOOST_CHECK_EQUAL( 103, counted_refs[3]->flags );
+   fc::datastream<const char*> counted_stream( packed_counted.data(), packed_counted.size() );
+   fc::raw::packed_vector_index<fc::test::counted_record> counted_index( counted_stream );
+   BOOST_CHECK_EQUAL( 0u, counted_stream.remaining() );
+   BOOST_REQUIRE_EQUAL( counted.size(), counted_index.size() );
+   BOOST_CHECK_EQUAL( 5 * counted_size, counted_index.offset( 5 ) );
+   BOOST_CHECK_EQUAL( 5u, counted_index[5]->count.value );
+   BOOST_CHECK_EQUAL( 105, counted_index[5]->flags );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( skip_benchmark )
+{ try {
+   const uint32_t ROUNDS = 100;
+   std::vector<fc::test::document> docs( 1000 );
+   for( uint32_t i = 0; i < docs.size(); i++ )
+   {
+      docs[i].name = "document " + std::to_string( i );
+      docs[i].payload = std::vector<char>( 100 + i % 50, 'p' );
+      docs[i].ids = std::vector<uint64_t>( 20, i );
+      docs[i].items = std::vector<fc::test::reordered_item>( 5, { i, 1, 2, {{ 'a', 'b' }} } );
+      docs[i].header = { i, 3, 4, {{ 'h', 'd' }} };
+      docs[i].checksum = i;
+   }
+   const std::vector<char> packed = fc::raw::pack( docs );
+   const size_t wanted = docs.size() - 1;
+   uint32_t found = 0;
+
+   // the last document, by unpacking all preceding ones
+   fc::time_point start = fc::time_point::now();
+   for( uint32_t r = 0; r < ROUNDS; r++ )
+   {
+      fc::datastream<const char*> ds( packed.data(), packed.size() );
+      fc::unsigned_int size;
+      fc::raw::unpack( ds, size );
+      fc::test::document doc;
+      for( size_t i = 0; i <= wanted; i++ )
+         fc::raw::unpack( ds, doc );
+      found += doc.checksum;
+   }
+   const fc::microseconds unpack_time = fc::time_point::now() - start;
+
+   start = fc::time_point::now();
+   for( uint32_t r = 0; r < ROUNDS; r++ )
+   {
+      fc::datastream<const char*> ds( packed.data(), packed.size() );
+      fc::unsigned_int size;
+      fc::raw::unpack( ds, size );
+      for( size_t i = 0; i < wanted; i++ )
+         fc::raw::skip<fc::test::document>( ds );
+      fc::test::document doc;
+      fc::raw::unpack( ds, doc );
+      found += doc.checksum;
+   }
+   const fc::microseconds skip_time = fc::time_point::now() - start;
+
+   fc::datastream<const char*> ds( packed.data(), packed.size() );
+   start = fc::time_point::now();
+   fc::raw::packed_vector_index<fc::test::document> index( ds );
+   const fc::microseconds index_time = fc::time_point::now() - start;
+   start = fc::time_point::now();
+   for( uint32_t r = 0; r < ROUNDS; r++ )
+      found += index[wanted]->checksum;
+   const fc::microseconds lookup_time = fc::time_point::now() - start;
+
+   BOOST_CHECK_EQUAL( 3 * ROUNDS * wanted, found );
+   ilog( "document ${n} of ${b} bytes, ${r} x: unpacking all ${u}us, skipping ${s}us, "
+         "building an index once ${i}us and looking up ${l}us",
+         ("n",wanted)("b",packed.size())("r",ROUNDS)("u",unpack_time.count())("s",skip_time.count())
+         ("i",index_time.count())("l",lookup_time.count()) );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,199 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fc/thread/channel.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/time.hpp>
+
+#include <boost/thread/mutex.hpp>
+
+#include <deque>
+#include <numeric>
+#include <vector>
+
+namespace {
+   /** The kind of queue the channel replaces, for comparison */
+   template<typename T>
+   class mutex_queue {
+   public:
+      void push( T value )
+      {
+         fc::promise<void>::ptr waiter;
+         {
+            boost::unique_lock<boost::mutex> lock( _lock );
+            _values.push_back( std::move( value ) );
+            waiter.swap( _waiter );
+         }
+         if( waiter )
+            waiter->set_value();
+      }
+
+      T pop()
+      {
+         for(;;)
+         {
+            fc::promise<void>::ptr waiter;
+            {
+               boost::unique_lock<boost::mutex> lock( _lock );
+               if( !_values.empty() )
+               {
+                  T value = std::move( _values.front() );
+                  _values.pop_front();
+                  return value;
+               }
+               waiter = _waiter = fc::promise<void>::create( "mutex_queue" );
+            }
+            waiter->wait();
+         }
+      }
+
+   private:
+      boost::mutex           _lock;
+      std::deque<T>          _values;
+      fc::promise<void>::ptr _waiter;
+   };
+}
+
+BOOST_AUTO_TEST_SUITE(channel_tests)
+
+BOOST_AUTO_TEST_CASE(passes_values_in_order)
+{
+   fc::channel<int> ch( 3 );
+   BOOST_CHECK_EQUAL( 4u, ch.capacity() );
+   for( int i = 0; i < 4; i++ )
+      BOOST_CHECK( ch.try_push( i ) );
+   BOOST_CHECK( !ch.try_push( 4 ) );
+   BOOST_CHECK_EQUAL( 4u, ch.size() );
+
+   int value;
+   for( int i = 0; i < 4; i++ )
+   {
+      BOOST_REQUIRE( ch.try_pop( value ) );
+      BOOST_CHECK_EQUAL( i, value );
+   }
+   BOOST_CHECK( !ch.try_pop( value ) );
+
+   std::vector<int> input{ 1, 2, 3 };
+   BOOST_CHECK_EQUAL( 3u, ch.push_n( input.begin(), input.size() ) );
+   std::vector<int> output;
+   BOOST_CHECK_EQUAL( 2u, ch.pop_n( std::back_inserter( output ), 2 ) );
+   BOOST_CHECK_EQUAL( 1u, ch.pop_n( std::back_inserter( output ), 2 ) );
+   BOOST_CHECK( input == output );
+}
+
+BOOST_AUTO_TEST_CASE(blocks_producers_and_consumers)
+{
+   fc::thread producer_thread( "producer" );
+   fc::thread consumer_thread( "consumer" );
+   fc::channel<int> ch( 8 );
+   const int count = 10000;
+
+   std::vector<fc::future<void>> producers;
+   for( int p = 0; p < 2; p++ )
+      producers.push_back( producer_thread.async( [&ch,p,count] {
+         for( int i = p; i < count; i += 2 )
+            FC_ASSERT( ch.push( i ) );
+      } ) );
+   std::vector<fc::future<int64_t>> consumers;
+   for( int c = 0; c < 2; c++ )
+      consumers.push_back( consumer_thread.async( [&ch] {
+         int64_t sum = 0;
+         int values[16];
+         size_t n;
+         while( ( n = ch.pop_n( values, 16 ) ) > 0 )
+            sum = std::accumulate( values, values + n, sum );
+         return sum;
+      } ) );
+   // the main thread takes part as a plain consumer
+   int64_t sum = 0;
+   int value;
+   for( int i = 0; i < 100 && ch.pop( value ); i++ )
+      sum += value;
+
+   for( auto& producer : producers )
+      producer.wait();
+   ch.close();
+   for( auto& consumer : consumers )
+      sum += consumer.wait();
+   BOOST_CHECK_EQUAL( int64_t(count) * ( count - 1 ) / 2, sum );
+}
+
+BOOST_AUTO_TEST_CASE(closes_and_cancels)
+{
+   fc::thread thread( "channel" );
+   fc::channel<int> ch( 1 );
+   BOOST_CHECK_EQUAL( 2u, ch.capacity() );
+   BOOST_CHECK( ch.push( 0 ) );
+   BOOST_CHECK( ch.push( 1 ) );
+   fc::future<bool> blocked_push = thread.async( [&ch] { return ch.push( 2 ); } );
+   fc::future<void> canceled_push = thread.async( [&ch] { ch.push( 3 ); } );
+   fc::usleep( fc::milliseconds( 20 ) );
+   BOOST_CHECK( !blocked_push.ready() );
+   canceled_push.cancel_and_wait();
+
+   ch.close();
+   BOOST_CHECK( !blocked_push.wait() );
+   BOOST_CHECK( !ch.push( 4 ) );
+   int value;
+   BOOST_REQUIRE( ch.pop( value ) );
+   BOOST_CHECK_EQUAL( 0, value );
+   BOOST_REQUIRE( ch.pop( value ) );
+   BOOST_CHECK_EQUAL( 1, value );
+   BOOST_CHECK( !ch.pop( value ) );
+
+   fc::channel<int> empty( 1 );
+   fc::future<bool> blocked_pop = thread.async( [&empty] { int v; return empty.pop( v ); } );
+   fc::usleep( fc::milliseconds( 20 ) );
+   BOOST_CHECK( !blocked_pop.ready() );
+   empty.close();
+   BOOST_CHECK( !blocked_pop.wait() );
+}
+
+BOOST_AUTO_TEST_CASE(channel_benchmark)
+{
+   fc::thread producer_thread( "producer" );
+   fc::thread consumer_thread( "consumer" );
+   const int count = 200000;
+
+   {
+      mutex_queue<int> queue;
+      fc::time_point start = fc::time_point::now();
+      fc::future<void> producer = producer_thread.async( [&queue,count] {
+         for( int i = 0; i < count; i++ )
+            queue.push( i );
+      } );
+      fc::future<void> consumer = consumer_thread.async( [&queue,count] {
+         for( int i = 0; i < count; i++ )
+            queue.pop();
+      } );
+      producer.wait();
+      consumer.wait();
+      ilog( "mutex+deque: ${n} values in ${t}us", ("n",count)("t",(fc::time_point::now() - start).count()) );
+   }
+
+   for( size_t batch : { 1, 64 } )
+   {
+      fc::channel<int> ch( 1024 );
+      fc::time_point start = fc::time_point::now();
+      fc::future<void> producer = producer_thread.async( [&ch,count,batch] {
+         std::vector<int> values( batch );
+         for( int i = 0; i < count; i += batch )
+         {
+            std::iota( values.begin(), values.end(), i );
+            ch.push_n( values.begin(), batch );
+         }
+      } );
+      fc::future<void> consumer = consumer_thread.async( [&ch,count,batch] {
+         std::vector<int> values( batch );
+         for( int received = 0; received < count; )
+            received += ch.pop_n( values.begin(), batch );
+      } );
+      producer.wait();
+      consumer.wait();
+      ilog( "channel, batches of ${b}: ${n} values in ${t}us",
+            ("b",batch)("n",count)("t",(fc::time_point::now() - start).count()) );
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
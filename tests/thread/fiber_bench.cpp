@@ -0,0 +1,270 @@
+/**
+ *  Microbenchmarks of the fiber runtime. Prints the results as JSON, so that
+ *  fiber switch costs can be compared across builds and Boost.Context versions.
+ *
+ *  Usage: fiber_bench [iterations [output file]]
+ */
+#include <fc/thread/thread.hpp>
+#include <fc/thread/mutex.hpp>
+#include <fc/thread/parallel.hpp>
+#include <fc/thread/scoped_lock.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/version.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+   typedef std::chrono::steady_clock bench_clock;
+
+   uint64_t nanoseconds_since( const bench_clock::time_point& start )
+   {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>( bench_clock::now() - start ).count();
+   }
+
+   /** Summarizes the samples of a latency measurement, in nanoseconds */
+   fc::variant latency( std::vector<uint64_t>& samples )
+   {
+      std::sort( samples.begin(), samples.end() );
+      uint64_t sum = 0;
+      for( uint64_t s : samples )
+         sum += s;
+      auto percentile = [&samples] ( unsigned p ) { return samples[ ( samples.size() - 1 ) * p / 100 ]; };
+      return fc::mutable_variant_object( "samples", samples.size() )
+                                       ( "mean_ns", sum / samples.size() )
+                                       ( "p50_ns", percentile( 50 ) )
+                                       ( "p99_ns", percentile( 99 ) )
+                                       ( "max_ns", samples.back() );
+   }
+
+   /** Summarizes a measurement of operations that can only be timed in bulk */
+   fc::variant throughput( uint64_t operations, uint64_t elapsed_ns )
+   {
+      return fc::mutable_variant_object( "operations", operations )
+                                       ( "total_ns", elapsed_ns )
+                                       ( "ns_per_op", elapsed_ns / std::max<uint64_t>( operations, 1 ) )
+                                       ( "ops_per_second", uint64_t( operations * 1e9 / std::max<uint64_t>( elapsed_ns, 1 ) ) );
+   }
+
+   /** Two fibers on one thread yielding to each other, each yield is one switch */
+   fc::variant yield_switch( fc::thread& thread, uint32_t iterations )
+   {
+      return thread.async( [iterations] {
+         const bench_clock::time_point start = bench_clock::now();
+         auto other = fc::async( [iterations] {
+            for( uint32_t i = 0; i < iterations; i++ )
+               fc::yield();
+         }, "yield partner" );
+         for( uint32_t i = 0; i < iterations; i++ )
+            fc::yield();
+         other.wait();
+         return throughput( 2 * uint64_t( iterations ), nanoseconds_since( start ) );
+      }, "yield_switch" ).wait();
+   }
+
+   /** A fiber yielding while no other fiber is ready */
+   fc::variant yield_alone( fc::thread& thread, uint32_t iterations )
+   {
+      return thread.async( [iterations] {
+         const bench_clock::time_point start = bench_clock::now();
+         for( uint32_t i = 0; i < iterations; i++ )
+            fc::yield();
+         return throughput( iterations, nanoseconds_since( start ) );
+      }, "yield_alone" ).wait();
+   }
+
+   /** Time from async() on the target thread until the task starts running */
+   fc::variant async_to_first_run_local( fc::thread& thread, uint32_t iterations )
+   {
+      return thread.async( [iterations] {
+         std::vector<uint64_t> samples;
+         samples.reserve( iterations );
+         for( uint32_t i = 0; i < iterations; i++ )
+         {
+            const bench_clock::time_point posted = bench_clock::now();
+            samples.push_back( fc::async( [posted] { return nanoseconds_since( posted ); }, "first run" ).wait() );
+         }
+         return latency( samples );
+      }, "async_to_first_run_local" ).wait();
+   }
+
+   /** Time from async() on another thread until the task starts running */
+   fc::variant async_to_first_run_remote( fc::thread& thread, uint32_t iterations )
+   {
+      std::vector<uint64_t> samples;
+      samples.reserve( iterations );
+      for( uint32_t i = 0; i < iterations; i++ )
+      {
+         const bench_clock::time_point posted = bench_clock::now();
+         samples.push_back( thread.async( [posted] { return nanoseconds_since( posted ); }, "first run" ).wait() );
+      }
+      return latency( samples );
+   }
+
+   /** async().wait() of an empty task on another thread */
+   fc::variant cross_thread_round_trip( fc::thread& thread, uint32_t iterations )
+   {
+      std::vector<uint64_t> samples;
+      samples.reserve( iterations );
+      for( uint32_t i = 0; i < iterations; i++ )
+      {
+         const bench_clock::time_point start = bench_clock::now();
+         thread.async( [] {}, "round trip" ).wait();
+         samples.push_back( nanoseconds_since( start ) );
+      }
+      return latency( samples );
+   }
+
+   /** A fiber waiting on a promise that another fiber of the same thread sets */
+   fc::variant promise_local( fc::thread& thread, uint32_t iterations )
+   {
+      return thread.async( [iterations] {
+         std::vector<fc::promise<void>::ptr> promises;
+         for( uint32_t i = 0; i < iterations; i++ )
+            promises.push_back( fc::promise<void>::create( "bench" ) );
+         const bench_clock::time_point start = bench_clock::now();
+         auto setter = fc::async( [&promises] {
+            for( auto& p : promises )
+            {
+               p->set_value();
+               fc::yield();
+            }
+         }, "promise setter" );
+         for( auto& p : promises )
+            p->wait();
+         setter.wait();
+         return throughput( iterations, nanoseconds_since( start ) );
+      }, "promise_local" ).wait();
+   }
+
+   /** Two threads passing control back and forth through promises */
+   fc::variant promise_ping_pong( fc::thread& thread, uint32_t iterations )
+   {
+      std::vector<fc::promise<void>::ptr> ping, pong;
+      for( uint32_t i = 0; i < iterations; i++ )
+      {
+         ping.push_back( fc::promise<void>::create( "ping" ) );
+         pong.push_back( fc::promise<void>::create( "pong" ) );
+      }
+      auto partner = thread.async( [&ping,&pong] {
+         for( size_t i = 0; i < ping.size(); i++ )
+         {
+            ping[i]->wait();
+            pong[i]->set_value();
+         }
+      }, "pong" );
+      std::vector<uint64_t> samples;
+      samples.reserve( iterations );
+      for( uint32_t i = 0; i < iterations; i++ )
+      {
+         const bench_clock::time_point start = bench_clock::now();
+         ping[i]->set_value();
+         pong[i]->wait();
+         samples.push_back( nanoseconds_since( start ) );
+      }
+      partner.wait();
+      return latency( samples );
+   }
+
+   /** Fibers on two threads incrementing a counter under an fc::mutex */
+   fc::variant mutex_contention( fc::thread& first, fc::thread& second, uint32_t iterations )
+   {
+      const uint32_t fibers_per_thread = 4;
+      fc::mutex lock;
+      uint64_t counter = 0;
+      const bench_clock::time_point start = bench_clock::now();
+      std::vector<fc::future<void>> workers;
+      for( fc::thread* t : { &first, &second } )
+         for( uint32_t f = 0; f < fibers_per_thread; f++ )
+            workers.push_back( t->async( [&lock,&counter,iterations] {
+               for( uint32_t i = 0; i < iterations; i++ )
+               {
+                  fc::scoped_lock<fc::mutex> guard( lock );
+                  ++counter;
+               }
+            }, "mutex worker" ) );
+      for( auto& w : workers )
+         w.wait();
+      const uint64_t elapsed = nanoseconds_since( start );
+      FC_ASSERT( counter == 2 * fibers_per_thread * uint64_t( iterations ) );
+      return throughput( counter, elapsed );
+   }
+
+   /** Empty tasks run in the worker pool */
+   fc::variant parallel_throughput( uint32_t iterations )
+   {
+      std::vector<fc::future<void>> tasks;
+      tasks.reserve( iterations );
+      const bench_clock::time_point start = bench_clock::now();
+      for( uint32_t i = 0; i < iterations; i++ )
+         tasks.push_back( fc::do_parallel( [] {}, "parallel bench" ) );
+      for( auto& t : tasks )
+         t.wait();
+      const fc::variant single = throughput( iterations, nanoseconds_since( start ) );
+
+      std::vector<std::function<void()>> functors( iterations, [] {} );
+      const bench_clock::time_point batch_start = bench_clock::now();
+      for( auto& t : fc::post_batch( functors.begin(), functors.end(), "parallel bench" ) )
+         t.wait();
+      return fc::mutable_variant_object( "do_parallel", single )
+                                       ( "post_batch", throughput( iterations, nanoseconds_since( batch_start ) ) );
+   }
+
+   const char* context_implementation()
+   {
+#if BOOST_VERSION >= 106800
+      return "continuation_fcontext";
+#elif BOOST_VERSION >= 106100
+      return "detail::fcontext";
+#else
+      return "fcontext";
+#endif
+   }
+}
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      const uint32_t iterations = argc > 1 ? std::stoul( argv[1] ) : 100000;
+      FC_ASSERT( iterations > 0 );
+
+      fc::thread first( "bench 1" );
+      fc::thread second( "bench 2" );
+      fc::do_parallel( [] {} ).wait(); // start the pool outside of the measurements
+
+      fc::mutable_variant_object results;
+      results( "yield_switch", yield_switch( first, iterations ) );
+      results( "yield_alone", yield_alone( first, iterations ) );
+      results( "async_to_first_run_local", async_to_first_run_local( first, iterations ) );
+      results( "async_to_first_run_remote", async_to_first_run_remote( first, iterations ) );
+      results( "cross_thread_round_trip", cross_thread_round_trip( first, iterations ) );
+      results( "promise_local", promise_local( first, iterations ) );
+      results( "promise_ping_pong", promise_ping_pong( first, iterations ) );
+      results( "mutex_contention", mutex_contention( first, second, iterations / 10 ) );
+      results( "parallel_throughput", parallel_throughput( iterations ) );
+
+      const fc::variant report = fc::mutable_variant_object( "boost_version", BOOST_VERSION )
+                                                           ( "context_implementation", context_implementation() )
+                                                           ( "iterations", iterations )
+                                                           ( "results", std::move(results) );
+      if( argc > 2 )
+         fc::json::save_to_file( report, fc::path( argv[2] ) );
+      else
+         std::cout << fc::json::to_pretty_string( report ) << "\n";
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
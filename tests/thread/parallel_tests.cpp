@@ -30,6 +30,7 @@
 #include <fc/crypto/sha224.hpp>
 #include <fc/crypto/sha256.hpp>
 #include <fc/crypto/sha512.hpp>
+#include <fc/thread/ordered_pipeline.hpp>
 #include <fc/thread/parallel.hpp>
 #include <fc/time.hpp>
 
@@ -199,6 +200,178 @@ BOOST_AUTO_TEST_CASE( sign_verify_parallel )
    }
 }
 
+template<typename Functor>
+fc::future<void> post_to_pool( fc::detail::worker_pool& pool, Functor&& f )
+{
+   typedef typename std::remove_const_t< std::remove_reference_t<Functor> > FunctorType;
+   typename fc::task<void,sizeof(FunctorType)>::ptr tsk =
+      fc::task<void,sizeof(FunctorType)>::create( std::forward<Functor>(f), "pool benchmark" );
+   tsk->retain();
+   fc::future<void> r( std::dynamic_pointer_cast< fc::promise<void> >(tsk) );
+   pool.post( tsk.get() );
+   return r;
+}
+
+BOOST_AUTO_TEST_CASE( worker_pool_throughput )
+{
+   const uint32_t TASKS = 20000;
+   const uint16_t max_threads = std::max( 2u, boost::thread::hardware_concurrency() );
+   std::vector<uint16_t> pool_sizes;
+   for( uint16_t n = 1; n < max_threads; n *= 2 )
+      pool_sizes.push_back( n );
+   pool_sizes.push_back( max_threads );
+
+   for( uint16_t n : pool_sizes )
+   {
+      fc::detail::worker_pool pool( n );
+      BOOST_CHECK_EQUAL( n, pool.size() );
+      boost::atomic<uint32_t> counter(0);
+
+      // tasks posted from outside the pool go through the shared queue
+      std::vector<fc::future<void>> results;
+      results.reserve( TASKS );
+      fc::time_point start = fc::time_point::now();
+      for( uint32_t i = 0; i < TASKS; i++ )
+         results.push_back( post_to_pool( pool, [&counter] () { counter.fetch_add(1); } ) );
+      for( auto& result : results )
+         result.wait();
+      fc::microseconds shared = fc::time_point::now() - start;
+
+      // tasks posted by a worker go to its own queue and are stolen by the others
+      start = fc::time_point::now();
+      post_to_pool( pool, [&pool,&counter,TASKS] () {
+         std::vector<fc::future<void>> children;
+         children.reserve( TASKS );
+         for( uint32_t i = 0; i < TASKS; i++ )
+            children.push_back( post_to_pool( pool, [&counter] () { counter.fetch_add(1); } ) );
+         for( auto& child : children )
+            child.wait();
+      }).wait();
+      fc::microseconds local = fc::time_point::now() - start;
+
+      // the same, submitted as batches
+      const std::vector<std::function<void()>> functors( TASKS, [&counter] () { counter.fetch_add(1); } );
+      const auto post_batch_to_pool = [&pool,&functors] () {
+         std::vector<fc::task_base*> tasks;
+         std::vector<fc::future<void>> results = fc::detail::create_task_batch( functors.begin(), functors.end(),
+                                                                                "pool benchmark", tasks );
+         pool.post_batch( tasks );
+         for( auto& result : results )
+            result.wait();
+      };
+      start = fc::time_point::now();
+      post_batch_to_pool();
+      fc::microseconds shared_batch = fc::time_point::now() - start;
+      start = fc::time_point::now();
+      post_to_pool( pool, post_batch_to_pool ).wait();
+      fc::microseconds local_batch = fc::time_point::now() - start;
+
+      BOOST_CHECK_EQUAL( 4 * TASKS, counter.load() );
+      const auto rate = [TASKS] ( const fc::microseconds& t ) {
+         return TASKS * 1000000ULL / std::max( t.count(), int64_t(1) );
+      };
+      ilog( "${n} pool threads: ${s} tasks/s posted from outside, ${l} tasks/s fanned out from a worker",
+            ("n",n)("s",rate( shared ))("l",rate( local )) );
+      ilog( "${n} pool threads, batches: ${s} tasks/s posted from outside, ${l} tasks/s fanned out from a worker",
+            ("n",n)("s",rate( shared_batch ))("l",rate( local_batch )) );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( posts_task_batches )
+{
+   std::vector<std::function<int()>> functors;
+   for( int i = 0; i < 1000; i++ )
+      functors.push_back( [i] () { return 2 * i; } );
+
+   std::vector<fc::future<int>> results = fc::post_batch( functors.begin(), functors.end(), "batch" );
+   BOOST_REQUIRE_EQUAL( functors.size(), results.size() );
+   for( int i = 0; i < 1000; i++ )
+      BOOST_CHECK_EQUAL( 2 * i, results[i].wait() );
+
+   // from within the pool
+   int64_t sum = fc::do_parallel( [&functors] () {
+      int64_t result = 0;
+      for( auto& f : fc::post_batch( functors.begin(), functors.end(), "nested batch" ) )
+         result += f.wait();
+      return result;
+   } ).wait();
+   BOOST_CHECK_EQUAL( 999 * 1000, sum );
+
+   BOOST_CHECK( fc::post_batch( functors.end(), functors.end() ).empty() );
+}
+
+BOOST_AUTO_TEST_CASE( parallel_algorithms )
+{
+   std::vector<uint32_t> values( 100000 );
+   for( size_t i = 0; i < values.size(); i++ )
+      values[i] = uint32_t( ( i * 2654435761ULL ) % 1000003 );
+
+   { // parallel_for touches every element exactly once
+      std::vector<uint32_t> copy( values );
+      fc::parallel_for( copy.begin(), copy.end(), [] ( uint32_t& v ) { v += 1; }, 100 );
+      for( size_t i = 0; i < values.size(); i++ )
+         BOOST_REQUIRE_EQUAL( values[i] + 1, copy[i] );
+
+      std::vector<uint32_t> empty;
+      fc::parallel_for( empty.begin(), empty.end(), [] ( uint32_t& v ) { v = 0; } );
+   }
+
+   { // parallel_transform_reduce is equivalent to the serial computation
+      uint64_t expected = 0;
+      for( uint32_t v : values )
+         expected += uint64_t(v) * v;
+      uint64_t sum = fc::parallel_transform_reduce( values.begin(), values.end(), uint64_t(0),
+                                                    [] ( uint64_t a, uint64_t b ) { return a + b; },
+                                                    [] ( uint32_t v ) { return uint64_t(v) * v; }, 1000 );
+      BOOST_CHECK_EQUAL( expected, sum );
+
+      // non-commutative reduction preserves the order of elements
+      std::vector<std::string> words{ "a", "b", "c", "d", "e", "f", "g", "h", "i", "j" };
+      std::string joined = fc::parallel_transform_reduce( words.begin(), words.end(), std::string(">"),
+                                                          [] ( std::string a, const std::string& b ) { return a + b; },
+                                                          [] ( const std::string& w ) { return w; } );
+      BOOST_CHECK_EQUAL( ">abcdefghij", joined );
+      BOOST_CHECK_EQUAL( "x", fc::parallel_transform_reduce( words.end(), words.end(), std::string("x"),
+                                                          [] ( std::string a, const std::string& b ) { return a + b; },
+                                                          [] ( const std::string& w ) { return w; } ) );
+   }
+
+   { // parallel_sort produces the same order as std::sort
+      for( size_t n : { size_t(0), size_t(1), size_t(1000), size_t(12345), values.size() } )
+      {
+         std::vector<uint32_t> expected( values.begin(), values.begin() + n );
+         std::vector<uint32_t> sorted( expected );
+         std::sort( expected.begin(), expected.end(), std::greater<uint32_t>() );
+         fc::parallel_sort( sorted.begin(), sorted.end(), std::greater<uint32_t>(), 100 );
+         BOOST_CHECK( expected == sorted );
+      }
+   }
+
+   { // the first exception is rethrown after all batches have completed
+      boost::atomic<uint32_t> processed(0);
+      BOOST_CHECK_THROW( fc::parallel_for( values.begin(), values.end(), [&processed] ( uint32_t v ) {
+            if( v % 1000 == 0 )
+               FC_THROW_EXCEPTION( fc::assert_exception, "failing element" );
+            processed.fetch_add(1);
+         }, 1000 ), fc::assert_exception );
+      BOOST_CHECK_GT( values.size(), processed.load() );
+   }
+
+   { // compare against serial std::sort
+      std::vector<uint32_t> serial( values );
+      std::vector<uint32_t> parallel( values );
+      fc::time_point start = fc::time_point::now();
+      std::sort( serial.begin(), serial.end() );
+      fc::microseconds serial_time = fc::time_point::now() - start;
+      start = fc::time_point::now();
+      fc::parallel_sort( parallel.begin(), parallel.end() );
+      fc::microseconds parallel_time = fc::time_point::now() - start;
+      BOOST_CHECK( serial == parallel );
+      ilog( "Sorting ${n} values took ${s}us serially, ${p}us in parallel",
+            ("n",values.size())("s",serial_time.count())("p",parallel_time.count()) );
+   }
+}
+
 BOOST_AUTO_TEST_CASE( serial_valve )
 {
    boost::atomic<uint32_t> counter(0);
@@ -344,4 +517,109 @@ BOOST_AUTO_TEST_CASE( serial_valve )
    }
 }
 
+BOOST_AUTO_TEST_CASE( ordered_pipeline )
+{
+   const uint32_t ITEMS = 2000;
+   std::vector<uint32_t> committed;
+   committed.reserve( ITEMS );
+   std::atomic<int32_t> in_flight(0);
+   int32_t max_in_flight = 0;
+
+   fc::ordered_pipeline<uint32_t, std::string> pipeline(
+      [] ( const uint32_t& i ) {
+         if( i % 7 == 0 ) // make later items overtake earlier ones
+            fc::usleep( fc::microseconds( 100 ) );
+         return fc::sha256::hash( std::to_string( i ) ).str();
+      },
+      [&committed,&in_flight] ( uint32_t& i, std::string& hash ) {
+         BOOST_CHECK_EQUAL( fc::sha256::hash( std::to_string( i ) ).str(), hash );
+         committed.push_back( i );
+         --in_flight;
+      }, 16, "test pipeline" );
+   BOOST_CHECK_EQUAL( 16u, pipeline.window() );
+
+   for( uint32_t i = 0; i < ITEMS; i++ )
+   {
+      pipeline.push( i );
+      max_in_flight = std::max( max_in_flight, ++in_flight );
+   }
+   pipeline.flush();
+   BOOST_REQUIRE_EQUAL( ITEMS, committed.size() );
+   for( uint32_t i = 0; i < ITEMS; i++ )
+      BOOST_CHECK_EQUAL( i, committed[i] );
+   BOOST_CHECK_LE( max_in_flight, 16 );
+
+   // a failure stops the commits of all later items
+   committed.clear();
+   fc::ordered_pipeline<uint32_t, uint32_t> failing(
+      [] ( const uint32_t& i ) {
+         FC_ASSERT( i != 50, "expected failure" );
+         return i;
+      },
+      [&committed] ( uint32_t& i, uint32_t& ) { committed.push_back( i ); }, 8 );
+   try
+   {
+      for( uint32_t i = 0; i < 200; i++ )
+         failing.push( i );
+   }
+   catch( const fc::assert_exception& )
+   {
+      // push() may report the failure early, depending on timing
+   }
+   BOOST_CHECK_THROW( failing.flush(), fc::assert_exception );
+   BOOST_CHECK_EQUAL( 50u, committed.size() );
+
+   // and the pipeline is usable again afterwards
+   committed.clear();
+   failing.push( 7 );
+   failing.flush();
+   BOOST_REQUIRE_EQUAL( 1u, committed.size() );
+   BOOST_CHECK_EQUAL( 7u, committed[0] );
+}
+
+BOOST_AUTO_TEST_CASE( ordered_pipeline_vs_serial_valve )
+{
+   const uint32_t ITEMS = 20000;
+   const auto map = [] ( const uint32_t& i ) { return fc::sha256::hash( TEXT + std::to_string( i ) ); };
+   std::vector<fc::sha256> expected;
+   expected.reserve( ITEMS );
+   for( uint32_t i = 0; i < ITEMS; i++ )
+      expected.push_back( map( i ) );
+
+   std::vector<fc::sha256> committed;
+   committed.reserve( ITEMS );
+   fc::time_point start = fc::time_point::now();
+   {
+      fc::serial_valve valve;
+      std::vector<fc::future<void>> results;
+      results.reserve( ITEMS );
+      for( uint32_t i = 0; i < ITEMS; i++ )
+         results.push_back( fc::do_parallel( [&valve,&committed,&map,i] () {
+            fc::sha256 hash;
+            valve.do_serial( [&hash,&map,i] () { hash = map( i ); },
+                             [&hash,&committed] () { committed.push_back( hash ); } );
+         } ) );
+      for( auto& result : results )
+         result.wait();
+   }
+   const fc::microseconds valve_time = fc::time_point::now() - start;
+   // the valve orders by the start of the tasks, which may differ from the order of posting
+   BOOST_CHECK_EQUAL( ITEMS, committed.size() );
+
+   committed.clear();
+   start = fc::time_point::now();
+   {
+      fc::ordered_pipeline<uint32_t, fc::sha256> pipeline( map,
+            [&committed] ( uint32_t&, fc::sha256& hash ) { committed.push_back( hash ); } );
+      for( uint32_t i = 0; i < ITEMS; i++ )
+         pipeline.push( i );
+      pipeline.flush();
+   }
+   const fc::microseconds pipeline_time = fc::time_point::now() - start;
+   BOOST_CHECK( expected == committed );
+
+   ilog( "${n} items through serial_valve in ${v}µs, through ordered_pipeline in ${p}µs",
+         ("n",ITEMS)("v",valve_time.count())("p",pipeline_time.count()) );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
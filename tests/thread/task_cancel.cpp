@@ -6,6 +6,9 @@
 #include <fc/thread/mutex.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/thread/non_preemptable_scope_check.hpp>
+#include <fc/thread/task_group.hpp>
+
+#include <atomic>
 
 BOOST_AUTO_TEST_SUITE(fc_thread)
 
@@ -246,4 +249,105 @@ BOOST_AUTO_TEST_CASE( cancel_scheduled_task )
   }
 }
 
+BOOST_AUTO_TEST_CASE( cancel_scheduled_task_after_quit )
+{
+  fc::future<void> scheduled;
+  {
+    fc::thread worker( "worker" );
+    scheduled = worker.schedule( [](){}, fc::time_point::now() + fc::seconds(60), "never runs" );
+    worker.quit();
+    BOOST_CHECK( scheduled.ready() );
+    scheduled.cancel( "canceling after the thread has quit" );
+  }
+  // the thread is gone now
+  scheduled.cancel( "canceling after the thread has been destroyed" );
+  BOOST_CHECK_THROW( scheduled.wait(), fc::canceled_exception );
+}
+
+BOOST_AUTO_TEST_CASE( task_group_reports_first_failure )
+{
+  fc::task_group group( "failing group" );
+  BOOST_CHECK( !group.wait_all() );
+
+  bool sibling_finished = false;
+  fc::future<void> sibling = group.async( [&sibling_finished](){
+     fc::usleep( fc::seconds(5) );
+     sibling_finished = true;
+  }, "sleeping sibling" );
+  fc::future<int> failing = group.do_parallel( [](){
+     FC_THROW_EXCEPTION( fc::invalid_arg_exception, "expected failure" );
+     return 0;
+  }, "failing child" );
+
+  fc::exception_ptr error = group.wait_all();
+  BOOST_REQUIRE( error );
+  BOOST_CHECK_EQUAL( fc::invalid_arg_exception_code, error->code() );
+  BOOST_CHECK( group.canceled() );
+  BOOST_CHECK_EQUAL( 0u, group.size() );
+  BOOST_CHECK( !sibling_finished );
+  BOOST_CHECK_THROW( sibling.wait(), fc::canceled_exception );
+  BOOST_CHECK_THROW( failing.wait(), fc::invalid_arg_exception );
+
+  // children added after cancellation are canceled right away
+  fc::future<void> late = group.async( [](){ fc::usleep( fc::seconds(5) ); }, "late child" );
+  BOOST_CHECK_THROW( late.wait( fc::seconds(1) ), fc::canceled_exception );
+}
+
+BOOST_AUTO_TEST_CASE( task_group_deadline )
+{
+  const fc::time_point start = fc::time_point::now();
+  fc::task_group group( start + fc::milliseconds(200), "group with deadline" );
+  fc::task_group inner( group, fc::time_point::maximum(), "nested group" );
+  BOOST_CHECK( inner.deadline() == group.deadline() );
+
+  std::vector<fc::future<void>> children;
+  for( int i = 0; i < 3; ++i )
+     children.push_back( group.async( [](){ fc::usleep( fc::seconds(5) ); }, "sleeping child" ) );
+  fc::future<void> nested = inner.async( [](){ fc::usleep( fc::seconds(5) ); }, "nested child" );
+  fc::future<int> done = group.async( [](){ return 42; }, "quick child" );
+
+  fc::exception_ptr error = group.wait_all();
+  BOOST_REQUIRE( error );
+  BOOST_CHECK_EQUAL( fc::timeout_exception_code, error->code() );
+  BOOST_CHECK( fc::time_point::now() - start < fc::seconds(2) );
+  BOOST_CHECK_EQUAL( 42, done.wait() );
+  for( auto& child : children )
+     BOOST_CHECK_THROW( child.wait(), fc::canceled_exception );
+
+  fc::exception_ptr inner_error = inner.wait_all();
+  BOOST_REQUIRE( inner_error );
+  BOOST_CHECK_EQUAL( fc::timeout_exception_code, inner_error->code() );
+  BOOST_CHECK_THROW( nested.wait(), fc::canceled_exception );
+}
+
+BOOST_AUTO_TEST_CASE( task_group_cancel )
+{
+  std::atomic<int> polls( 0 );
+  fc::future<void> outer_child;
+  {
+    fc::task_group group( "canceled group" );
+    fc::task_group inner( group );
+    outer_child = group.async( [](){ fc::usleep( fc::seconds(5) ); }, "sleeping child" );
+    fc::future<void> busy = inner.do_parallel( [&inner,&polls](){
+       while( true )
+       {
+          inner.check_canceled();
+          ++polls;
+          fc::usleep( fc::milliseconds(1) );
+       }
+    }, "polling child" );
+    fc::usleep( fc::milliseconds(20) );
+    group.cancel( "canceled by test" );
+
+    fc::exception_ptr error = inner.wait_all();
+    BOOST_REQUIRE( error );
+    BOOST_CHECK_EQUAL( fc::canceled_exception_code, error->code() );
+    BOOST_CHECK_THROW( busy.wait(), fc::canceled_exception );
+    BOOST_CHECK( polls > 0 );
+  }
+  // the destructor has waited for the child
+  BOOST_CHECK( outer_child.ready() );
+  BOOST_CHECK( outer_child.error() );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
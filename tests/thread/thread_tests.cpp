@@ -2,6 +2,26 @@
 #include <boost/test/unit_test.hpp>
 
 #include <fc/thread/thread.hpp>
+#include <fc/thread/thread_specific.hpp>
+#include <fc/thread/affinity.hpp>
+#include <fc/thread/fiber_trace.hpp>
+#include <fc/thread/small_object_pool.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/time.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/atomic.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
+
+#ifdef __linux__
+# include <sched.h>
+#endif
 
 using namespace fc;
 
@@ -92,4 +112,672 @@ BOOST_AUTO_TEST_CASE(reschedules_yielded_task)
     BOOST_CHECK_EQUAL(10, reschedule_count);
 }
 
+BOOST_AUTO_TEST_CASE(fires_timers_in_order)
+{
+    for( fc::timer_backend backend : { fc::timer_backend::binary_heap, fc::timer_backend::timing_wheel } )
+    {
+        fc::thread thread( "timers", nullptr, backend );
+        std::string result = thread.async( [] {
+            std::string order;
+            fc::time_point start = fc::time_point::now();
+            std::vector<fc::future<void>> timers;
+            // far apart timers land in different levels of the wheel
+            for( int64_t delay : { 300000, 20000, 1000, 50000, 5000, 70000 } )
+               timers.push_back( fc::schedule( [&order,delay] { order += std::to_string(delay) + " "; },
+                                               start + fc::microseconds(delay) ) );
+            fc::future<void> canceled = fc::schedule( [&order] { order += "canceled "; },
+                                                      start + fc::milliseconds(10) );
+            canceled.cancel();
+            for( auto& timer : timers )
+               timer.wait();
+            BOOST_CHECK( fc::time_point::now() >= start + fc::microseconds(300000) );
+            BOOST_CHECK_THROW( canceled.wait(), fc::canceled_exception );
+            return order;
+        }).wait();
+        BOOST_CHECK_EQUAL( "1000 5000 20000 50000 70000 300000 ", result );
+
+        thread.async( [] {
+            // sleeping
+            fc::time_point start = fc::time_point::now();
+            fc::usleep( fc::milliseconds(30) );
+            BOOST_CHECK( fc::time_point::now() >= start + fc::milliseconds(30) );
+
+            // waiting with a timeout that expires
+            fc::promise<void>::ptr never = fc::promise<void>::create( "never" );
+            BOOST_CHECK_THROW( fc::future<void>( never ).wait( fc::milliseconds(20) ), fc::timeout_exception );
+
+            // waiting with a timeout that does not expire
+            fc::promise<int>::ptr soon = fc::promise<int>::create( "soon" );
+            fc::schedule( [soon] { soon->set_value(42); }, fc::time_point::now() + fc::milliseconds(10) );
+            BOOST_CHECK_EQUAL( 42, fc::future<int>( soon ).wait( fc::seconds(10) ) );
+        }).wait();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(timer_backend_benchmark)
+{
+    const uint32_t TIMERS = 100000;
+    const uint32_t WAITERS = 1000;
+    for( fc::timer_backend backend : { fc::timer_backend::binary_heap, fc::timer_backend::timing_wheel } )
+    {
+        fc::thread thread( "timers", nullptr, backend );
+        const char* name = backend == fc::timer_backend::binary_heap ? "binary heap" : "timing wheel";
+
+        // insert timers that will never fire, then cancel them
+        std::vector<fc::future<void>> timers;
+        timers.reserve( TIMERS );
+        auto insert_timers = [&thread,&timers,TIMERS] {
+            thread.async( [&timers,TIMERS] {
+                fc::time_point base = fc::time_point::now() + fc::seconds(10);
+                for( uint32_t i = 0; i < TIMERS; i++ )
+                   timers.push_back( fc::schedule( [] {}, base + fc::microseconds( (i * 7919) % 50000000 ) ) );
+            }).wait();
+        };
+        fc::time_point start = fc::time_point::now();
+        insert_timers();
+        fc::microseconds insert_time = fc::time_point::now() - start;
+
+        start = fc::time_point::now();
+        for( auto& timer : timers )
+            timer.cancel();
+        thread.poke();
+        for( auto& timer : timers )
+            while( !timer.ready() )
+               thread.async( [] {} ).wait();
+        fc::microseconds cancel_time = fc::time_point::now() - start;
+        timers.clear();
+
+        // cancel 9 of 10 timers in small batches while the others stay queued, each batch is
+        // processed by the thread before the next one is cancelled
+        const uint32_t BATCH = 100;
+        insert_timers();
+        uint32_t cancelled = 0;
+        start = fc::time_point::now();
+        for( uint32_t i = 0; i < TIMERS; i++ )
+            if( i % 10 != 0 )
+            {
+               timers[i].cancel();
+               if( ++cancelled % BATCH == 0 )
+                  thread.async( [] {} ).wait();
+            }
+        thread.async( [] {} ).wait();
+        fc::microseconds cancel_most_time = fc::time_point::now() - start;
+        for( uint32_t i = 0; i < TIMERS; i++ )
+            BOOST_CHECK_EQUAL( i % 10 != 0, timers[i].ready() );
+        for( auto& timer : timers )
+            timer.cancel();
+        for( auto& timer : timers )
+            while( !timer.ready() )
+               thread.async( [] {} ).wait();
+        timers.clear();
+
+        // insert timers that fire shortly, and measure how long it takes until all have fired
+        boost::atomic<uint32_t> fired(0);
+        fc::time_point due = fc::time_point::now() + fc::milliseconds(200);
+        thread.async( [&fired,due,TIMERS] {
+            for( uint32_t i = 0; i < TIMERS; i++ )
+               fc::schedule( [&fired] { fired.fetch_add(1); }, due + fc::microseconds( (i * 7919) % 1000 ) );
+        }).wait();
+        while( fired.load() < TIMERS )
+            fc::usleep( fc::milliseconds(1) );
+        fc::microseconds fire_time = fc::time_point::now() - due;
+
+        // fibers waiting with a timeout that are woken up early
+        start = fc::time_point::now();
+        thread.async( [WAITERS] {
+            std::vector<fc::promise<void>::ptr> promises;
+            std::vector<fc::future<void>> waiters;
+            for( uint32_t i = 0; i < WAITERS; i++ )
+            {
+               promises.push_back( fc::promise<void>::create( "benchmark" ) );
+               fc::promise<void>::ptr p = promises.back();
+               waiters.push_back( fc::async( [p,i] { fc::future<void>( p ).wait( fc::seconds( 10 + i % 50 ) ); } ) );
+            }
+            fc::yield();
+            for( auto& p : promises )
+               p->set_value();
+            for( auto& w : waiters )
+               w.wait();
+        }).wait();
+        fc::microseconds wait_time = fc::time_point::now() - start;
+
+        ilog( "${b}: inserted ${n} timers in ${i}us, cancelled them in ${c}us, fired them in ${f}us, woke ${w} waiters in ${t}us",
+              ("b",name)("n",TIMERS)("i",insert_time.count())("c",cancel_time.count())("f",fire_time.count())
+              ("w",WAITERS)("t",wait_time.count()) );
+        ilog( "${b}: cancelled ${m} of ${n} queued timers in batches of ${s} in ${c}us",
+              ("b",name)("m",cancelled)("n",TIMERS)("s",BATCH)("c",cancel_most_time.count()) );
+    }
+}
+
+static uint64_t use_stack( uint32_t depth )
+{
+    volatile char buffer[1024];
+    buffer[0] = char(depth);
+    if( depth == 0 )
+       return 0;
+    uint64_t result = use_stack( depth - 1 );
+    return result + buffer[0];
+}
+
+BOOST_AUTO_TEST_CASE(runs_tasks_with_requested_stack_size)
+{
+    fc::enable_stack_usage_tracking( true );
+    {
+       fc::thread thread( "stacks" );
+
+       // many fibers with small stacks waiting at the same time
+       fc::promise<void>::ptr go = fc::promise<void>::create( "go" );
+       std::vector<fc::future<int>> waiters;
+       for( int i = 0; i < 1000; i++ )
+          waiters.push_back( thread.async( [go,i] { fc::future<void>( go ).wait(); return i; },
+                                           "small stack waiter", fc::priority(), 30 * 1024 ) );
+       thread.async( [go] { go->set_value(); } );
+       for( int i = 0; i < 1000; i++ )
+          BOOST_CHECK_EQUAL( i, waiters[i].wait() );
+
+       // a task that needs more than the default stack size
+       BOOST_CHECK( thread.async( [] { return use_stack( 3000 ); }, "deep recursion",
+                                  fc::priority(), 4 * 1024 * 1024 ).wait() > 0 );
+       // default-sized tasks are still fine afterwards
+       BOOST_CHECK_EQUAL( 10, thread.async( [] { return 10; } ).wait() );
+    }
+    fc::enable_stack_usage_tracking( false );
+
+    bool found_small = false;
+    bool found_deep = false;
+    for( const fc::stack_usage& usage : fc::get_stack_usage() )
+    {
+       if( usage.task_desc == "small stack waiter" )
+       {
+          found_small = true;
+          // rounded up to a power of two, or to the platform's minimum stack size
+          BOOST_CHECK_GE( usage.stack_size, 30 * 1024 );
+          BOOST_CHECK_LT( usage.stack_size, FC_CONTEXT_STACK_SIZE );
+          BOOST_CHECK_EQUAL( 1000, usage.samples );
+          BOOST_CHECK_LT( usage.max_used, usage.stack_size );
+       }
+       else if( usage.task_desc == "deep recursion" )
+       {
+          found_deep = true;
+          BOOST_CHECK_EQUAL( 4 * 1024 * 1024, usage.stack_size );
+          BOOST_CHECK_GT( usage.max_used, 3000 * 1024 );
+          BOOST_CHECK_LT( usage.max_used, usage.stack_size );
+       }
+    }
+    BOOST_CHECK( found_small );
+    BOOST_CHECK( found_deep );
+}
+
+BOOST_AUTO_TEST_CASE(runs_task_needing_another_stack_before_ready_fibers)
+{
+    fc::thread thread( "stacks" );
+    std::vector<std::string> order;
+    fc::promise<void>::ptr go = fc::promise<void>::create( "go" );
+    fc::future<void> blocked = thread.async( [&order,go] {
+       fc::future<void>( go ).wait();
+       order.push_back( "woken" );
+    }, "blocked" );
+    thread.async( [&order,go] {
+       go->set_value();
+       // needs a new context, which must not give way to the fiber that has just been woken
+       fc::async( [&order] { order.push_back( "deadline" ); }, "deadline with a large stack",
+                  fc::priority::with_deadline( fc::time_point::now() + fc::seconds(30) ), 4 * 1024 * 1024 );
+    } ).wait();
+    blocked.wait();
+    thread.async( [] {} ).wait();
+
+    BOOST_CHECK( order == std::vector<std::string>( { "deadline", "woken" } ) );
+}
+
+BOOST_AUTO_TEST_CASE(collects_scheduler_statistics)
+{
+    fc::thread thread( "stats" );
+    thread.async( [] {} ).wait();
+    thread.reset_stats();
+
+    std::vector<fc::future<void>> tasks;
+    for( int i = 0; i < 100; i++ )
+       tasks.push_back( thread.async( [] { fc::yield(); }, "yielding task" ) );
+    for( auto& task : tasks )
+       task.wait();
+
+    fc::variant_object stats = thread.get_stats().get_object();
+    BOOST_CHECK_EQUAL( "stats", stats["name"].as_string() );
+    BOOST_CHECK_GE( stats["tasks_run"].as_uint64(), 100u );
+    BOOST_CHECK_GE( stats["context_switches"].as_uint64(), 100u );
+    BOOST_CHECK_GE( stats["task_queue_depth"]["count"].as_uint64(), 100u );
+
+    bool found = false;
+    for( const fc::variant& task : stats["tasks"].get_array() )
+    {
+       if( task["desc"].as_string() != "yielding task" )
+          continue;
+       found = true;
+       BOOST_CHECK_EQUAL( 100u, task["runs"].as_uint64() );
+       BOOST_CHECK_EQUAL( 100u, task["queue_latency_ns"]["count"].as_uint64() );
+       // each task runs once before and once after it yields
+       BOOST_CHECK_EQUAL( 200u, task["run_slice_ns"]["count"].as_uint64() );
+       uint64_t bucket_total = 0;
+       for( const fc::variant& bucket : task["run_slice_ns"]["buckets"].get_array() )
+          bucket_total += bucket.get_array()[1].as_uint64();
+       BOOST_CHECK_EQUAL( 200u, bucket_total );
+    }
+    BOOST_CHECK( found );
+
+    thread.reset_stats();
+    stats = thread.get_stats().get_object();
+    // only the task taking the snapshot has run since the reset
+    BOOST_CHECK_EQUAL( 1u, stats["tasks_run"].as_uint64() );
+}
+
+BOOST_AUTO_TEST_CASE(records_fiber_trace)
+{
+    fc::thread thread( "traced" );
+    thread.async( [] {} ).wait();
+
+    fc::enable_fiber_tracing( true );
+    fc::clear_fiber_trace();
+    fc::promise<void>::ptr signal = fc::promise<void>::create( "signal" );
+    fc::future<void> waiter = thread.async( [signal] { fc::future<void>( signal ).wait(); }, "waiting task" );
+    fc::future<void> yielder = thread.async( [] { fc::yield(); }, "yielding task" );
+    yielder.wait();
+    signal->set_value();
+    waiter.wait();
+    // one after the other, so that their memory is reused
+    for( int i = 0; i < 10; i++ )
+       thread.async( [] {}, "repeated task" ).wait();
+    // the end of a task is recorded after its result has been delivered
+    thread.async( [] {} ).wait();
+    fc::enable_fiber_tracing( false );
+
+    std::map<std::string, unsigned> begin_count, end_count, flow_count, flow_starts;
+    std::set<std::string> end_states;
+    bool named = false;
+    fc::variant trace = fc::get_fiber_trace();
+    for( const fc::variant& event : trace["traceEvents"].get_array() )
+    {
+       const std::string phase = event["ph"].as_string();
+       const std::string name = event["name"].as_string();
+       if( phase == "M" )
+          named |= event["args"]["name"].as_string() == "traced";
+       else if( phase == "B" )
+          ++begin_count[name];
+       else if( phase == "E" )
+       {
+          ++end_count[name];
+          end_states.insert( name + ":" + event["args"]["state"].as_string() );
+       }
+       else if( phase == "s" || phase == "f" )
+       {
+          ++flow_count[name];
+          if( phase == "s" )
+             ++flow_starts[event["id"].as_string()];
+       }
+    }
+    BOOST_CHECK( named );
+    // both tasks are suspended once and resumed once
+    BOOST_CHECK_EQUAL( 2u, begin_count["waiting task"] );
+    BOOST_CHECK_EQUAL( 2u, end_count["waiting task"] );
+    BOOST_CHECK_EQUAL( 2u, begin_count["yielding task"] );
+    BOOST_CHECK_EQUAL( 2u, end_count["yielding task"] );
+    BOOST_CHECK_EQUAL( 2u, flow_count["waiting task"] );
+    BOOST_CHECK_EQUAL( 20u, flow_count["repeated task"] );
+    // every flow has an id of its own
+    for( const auto& flow : flow_starts )
+       BOOST_CHECK_EQUAL( 1u, flow.second );
+    BOOST_CHECK( end_states.count( "waiting task:blocked" ) );
+    BOOST_CHECK( end_states.count( "waiting task:done" ) );
+    BOOST_CHECK( end_states.count( "yielding task:yielded" ) );
+    BOOST_CHECK( end_states.count( "yielding task:done" ) );
+
+    fc::clear_fiber_trace();
+    trace = fc::get_fiber_trace();
+    // only the thread names remain
+    for( const fc::variant& event : trace["traceEvents"].get_array() )
+       BOOST_CHECK_EQUAL( "M", event["ph"].as_string() );
+}
+
+BOOST_AUTO_TEST_CASE(continues_futures)
+{
+    fc::thread thread( "continuations" );
+
+    // inline continuations, including on a future that is ready already
+    fc::future<int> answer = thread.async( [] { return 6; } ).then( []( int v ) { return v * 7; } );
+    BOOST_CHECK_EQUAL( 42, answer.wait() );
+    BOOST_CHECK_EQUAL( "42", answer.then( []( int v ) { return std::to_string( v ); } ).wait() );
+
+    // several continuations of the same future
+    fc::promise<int>::ptr source = fc::promise<int>::create( "source" );
+    fc::future<int> first = fc::future<int>( source ).then( []( int v ) { return v + 1; } );
+    fc::future<int> second = fc::future<int>( source ).then( []( int v ) { return v + 2; } );
+    source->set_value( 1 );
+    BOOST_CHECK_EQUAL( 2, first.wait() );
+    BOOST_CHECK_EQUAL( 3, second.wait() );
+
+    // continuation posted to a thread
+    fc::future<std::string> name = thread.async( [] {} ).then( thread, [] { return fc::thread::current().name(); } );
+    BOOST_CHECK_EQUAL( "continuations", name.wait() );
+
+    // exceptions are passed on, continuations of failed futures are skipped
+    bool called = false;
+    fc::future<void> failed = thread.async( [] { FC_THROW( "failure" ); } ).then( [&called] { called = true; } );
+    BOOST_CHECK_THROW( failed.wait(), fc::exception );
+    BOOST_CHECK( !called );
+    fc::future<int> throwing = answer.then( thread, []( int ) -> int { FC_THROW( "failure" ); } );
+    BOOST_CHECK_THROW( throwing.wait(), fc::exception );
+
+    std::vector<fc::future<int>> values;
+    for( int i = 0; i < 100; i++ )
+       values.push_back( thread.async( [i] { fc::yield(); return i; } ) );
+    std::vector<int> all = fc::when_all( values ).wait();
+    BOOST_REQUIRE_EQUAL( 100u, all.size() );
+    for( int i = 0; i < 100; i++ )
+       BOOST_CHECK_EQUAL( i, all[i] );
+    BOOST_CHECK( fc::when_all( std::vector<fc::future<int>>() ).wait().empty() );
+
+    std::vector<fc::future<void>> tasks;
+    tasks.push_back( thread.async( [] {} ) );
+    tasks.push_back( thread.async( [] { FC_THROW( "failure" ); } ) );
+    BOOST_CHECK_THROW( fc::when_all( tasks ).wait(), fc::exception );
+
+    fc::promise<void>::ptr never = fc::promise<void>::create( "never" );
+    std::vector<fc::future<void>> candidates{ fc::future<void>( never ), thread.async( [] {} ) };
+    BOOST_CHECK_EQUAL( 1u, fc::when_any( candidates ).wait() );
+    never->set_value();
+}
+
+BOOST_AUTO_TEST_CASE(pools_task_allocations)
+{
+    fc::thread thread( "pooled" );
+    const auto run_tasks = [&thread]( int count ) {
+       for( int i = 0; i < count; i++ )
+       {
+          fc::promise<int>::ptr p = fc::promise<int>::create( "pooled" );
+          thread.async( [p,i] { p->set_value( i ); } ).wait();
+          FC_ASSERT( p->wait() == i );
+       }
+    };
+    // tasks are created here and destroyed in either thread, so blocks wander
+    // between the two caches until enough of them are in circulation
+    run_tasks( 2000 );
+
+    const fc::small_object_pool_stats before = fc::get_small_object_pool_stats();
+    const fc::time_point start = fc::time_point::now();
+    run_tasks( 10000 );
+    const fc::microseconds elapsed = fc::time_point::now() - start;
+    const fc::small_object_pool_stats after = fc::get_small_object_pool_stats();
+    ilog( "10000 pooled tasks in ${t}us", ("t",elapsed.count()) );
+
+    BOOST_CHECK_GE( after.allocations - before.allocations, 20000u );
+    BOOST_CHECK_EQUAL( before.system_allocations, after.system_allocations );
+    BOOST_CHECK_EQUAL( before.oversized, after.oversized );
+
+    void* small = fc::detail::small_object_allocate( 100 );
+    fc::detail::small_object_deallocate( small, 100 );
+    void* large = fc::detail::small_object_allocate( 100000 );
+    fc::detail::small_object_deallocate( large, 100000 );
+    BOOST_CHECK_EQUAL( after.oversized + 1, fc::get_small_object_pool_stats().oversized );
+}
+
+BOOST_AUTO_TEST_CASE(places_threads)
+{
+    BOOST_REQUIRE_GE( fc::numa_node_count(), 1u );
+    const std::vector<unsigned> cpus = fc::numa_node_cpus( 0 );
+    BOOST_REQUIRE( !cpus.empty() );
+    BOOST_CHECK_LT( fc::current_numa_node(), fc::numa_node_count() );
+
+    fc::thread_placement spread;
+    spread.numa_node = 0;
+    spread.pin_each = true;
+    BOOST_CHECK( spread.for_member( 0 ).cpus == std::vector<unsigned>{ cpus[0] } );
+    BOOST_CHECK( spread.for_member( cpus.size() ).cpus == std::vector<unsigned>{ cpus[0] } );
+    fc::thread_placement group;
+    group.cpus = { 0, 1 };
+    BOOST_CHECK( group.for_member( 5 ).cpus == group.cpus );
+    BOOST_CHECK( fc::thread_placement().empty() );
+
+    fc::thread_placement pinned;
+    pinned.cpus = { cpus.back() };
+    fc::set_thread_placement( "pinned thread", pinned );
+    BOOST_CHECK( fc::get_thread_placement( "pinned thread" ).cpus == pinned.cpus );
+    BOOST_CHECK( fc::get_thread_placement( "other thread" ).empty() );
+    {
+       fc::thread thread( "pinned thread" );
+#ifdef __linux__
+       const std::vector<unsigned> allowed = thread.async( [] {
+          cpu_set_t set;
+          FC_ASSERT( sched_getaffinity( 0, sizeof(set), &set ) == 0 );
+          std::vector<unsigned> result;
+          for( unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++ )
+             if( CPU_ISSET( cpu, &set ) )
+                result.push_back( cpu );
+          return result;
+       } ).wait();
+       BOOST_CHECK( allowed == pinned.cpus );
+#endif
+    }
+    fc::set_thread_placement( "pinned thread", fc::thread_placement() );
+    BOOST_CHECK( fc::get_thread_placement( "pinned thread" ).empty() );
+
+    fc::thread_placement invalid;
+    invalid.numa_node = fc::numa_node_count();
+    BOOST_CHECK( !fc::apply_thread_placement( invalid ) );
+}
+
+BOOST_AUTO_TEST_CASE(idle_policy_latency)
+{
+    fc::thread client( "client" );
+    fc::thread server( "server" );
+    BOOST_CHECK_EQUAL( 0u, server.get_idle_policy().spin_iterations );
+
+    const size_t count = 5000;
+    for( const fc::idle_policy& policy : { fc::idle_policy::park(), fc::idle_policy::spin_then_park() } )
+    {
+       client.set_idle_policy( policy );
+       server.set_idle_policy( policy );
+       BOOST_CHECK_EQUAL( policy.spin_iterations, server.get_idle_policy().spin_iterations );
+       BOOST_CHECK_EQUAL( policy.yield_iterations, server.get_idle_policy().yield_iterations );
+       server.reset_stats();
+
+       // request/response round trips, as between an asio thread and a worker
+       std::vector<int64_t> latencies = client.async( [&server,count] {
+          std::vector<int64_t> result;
+          result.reserve( count );
+          for( size_t i = 0; i < count; i++ )
+          {
+             const auto start = std::chrono::steady_clock::now();
+             server.async( [] {}, "ping" ).wait();
+             result.push_back( std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - start ).count() );
+          }
+          return result;
+       } ).wait();
+       BOOST_REQUIRE_EQUAL( count, latencies.size() );
+       std::sort( latencies.begin(), latencies.end() );
+       const auto percentile = [&latencies]( double p ) {
+          return latencies[ std::min( latencies.size() - 1, size_t( p * latencies.size() ) ) ];
+       };
+
+       const fc::variant stats = server.get_stats();
+       ilog( "${p}: round trip p50 ${p50}ns, p90 ${p90}ns, p99 ${p99}ns, p99.9 ${p999}ns, "
+             "${w} idle waits, ${s} spin wakeups",
+             ("p",policy.spin_iterations > 0 ? "spin then park" : "park")
+             ("p50",percentile(0.5))("p90",percentile(0.9))("p99",percentile(0.99))("p999",percentile(0.999))
+             ("w",stats["idle_waits"])("s",stats["spin_wakeups"]) );
+       if( policy.spin_iterations == 0 && policy.yield_iterations == 0 )
+          BOOST_CHECK_EQUAL( 0u, stats["spin_wakeups"].as_uint64() );
+    }
+}
+
+BOOST_AUTO_TEST_CASE(runs_task_batches)
+{
+    fc::thread thread( "batches" );
+    std::vector<int> order;
+    std::vector<std::function<int()>> functors;
+    for( int i = 0; i < 100; i++ )
+       functors.push_back( [&order,i] { order.push_back( i ); return i * i; } );
+
+    std::vector<fc::future<int>> results = thread.async_batch( functors.begin(), functors.end(), "batch" );
+    BOOST_REQUIRE_EQUAL( 100u, results.size() );
+    for( int i = 0; i < 100; i++ )
+       BOOST_CHECK_EQUAL( i * i, results[i].wait() );
+    BOOST_REQUIRE_EQUAL( 100u, order.size() );
+    for( int i = 0; i < 100; i++ )
+       BOOST_CHECK_EQUAL( i, order[i] );
+
+    // batches mix with single tasks in posting order
+    order.clear();
+    fc::future<void> before = thread.async( [&order] { order.push_back( -1 ); } );
+    results = thread.async_batch( functors.begin(), functors.begin() + 2, "batch" );
+    thread.async( [&order] { order.push_back( -2 ); } ).wait();
+    BOOST_CHECK( order == std::vector<int>( { -1, 0, 1, -2 } ) );
+
+    BOOST_CHECK( thread.async_batch( functors.end(), functors.end() ).empty() );
+}
+
+BOOST_AUTO_TEST_CASE(runs_earliest_deadline_first)
+{
+    fc::thread thread( "edf" );
+    thread.async( [] {} ).wait();
+    thread.reset_stats();
+
+    std::vector<int> order;
+    const fc::time_point now = fc::time_point::now();
+    // post from within the thread, so that all tasks are queued before any of them runs
+    thread.async( [&order,now] {
+       fc::async( [&order] { order.push_back( 0 ); }, "bulk" );
+       fc::async( [&order] { order.push_back( 3 ); }, "reply",
+                  fc::priority::with_deadline( now + fc::seconds(30) ) );
+       fc::async( [&order] { order.push_back( 1 ); }, "bulk" );
+       fc::async( [&order] { order.push_back( 2 ); }, "reply",
+                  fc::priority::with_deadline( now + fc::seconds(20) ) );
+       fc::async( [&order] { order.push_back( 4 ); }, "urgent", fc::priority::max() );
+       fc::async( [&order] { order.push_back( 5 ); }, "late",
+                  fc::priority::with_deadline( now - fc::seconds(1) ) );
+    } ).wait();
+    thread.async( [] {} ).wait();
+
+    // higher priority first, then earliest deadline, then tasks without deadline in posting order
+    BOOST_CHECK( order == std::vector<int>( { 4, 5, 2, 3, 0, 1 } ) );
+
+    fc::variant_object stats = thread.get_stats().get_object();
+    BOOST_CHECK_EQUAL( 3u, stats["deadline_tasks_run"].as_uint64() );
+    BOOST_CHECK_EQUAL( 1u, stats["deadlines_missed"].as_uint64() );
+    for( const fc::variant& task : stats["tasks"].get_array() )
+       BOOST_CHECK_EQUAL( task["desc"].as_string() == "late" ? 1u : 0u,
+                          task["deadline_lateness_us"]["count"].as_uint64() );
+}
+
+BOOST_AUTO_TEST_CASE(keeps_deadline_after_yielding)
+{
+    fc::thread thread( "edf" );
+    std::vector<std::string> order;
+    fc::promise<void>::ptr woken = fc::promise<void>::create( "woken" );
+    fc::promise<void>::ptr released = fc::promise<void>::create( "released" );
+    thread.async( [&order,woken,released] {
+       // blocks, is resumed by a yielding task, yields itself and blocks again
+       fc::async( [&order,woken,released] {
+          order.push_back( "deadline" );
+          fc::future<void>( woken ).wait();
+          order.push_back( "deadline woken" );
+          fc::yield();
+          fc::future<void>( released ).wait();
+          order.push_back( "deadline released" );
+       }, "deadline", fc::priority::with_deadline( fc::time_point::now() + fc::seconds(30) ) );
+       fc::async( [&order,woken] {
+          woken->set_value();
+          fc::yield();
+          order.push_back( "yielding" );
+       }, "yielding" );
+       fc::async( [&order,released] {
+          order.push_back( "bulk 1" );
+          released->set_value();
+       }, "bulk" );
+       fc::async( [&order] { order.push_back( "bulk 2" ); }, "bulk" );
+    } ).wait();
+    thread.async( [] {} ).wait();
+
+    BOOST_CHECK( order == std::vector<std::string>( { "deadline", "deadline woken", "yielding", "bulk 1",
+                                                      "deadline released", "bulk 2" } ) );
+}
+
+BOOST_AUTO_TEST_CASE(keeps_fast_task_specific_data)
+{
+    static fc::fast_task_specific_ptr<std::string, 0> value;
+    static fc::fast_task_specific_ptr<int, 1> other;
+    fc::thread thread( "task specific" );
+
+    // outside of tasks, the value belongs to the thread
+    thread.async( [] {} ).wait();
+    BOOST_CHECK( !value );
+    value.reset( new std::string( "main" ) );
+
+    std::vector<fc::future<std::string>> results;
+    for( int i = 0; i < 10; i++ )
+       results.push_back( thread.async( [i] {
+          BOOST_CHECK( !value );
+          value.reset( new std::string( fc::to_string( i ) ) );
+          other.reset( new int( i ) );
+          // survives switching to the other tasks
+          fc::yield();
+          fc::usleep( fc::milliseconds( 1 ) );
+          BOOST_CHECK_EQUAL( i, *other );
+          return *value;
+       } ) );
+    for( int i = 0; i < 10; i++ )
+       BOOST_CHECK_EQUAL( fc::to_string( i ), results[i].wait() );
+    BOOST_REQUIRE( value );
+    BOOST_CHECK_EQUAL( "main", *value );
+    BOOST_CHECK( !other );
+
+    // the value is destroyed with the task, or when it is replaced
+    std::shared_ptr<int> tracked = std::make_shared<int>( 1 );
+    static fc::fast_task_specific_ptr<std::shared_ptr<int>, 2> holder;
+    thread.async( [tracked] {
+       holder.reset( new std::shared_ptr<int>( tracked ) );
+       BOOST_CHECK_EQUAL( 3, tracked.use_count() );
+       holder.reset( new std::shared_ptr<int>( tracked ) );
+       BOOST_CHECK_EQUAL( 3, tracked.use_count() );
+    } ).wait();
+    // make sure the thread has released the task
+    thread.async( [] {} ).wait();
+    BOOST_CHECK_EQUAL( 1, tracked.use_count() );
+}
+
+BOOST_AUTO_TEST_CASE(task_specific_benchmark)
+{
+    const uint32_t ROUNDS = 10000000;
+    static fc::thread_specific_ptr<uint64_t> thread_value;
+    static fc::task_specific_ptr<uint64_t> task_value;
+    static fc::fast_task_specific_ptr<uint64_t, FC_FAST_TASK_SLOTS - 1> fast_value;
+
+    fc::thread thread( "task specific benchmark" );
+    thread.async( [ROUNDS] {
+       thread_value.reset( new uint64_t(1) );
+       task_value.reset( new uint64_t(1) );
+       fast_value.reset( new uint64_t(1) );
+       auto measure = [ROUNDS] ( const char* name, auto get ) {
+          uint64_t sum = 0;
+          const fc::time_point start = fc::time_point::now();
+          for( uint32_t i = 0; i < ROUNDS; i++ )
+             sum += get();
+          const fc::microseconds elapsed = fc::time_point::now() - start;
+          BOOST_CHECK_EQUAL( ROUNDS, sum );
+          ilog( "${n}: ${r} get() in ${t}us", ("n",name)("r",ROUNDS)("t",elapsed.count()) );
+       };
+       measure( "thread_specific_ptr", [] { return *thread_value; } );
+       measure( "task_specific_ptr", [] { return *task_value; } );
+       measure( "fast_task_specific_ptr", [] { return *fast_value; } );
+
+       const fc::time_point start = fc::time_point::now();
+       for( uint32_t i = 0; i < ROUNDS / 10; i++ )
+       {
+          task_value.reset( new uint64_t(i) );
+          fast_value.reset( new uint64_t(i) );
+       }
+       ilog( "task_specific_ptr and fast_task_specific_ptr: ${r} reset() in ${t}us",
+             ("r",ROUNDS / 10)("t",(fc::time_point::now() - start).count()) );
+    } ).wait();
+}
+
 BOOST_AUTO_TEST_SUITE_END()